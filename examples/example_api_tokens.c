@@ -1,7 +1,8 @@
 /*
  * EXEMPLO 2: Aplicação de Geração de API Tokens
  * 
- * Use case: API REST que precisa gerar tokens de autenticação
+ * Use case: API REST que precisa gerar tokens de autenticação e recusar
+ * requisições assinadas repetidas (replay) sem consultar um banco
  * 
  * Compilar:
  *   gcc -o api_tokengen example_api_tokens.c agle.c -lssl -lcrypto -O3
@@ -82,6 +83,16 @@ int main(void) {
     printf("═══════════════════════════════════════════════════════════\n");
     printf("Gerando tokens efêmeros para rate limiting:\n\n");
 
+    /* Lado do servidor: (cliente, nonce) lembrados por 5 minutos */
+    AGLE_REPLAY_CACHE *replay = AGLE_ReplayCacheNew(5 * 60 * 1000, 100000);
+    if (replay == NULL) {
+        printf("❌ Erro ao criar cache de replay\n");
+        AGLE_Cleanup(&ctx);
+        return 1;
+    }
+    uint64_t agora_ms = (uint64_t)time(NULL) * 1000;
+    uint8_t primeiro_nonce[8];
+
     for (int i = 0; i < 3; i++) {
         uint64_t request_id;
         AGLE_GetRandom64(&ctx, &request_id);
@@ -94,9 +105,32 @@ int main(void) {
         printf("Request #%d from %s\n", i + 1, clients[0].client_id);
         printf("  Request ID: %lu\n", request_id);
         printf("  Nonce:      %s\n", nonce);
+
+        /* O timestamp e o nonce fazem parte do que o cliente assina */
+        AGLE_ReplayResult r = AGLE_ReplayCheck(replay, clients[0].client_id,
+                                               strlen(clients[0].client_id),
+                                               nonce_bytes, sizeof(nonce_bytes),
+                                               agora_ms, agora_ms);
+        printf("  Servidor:   %s\n", r == AGLE_REPLAY_FRESH ? "✅ aceita" : "❌ recusada");
         printf("\n");
+        if (i == 0) memcpy(primeiro_nonce, nonce_bytes, sizeof(primeiro_nonce));
     }
 
+    /* Um atacante reenvia a primeira requisição, intacta */
+    printf("Reenviando a requisição #1 (replay):\n");
+    AGLE_ReplayResult r = AGLE_ReplayCheck(replay, clients[0].client_id,
+                                           strlen(clients[0].client_id),
+                                           primeiro_nonce, sizeof(primeiro_nonce),
+                                           agora_ms, agora_ms + 1500);
+    printf("  Servidor:   %s\n", r == AGLE_REPLAY_SEEN ? "❌ recusada (replay)" : "⚠️  aceita");
+
+    /* Depois da janela, o timestamp assinado já não passa */
+    r = AGLE_ReplayCheck(replay, clients[0].client_id, strlen(clients[0].client_id),
+                         primeiro_nonce, sizeof(primeiro_nonce),
+                         agora_ms, agora_ms + 6 * 60 * 1000);
+    printf("  Após 6 min: %s\n\n", r == AGLE_REPLAY_STALE ? "❌ recusada (expirada)" : "⚠️  aceita");
+
+    AGLE_ReplayCacheFree(replay);
     AGLE_Cleanup(&ctx);
     printf("✅ API Token generation complete!\n");
 
@@ -0,0 +1,806 @@
+/*
+ * GERADOR DE CARGA PARA O SERVIDOR DE AUTENTICAÇÃO
+ * Exercita /register, /login, /validate e /logout com uma mistura configurável
+ *
+ * Laço fechado (padrão): cada conexão envia a próxima requisição assim que
+ * recebe a resposta. Mede o tempo de serviço, mas um servidor lento também
+ * freia o gerador (omissão coordenada).
+ *
+ * Laço aberto (-r TAXA): as chegadas seguem um cronograma fixo, independente
+ * das respostas. A latência é medida a partir do instante planejado, então a
+ * espera por uma conexão livre também conta — os percentis não escondem
+ * travadas do servidor.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <time.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+
+#define MAX_THREADS 64
+#define MAX_CONEXOES 65536
+#define MAX_EVENTOS 256
+#define TAM_REQUISICAO 512
+#define TAM_RESPOSTA 4096         // Respostas de /register, /login, /validate, /logout
+#define PAUSA_FALHA_US 10000      // Conexão que falhou espera antes de tentar de novo
+#define SENHA_CARGA "Carga#Segura2024"
+
+// Histograma log-linear: 16 sub-baldes por potência de 2 (erro ≤ 6,25%)
+#define BITS_SUBBALDE 4
+#define SUBBALDES (1u << BITS_SUBBALDE)
+#define EXPOENTE_MAX 36           // 2^36 µs ≈ 19 h
+#define NUM_BALDES ((EXPOENTE_MAX - BITS_SUBBALDE + 2) * SUBBALDES)
+
+typedef enum { OP_REGISTER, OP_LOGIN, OP_VALIDATE, OP_LOGOUT, NUM_OPS } Operacao;
+
+static const char *const NOMES_OP[NUM_OPS] = { "register", "login", "validate", "logout" };
+
+// Status contados à parte; o último índice agrupa os demais
+static const int CODIGOS[] = { 200, 400, 401, 404, 429, 500, 503 };
+#define NUM_CODIGOS (sizeof(CODIGOS) / sizeof(CODIGOS[0]) + 1)
+
+typedef struct {
+    uint64_t baldes[NUM_BALDES];
+    uint64_t total;
+    uint64_t maximo;
+} Histograma;
+
+typedef enum {
+    CONEXAO_LIVRE,                // Sem requisição (fd pode estar aberto ou não)
+    CONEXAO_CONECTANDO,           // connect() em andamento; envia ao concluir
+    CONEXAO_ENVIANDO,
+    CONEXAO_AGUARDANDO            // Requisição enviada, lendo a resposta
+} EstadoConexao;
+
+typedef struct Conexao {
+    int fd;
+    uint32_t origem;              // Endereço local (ordem de rede); 0 = escolhido pelo kernel
+    EstadoConexao estado;
+    Operacao op;
+    uint64_t planejado_us;        // Instante planejado (laço aberto) ou de envio
+    uint64_t enviado_us;
+    uint64_t retomar_us;          // Após falha: não reutilizar antes disso
+    struct Conexao *prox;         // Lista de livres ou de pausadas
+    char token[96];               // Token do último login desta conexão (para logout)
+    size_t req_len;
+    size_t req_enviado;
+    size_t resp_len;
+    char req[TAM_REQUISICAO];
+    char resp[TAM_RESPOSTA + 1];
+} Conexao;
+
+typedef struct {
+    Histograma latencia[NUM_OPS];  // Desde o instante planejado (corrigida)
+    Histograma servico[NUM_OPS];   // Desde o envio efetivo
+    uint64_t codigos[NUM_OPS][NUM_CODIGOS];
+    uint64_t erros[NUM_OPS];       // Conexão recusada, resetada ou resposta inválida
+    uint64_t nao_enviadas;         // Laço aberto: planejadas que não saíram a tempo
+} Resultados;
+
+typedef struct {
+    int id;
+    pthread_t thread;
+    int epoll_fd;
+    Conexao *conexoes;
+    int num_conexoes;
+    Conexao *livres;              // Pilha de conexões prontas
+    Conexao *pausadas, *ultima_pausada;  // Fila em ordem de retomar_us
+    uint64_t semente;             // xorshift64
+    uint64_t registros;           // Contador para nomes de usuário únicos
+    double intervalo_us;          // Laço aberto: intervalo entre chegadas desta thread
+    double primeira_us;           // Laço aberto: instante planejado da chegada 0
+    uint64_t emitidas;            // Laço aberto: chegadas já entregues a conexões
+    Resultados res;
+} ThreadCarga;
+
+// Configuração (lida só depois de main preencher)
+static struct sockaddr_in destino;
+static const char *host = "127.0.0.1";
+static int porta = 8080;
+static int num_conexoes = 16;
+static int num_threads = 1;
+static double duracao_s = 10;
+static double aquecimento_s = 0;
+static double taxa = 0;           // Requisições/s no total; 0 = laço fechado
+static bool manter_conexao = true;
+static int num_origens = 1;
+static int num_usuarios = 16;
+static unsigned pesos[NUM_OPS] = { 2, 5, 90, 3 };
+static unsigned soma_pesos = 100;
+
+// Contas criadas antes da medição: /login e /validate sorteiam daqui
+static char (*usuarios)[32] = NULL;
+static char (*tokens)[96] = NULL;
+
+static uint64_t inicio_us;        // Início da medição (depois do aquecimento conta)
+static uint64_t fim_us;
+
+static uint64_t agora_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static uint64_t aleatorio(ThreadCarga *tc) {
+    uint64_t x = tc->semente;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return tc->semente = x;
+}
+
+// ═══════════════════════════════════════════════════════════
+//                    HISTOGRAMAS
+// ═══════════════════════════════════════════════════════════
+
+static unsigned balde(uint64_t us) {
+    if (us < SUBBALDES) return (unsigned)us;
+    unsigned e = 63u - (unsigned)__builtin_clzll(us);
+    if (e > EXPOENTE_MAX) return NUM_BALDES - 1;
+    return (e - BITS_SUBBALDE + 1) * SUBBALDES +
+           (unsigned)((us >> (e - BITS_SUBBALDE)) & (SUBBALDES - 1));
+}
+
+// Maior valor (µs) que cai no balde i: percentis arredondam para cima
+static uint64_t fim_balde(unsigned i) {
+    if (i < SUBBALDES) return i;
+    unsigned e = i / SUBBALDES + BITS_SUBBALDE - 1;
+    uint64_t ini = (uint64_t)(SUBBALDES + i % SUBBALDES) << (e - BITS_SUBBALDE);
+    return ini + (UINT64_C(1) << (e - BITS_SUBBALDE)) - 1;
+}
+
+static void histograma_registrar(Histograma *h, uint64_t us) {
+    h->baldes[balde(us)]++;
+    h->total++;
+    if (us > h->maximo) h->maximo = us;
+}
+
+static void histograma_somar(Histograma *total, const Histograma *h) {
+    for (unsigned i = 0; i < NUM_BALDES; i++) total->baldes[i] += h->baldes[i];
+    total->total += h->total;
+    if (h->maximo > total->maximo) total->maximo = h->maximo;
+}
+
+static uint64_t percentil(const Histograma *h, double p) {
+    if (h->total == 0) return 0;
+    uint64_t alvo = (uint64_t)(p / 100.0 * (double)h->total);
+    if (alvo >= h->total) alvo = h->total - 1;
+    uint64_t acumulado = 0;
+    for (unsigned i = 0; i < NUM_BALDES; i++) {
+        acumulado += h->baldes[i];
+        if (acumulado > alvo) {
+            uint64_t v = fim_balde(i);
+            return v < h->maximo ? v : h->maximo;
+        }
+    }
+    return h->maximo;
+}
+
+// ═══════════════════════════════════════════════════════════
+//                    REQUISIÇÕES
+// ═══════════════════════════════════════════════════════════
+
+static Operacao sortear_operacao(ThreadCarga *tc) {
+    unsigned r = (unsigned)(aleatorio(tc) % soma_pesos);
+    for (int op = 0; op < NUM_OPS; op++) {
+        if (r < pesos[op]) return (Operacao)op;
+        r -= pesos[op];
+    }
+    return OP_VALIDATE;
+}
+
+static size_t montar_post(char *buf, const char *caminho, const char *corpo) {
+    int n = snprintf(buf, TAM_REQUISICAO,
+                     "POST %s HTTP/1.1\r\nHost: %s\r\nContent-Type: application/json\r\n"
+                     "Content-Length: %zu\r\n%s\r\n%s",
+                     caminho, host, strlen(corpo),
+                     manter_conexao ? "" : "Connection: close\r\n", corpo);
+    return (size_t)n;
+}
+
+static void montar_requisicao(ThreadCarga *tc, Conexao *c) {
+    char corpo[192];
+    const char *usuario = usuarios[aleatorio(tc) % (uint64_t)num_usuarios];
+
+    switch (c->op) {
+    case OP_REGISTER:
+        snprintf(corpo, sizeof(corpo), "{\"username\":\"carga%d_%d_%" PRIu64 "\",\"password\":\"%s\"}",
+                 (int)getpid(), tc->id, tc->registros++, SENHA_CARGA);
+        c->req_len = montar_post(c->req, "/register", corpo);
+        break;
+    case OP_LOGIN:
+        snprintf(corpo, sizeof(corpo), "{\"username\":\"%s\",\"password\":\"%s\"}",
+                 usuario, SENHA_CARGA);
+        c->req_len = montar_post(c->req, "/login", corpo);
+        break;
+    case OP_VALIDATE:
+        c->req_len = (size_t)snprintf(c->req, TAM_REQUISICAO,
+                                      "GET /validate HTTP/1.1\r\nHost: %s\r\n"
+                                      "Authorization: Bearer %s\r\n%s\r\n",
+                                      host, tokens[aleatorio(tc) % (uint64_t)num_usuarios],
+                                      manter_conexao ? "" : "Connection: close\r\n");
+        break;
+    default:
+        // Encerra a sessão do último login desta conexão; sem uma, o token não existe
+        snprintf(corpo, sizeof(corpo), "{\"token\":\"%s\"}",
+                 c->token[0] != '\0' ? c->token : "inexistente");
+        c->token[0] = '\0';
+        c->req_len = montar_post(c->req, "/logout", corpo);
+        break;
+    }
+    c->req_enviado = 0;
+    c->resp_len = 0;
+}
+
+/*
+ * Resposta completa em c->resp? Retorna o status, 0 se faltam bytes ou -1
+ * se a resposta é inválida. *fechar indica "Connection: close".
+ */
+static int analisar_resposta(Conexao *c, bool *fechar) {
+    c->resp[c->resp_len] = '\0';
+    const char *fim_cab = strstr(c->resp, "\r\n\r\n");
+    if (fim_cab == NULL) return c->resp_len == TAM_RESPOSTA ? -1 : 0;
+    if (strncmp(c->resp, "HTTP/1.", 7) != 0) return -1;
+
+    int status = atoi(c->resp + 9);
+    const char *cl = strcasestr(c->resp, "\r\nContent-Length:");
+    if (cl == NULL || cl > fim_cab) return -1;
+    size_t tamanho = (size_t)strtoul(cl + 17, NULL, 10);
+    size_t total = (size_t)(fim_cab + 4 - c->resp) + tamanho;
+    if (total > TAM_RESPOSTA) return -1;
+    if (c->resp_len < total) return 0;
+
+    const char *con = strcasestr(c->resp, "\r\nConnection: close");
+    *fechar = con != NULL && con < fim_cab;
+
+    if (c->op == OP_LOGIN && status == 200) {
+        // Token de sessão com checksum ou assinado (servidor com -s)
+        const char *t = strstr(fim_cab, "\"token\":\"");
+        const char *fim = t != NULL ? strchr(t + 9, '"') : NULL;
+        if (fim != NULL && (size_t)(fim - (t + 9)) < sizeof(c->token)) {
+            memcpy(c->token, t + 9, (size_t)(fim - (t + 9)));
+            c->token[fim - (t + 9)] = '\0';
+        }
+    }
+    return status;
+}
+
+// ═══════════════════════════════════════════════════════════
+//                    CONEXÕES
+// ═══════════════════════════════════════════════════════════
+
+static void fechar_socket(Conexao *c) {
+    if (c->fd >= 0) close(c->fd);
+    c->fd = -1;
+    c->token[0] = '\0';
+}
+
+static void liberar(ThreadCarga *tc, Conexao *c) {
+    c->estado = CONEXAO_LIVRE;
+    c->prox = tc->livres;
+    tc->livres = c;
+}
+
+static void falhar(ThreadCarga *tc, Conexao *c, uint64_t agora) {
+    if (c->planejado_us >= inicio_us) tc->res.erros[c->op]++;
+    fechar_socket(c);
+    c->estado = CONEXAO_LIVRE;
+    c->retomar_us = agora + PAUSA_FALHA_US;
+    c->prox = NULL;
+    if (tc->ultima_pausada) tc->ultima_pausada->prox = c;
+    else tc->pausadas = c;
+    tc->ultima_pausada = c;
+}
+
+static bool conectar(ThreadCarga *tc, Conexao *c) {
+    c->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (c->fd < 0) return false;
+    int um = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &um, sizeof(um));
+    if (c->origem != 0) {
+        struct sockaddr_in local = { .sin_family = AF_INET, .sin_addr.s_addr = c->origem };
+        if (bind(c->fd, (struct sockaddr *)&local, sizeof(local)) < 0) return false;
+    }
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, .data.ptr = c };
+    if (epoll_ctl(tc->epoll_fd, EPOLL_CTL_ADD, c->fd, &ev) < 0) return false;
+    if (connect(c->fd, (struct sockaddr *)&destino, sizeof(destino)) < 0 && errno != EINPROGRESS) {
+        return false;
+    }
+    c->estado = CONEXAO_CONECTANDO;
+    return true;
+}
+
+// Envia o que couber; false em erro de socket
+static bool escrever(Conexao *c) {
+    while (c->req_enviado < c->req_len) {
+        ssize_t n = send(c->fd, c->req + c->req_enviado, c->req_len - c->req_enviado, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        c->req_enviado += (size_t)n;
+    }
+    c->estado = CONEXAO_AGUARDANDO;
+    return true;
+}
+
+static void despachar(ThreadCarga *tc, Conexao *c, uint64_t planejado, uint64_t agora) {
+    c->op = sortear_operacao(tc);
+    c->planejado_us = planejado;
+    c->enviado_us = agora;
+    montar_requisicao(tc, c);
+
+    if (c->fd < 0) {
+        if (!conectar(tc, c)) falhar(tc, c, agora);
+        return;  // Envia quando o connect concluir (EPOLLOUT)
+    }
+    c->estado = CONEXAO_ENVIANDO;
+    if (!escrever(c)) falhar(tc, c, agora);
+}
+
+static void concluir(ThreadCarga *tc, Conexao *c, int status, bool fechar, uint64_t agora) {
+    if (c->planejado_us >= inicio_us) {
+        Resultados *r = &tc->res;
+        histograma_registrar(&r->latencia[c->op], agora - c->planejado_us);
+        histograma_registrar(&r->servico[c->op], agora - c->enviado_us);
+        size_t i = 0;
+        while (i < NUM_CODIGOS - 1 && CODIGOS[i] != status) i++;
+        r->codigos[c->op][i]++;
+    }
+    if (fechar || !manter_conexao) fechar_socket(c);
+    liberar(tc, c);
+}
+
+static void ler(ThreadCarga *tc, Conexao *c, uint64_t agora) {
+    for (;;) {
+        ssize_t n = recv(c->fd, c->resp + c->resp_len, TAM_RESPOSTA - c->resp_len, 0);
+        if (n > 0) {
+            c->resp_len += (size_t)n;
+            bool fechar = false;
+            int status = analisar_resposta(c, &fechar);
+            if (status < 0) {
+                falhar(tc, c, agora);
+                return;
+            }
+            if (status > 0) {
+                concluir(tc, c, status, fechar, agora);
+                return;
+            }
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        falhar(tc, c, agora);  // Fechada ou resetada antes da resposta completa
+        return;
+    }
+}
+
+static void conexao_evento(ThreadCarga *tc, Conexao *c, uint32_t eventos, uint64_t agora) {
+    if (c->estado == CONEXAO_LIVRE) {
+        // Servidor fechou uma conexão ociosa: reabre na próxima requisição
+        if (eventos & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) fechar_socket(c);
+        return;
+    }
+    if (c->estado == CONEXAO_CONECTANDO) {
+        if (!(eventos & (EPOLLOUT | EPOLLERR | EPOLLHUP))) return;
+        int erro = 0;
+        socklen_t len = sizeof(erro);
+        getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &erro, &len);
+        if (erro != 0) {
+            falhar(tc, c, agora);
+            return;
+        }
+        c->estado = CONEXAO_ENVIANDO;
+    }
+    if (c->estado == CONEXAO_ENVIANDO && !escrever(c)) {
+        falhar(tc, c, agora);
+        return;
+    }
+    if (c->estado == CONEXAO_AGUARDANDO && (eventos & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+        ler(tc, c, agora);
+    }
+}
+
+// ═══════════════════════════════════════════════════════════
+//                    THREADS DE CARGA
+// ═══════════════════════════════════════════════════════════
+
+static void retomar_pausadas(ThreadCarga *tc, uint64_t agora) {
+    while (tc->pausadas != NULL && tc->pausadas->retomar_us <= agora) {
+        Conexao *c = tc->pausadas;
+        tc->pausadas = c->prox;
+        if (tc->pausadas == NULL) tc->ultima_pausada = NULL;
+        liberar(tc, c);
+    }
+}
+
+static uint64_t proxima_chegada(const ThreadCarga *tc) {
+    return (uint64_t)(tc->primeira_us + (double)tc->emitidas * tc->intervalo_us);
+}
+
+/*
+ * Entrega trabalho às conexões livres. No laço aberto, cada chegada vencida
+ * sai com seu instante planejado: se todas as conexões estavam ocupadas, a
+ * espera entra na latência em vez de desaparecer.
+ */
+static void distribuir(ThreadCarga *tc, uint64_t agora) {
+    retomar_pausadas(tc, agora);
+    while (tc->livres != NULL) {
+        uint64_t planejado = agora;
+        if (taxa > 0) {
+            planejado = proxima_chegada(tc);
+            if (planejado > agora) break;
+            tc->emitidas++;
+        }
+        Conexao *c = tc->livres;
+        tc->livres = c->prox;
+        despachar(tc, c, planejado, agora);
+    }
+}
+
+// Até o próximo evento de tempo: chegada planejada, fim de pausa ou fim do teste
+static int espera_ms(const ThreadCarga *tc, uint64_t agora) {
+    uint64_t alvo = fim_us;
+    if (taxa > 0 && tc->livres != NULL && proxima_chegada(tc) < alvo) alvo = proxima_chegada(tc);
+    if (tc->pausadas != NULL && tc->pausadas->retomar_us < alvo) alvo = tc->pausadas->retomar_us;
+    return alvo <= agora ? 0 : (int)((alvo - agora) / 1000u);
+}
+
+static void *executar_thread(void *arg) {
+    ThreadCarga *tc = arg;
+    struct epoll_event eventos[MAX_EVENTOS];
+
+    for (;;) {
+        uint64_t agora = agora_us();
+        if (agora >= fim_us) break;
+        distribuir(tc, agora);
+
+        int n = epoll_wait(tc->epoll_fd, eventos, MAX_EVENTOS, espera_ms(tc, agora));
+        agora = agora_us();
+        for (int i = 0; i < n; i++) {
+            conexao_evento(tc, eventos[i].data.ptr, eventos[i].events, agora);
+        }
+    }
+
+    // Chegadas planejadas que nenhuma conexão chegou a enviar
+    if (taxa > 0) {
+        while (proxima_chegada(tc) < fim_us) {
+            if (proxima_chegada(tc) >= inicio_us) tc->res.nao_enviadas++;
+            tc->emitidas++;
+        }
+    }
+    return NULL;
+}
+
+static void preparar_thread(ThreadCarga *tc, int id, Conexao *conexoes, int n, uint64_t partida) {
+    memset(tc, 0, sizeof(*tc));
+    tc->id = id;
+    tc->conexoes = conexoes;
+    tc->num_conexoes = n;
+    tc->semente = ((uint64_t)getpid() << 32) ^ (0x9e3779b97f4a7c15ull * (uint64_t)(id + 1));
+    tc->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (tc->epoll_fd < 0) {
+        perror("❌ Erro no epoll_create1");
+        exit(1);
+    }
+    if (taxa > 0) {
+        // Fases deslocadas: as threads não disparam em sincronia
+        tc->intervalo_us = 1e6 * num_threads / taxa;
+        tc->primeira_us = (double)partida + tc->intervalo_us * id / num_threads;
+    }
+    for (int i = n - 1; i >= 0; i--) {
+        liberar(tc, &conexoes[i]);
+    }
+}
+
+// ═══════════════════════════════════════════════════════════
+//                    PREPARAÇÃO (contas e tokens)
+// ═══════════════════════════════════════════════════════════
+
+// Uma requisição com socket bloqueante; retorna o status ou -1
+static int requisicao_simples(Conexao *c) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&destino, sizeof(destino)) < 0 ||
+        send(fd, c->req, c->req_len, MSG_NOSIGNAL) != (ssize_t)c->req_len) {
+        close(fd);
+        return -1;
+    }
+    int status = 0;
+    bool fechar;
+    while (status == 0) {
+        ssize_t n = recv(fd, c->resp + c->resp_len, TAM_RESPOSTA - c->resp_len, 0);
+        if (n <= 0) {
+            status = -1;
+            break;
+        }
+        c->resp_len += (size_t)n;
+        status = analisar_resposta(c, &fechar);
+    }
+    close(fd);
+    return status;
+}
+
+// Repete enquanto o servidor pedir para esperar (limite de taxa, fila cheia)
+static int requisicao_insistente(Conexao *c, const char *caminho, const char *corpo) {
+    for (int tentativa = 0; tentativa < 60; tentativa++) {
+        c->req_len = montar_post(c->req, caminho, corpo);
+        c->resp_len = 0;
+        int status = requisicao_simples(c);
+        if (status != 429 && status != 503) return status;
+        sleep(1);
+    }
+    return -1;
+}
+
+static void preparar_usuarios(void) {
+    usuarios = calloc((size_t)num_usuarios, sizeof(*usuarios));
+    tokens = calloc((size_t)num_usuarios, sizeof(*tokens));
+    Conexao *c = calloc(1, sizeof(Conexao));
+    if (usuarios == NULL || tokens == NULL || c == NULL) {
+        fprintf(stderr, "❌ Sem memória\n");
+        exit(1);
+    }
+    bool manter = manter_conexao;
+    manter_conexao = false;
+
+    printf("👥 Registrando %d usuários de teste e obtendo tokens...\n", num_usuarios);
+    fflush(stdout);
+    for (int i = 0; i < num_usuarios; i++) {
+        char corpo[160];
+        snprintf(usuarios[i], sizeof(usuarios[i]), "carga%d_u%d", (int)getpid(), i);
+        snprintf(corpo, sizeof(corpo), "{\"username\":\"%s\",\"password\":\"%s\"}",
+                 usuarios[i], SENHA_CARGA);
+
+        int status = requisicao_insistente(c, "/register", corpo);
+        if (status != 200) {
+            fprintf(stderr, "❌ /register de %s falhou (status %d)\n", usuarios[i], status);
+            exit(1);
+        }
+        c->op = OP_LOGIN;
+        c->token[0] = '\0';
+        status = requisicao_insistente(c, "/login", corpo);
+        if (status != 200 || c->token[0] == '\0') {
+            fprintf(stderr, "❌ /login de %s falhou (status %d)\n", usuarios[i], status);
+            exit(1);
+        }
+        memcpy(tokens[i], c->token, sizeof(tokens[i]));
+    }
+    manter_conexao = manter;
+    free(c);
+}
+
+// ═══════════════════════════════════════════════════════════
+//                    RELATÓRIO
+// ═══════════════════════════════════════════════════════════
+
+static void imprimir_latencias(const char *titulo, const Histograma h[NUM_OPS]) {
+    static const double PERCENTIS[] = { 50, 90, 99, 99.9, 99.99 };
+    printf("\n%s (ms)\n", titulo);
+    printf("  %-9s %10s %9s %9s %9s %9s %9s %9s\n",
+           "operação", "n", "p50", "p90", "p99", "p99.9", "p99.99", "máx");
+
+    Histograma total;
+    memset(&total, 0, sizeof(total));
+    for (int op = 0; op <= NUM_OPS; op++) {
+        const Histograma *x = op < NUM_OPS ? &h[op] : &total;
+        if (op < NUM_OPS) histograma_somar(&total, x);
+        if (x->total == 0) continue;
+        printf("  %-9s %10" PRIu64, op < NUM_OPS ? NOMES_OP[op] : "total", x->total);
+        for (size_t p = 0; p < sizeof(PERCENTIS) / sizeof(PERCENTIS[0]); p++) {
+            printf(" %9.3f", (double)percentil(x, PERCENTIS[p]) / 1000.0);
+        }
+        printf(" %9.3f\n", (double)x->maximo / 1000.0);
+    }
+}
+
+static void relatorio(const ThreadCarga *threads) {
+    Resultados *r = calloc(1, sizeof(Resultados));
+    if (r == NULL) return;
+    for (int t = 0; t < num_threads; t++) {
+        const Resultados *x = &threads[t].res;
+        for (int op = 0; op < NUM_OPS; op++) {
+            histograma_somar(&r->latencia[op], &x->latencia[op]);
+            histograma_somar(&r->servico[op], &x->servico[op]);
+            for (size_t i = 0; i < NUM_CODIGOS; i++) r->codigos[op][i] += x->codigos[op][i];
+            r->erros[op] += x->erros[op];
+        }
+        r->nao_enviadas += x->nao_enviadas;
+    }
+
+    double segundos = duracao_s - aquecimento_s;
+    uint64_t total = 0, erros = 0;
+    for (int op = 0; op < NUM_OPS; op++) {
+        total += r->latencia[op].total;
+        erros += r->erros[op];
+    }
+    printf("\n═══════════════════════════════════════════════════════════\n");
+    printf("📊 %" PRIu64 " respostas em %.1f s: %.1f req/s", total, segundos, (double)total / segundos);
+    if (taxa > 0) printf(" (alvo %.1f req/s)", taxa);
+    printf("\n   Erros de conexão/protocolo: %" PRIu64 "\n", erros);
+    if (taxa > 0) {
+        printf("   Chegadas planejadas não enviadas: %" PRIu64 "\n", r->nao_enviadas);
+    }
+
+    printf("\nStatus por operação\n  %-9s", "operação");
+    for (size_t i = 0; i < NUM_CODIGOS - 1; i++) printf(" %8d", CODIGOS[i]);
+    printf(" %8s %8s\n", "outros", "erros");
+    for (int op = 0; op < NUM_OPS; op++) {
+        if (r->latencia[op].total == 0 && r->erros[op] == 0) continue;
+        printf("  %-9s", NOMES_OP[op]);
+        for (size_t i = 0; i < NUM_CODIGOS; i++) printf(" %8" PRIu64, r->codigos[op][i]);
+        printf(" %8" PRIu64 "\n", r->erros[op]);
+    }
+
+    if (taxa > 0) {
+        imprimir_latencias("Latência desde a chegada planejada (corrige omissão coordenada)", r->latencia);
+        imprimir_latencias("Tempo de serviço (desde o envio)", r->servico);
+    } else {
+        imprimir_latencias("Tempo de serviço, laço fechado (use -r para corrigir omissão coordenada)",
+                           r->servico);
+    }
+    free(r);
+}
+
+// ═══════════════════════════════════════════════════════════
+//                         MAIN
+// ═══════════════════════════════════════════════════════════
+
+static void uso(const char *prog) {
+    fprintf(stderr, "Uso: %s [-H HOST] [-p PORTA] [-c N] [-t N] [-d S] [-w S] [-r TAXA]\n"
+                    "          [-m MISTURA] [-u N] [-e N] [-K]\n", prog);
+    fprintf(stderr, "  -H HOST     Endereço IPv4 do servidor (padrão 127.0.0.1)\n");
+    fprintf(stderr, "  -p PORTA    Porta (padrão 8080)\n");
+    fprintf(stderr, "  -c N        Conexões simultâneas (padrão 16)\n");
+    fprintf(stderr, "  -t N        Threads (padrão 1)\n");
+    fprintf(stderr, "  -d S        Duração em segundos (padrão 10)\n");
+    fprintf(stderr, "  -w S        Aquecimento: os primeiros S segundos não são medidos\n");
+    fprintf(stderr, "  -r TAXA     Laço aberto: requisições/s no total (padrão: laço fechado)\n");
+    fprintf(stderr, "  -m MISTURA  Pesos por operação, ex.: validate=90,login=5,logout=3,register=2\n");
+    fprintf(stderr, "  -u N        Usuários de teste criados antes da medição (padrão 16)\n");
+    fprintf(stderr, "  -e N        Espalhar conexões por N endereços de origem 127.0.X.1, cada\n");
+    fprintf(stderr, "              um numa /24 diferente (servidor local; contorna o limite\n");
+    fprintf(stderr, "              de taxa por IP para testar o KDF)\n");
+    fprintf(stderr, "  -K          Sem keep-alive: uma conexão nova por requisição\n");
+}
+
+static bool ler_mistura(char *texto) {
+    unsigned novos[NUM_OPS] = {0};
+    for (char *item = strtok(texto, ","); item != NULL; item = strtok(NULL, ",")) {
+        char *igual = strchr(item, '=');
+        if (igual == NULL) return false;
+        *igual = '\0';
+        int op = 0;
+        while (op < NUM_OPS && strcmp(item, NOMES_OP[op]) != 0) op++;
+        if (op == NUM_OPS) return false;
+        novos[op] = (unsigned)atoi(igual + 1);
+    }
+    unsigned soma = 0;
+    for (int op = 0; op < NUM_OPS; op++) soma += novos[op];
+    if (soma == 0) return false;
+    memcpy(pesos, novos, sizeof(pesos));
+    soma_pesos = soma;
+    return true;
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool tem_valor = i + 1 < argc;
+        if (strcmp(arg, "-H") == 0 && tem_valor) {
+            host = argv[++i];
+        } else if (strcmp(arg, "-p") == 0 && tem_valor) {
+            porta = atoi(argv[++i]);
+        } else if (strcmp(arg, "-c") == 0 && tem_valor) {
+            num_conexoes = atoi(argv[++i]);
+        } else if (strcmp(arg, "-t") == 0 && tem_valor) {
+            num_threads = atoi(argv[++i]);
+        } else if (strcmp(arg, "-d") == 0 && tem_valor) {
+            duracao_s = atof(argv[++i]);
+        } else if (strcmp(arg, "-w") == 0 && tem_valor) {
+            aquecimento_s = atof(argv[++i]);
+        } else if (strcmp(arg, "-r") == 0 && tem_valor) {
+            taxa = atof(argv[++i]);
+        } else if (strcmp(arg, "-m") == 0 && tem_valor) {
+            if (!ler_mistura(argv[++i])) {
+                uso(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(arg, "-u") == 0 && tem_valor) {
+            num_usuarios = atoi(argv[++i]);
+        } else if (strcmp(arg, "-e") == 0 && tem_valor) {
+            num_origens = atoi(argv[++i]);
+        } else if (strcmp(arg, "-K") == 0) {
+            manter_conexao = false;
+        } else {
+            uso(argv[0]);
+            return 1;
+        }
+    }
+    if (num_threads < 1) num_threads = 1;
+    if (num_threads > MAX_THREADS) num_threads = MAX_THREADS;
+    if (num_conexoes < num_threads) num_conexoes = num_threads;
+    if (num_conexoes > MAX_CONEXOES) num_conexoes = MAX_CONEXOES;
+    if (num_usuarios < 1) num_usuarios = 1;
+    if (num_origens < 1 || num_origens > 256) num_origens = num_origens < 1 ? 1 : 256;
+    if (duracao_s <= 0 || aquecimento_s < 0 || aquecimento_s >= duracao_s || taxa < 0) {
+        uso(argv[0]);
+        return 1;
+    }
+
+    memset(&destino, 0, sizeof(destino));
+    destino.sin_family = AF_INET;
+    destino.sin_port = htons((uint16_t)porta);
+    if (inet_pton(AF_INET, host, &destino.sin_addr) != 1) {
+        fprintf(stderr, "❌ Endereço inválido: %s\n", host);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    preparar_usuarios();
+
+    Conexao *conexoes = calloc((size_t)num_conexoes, sizeof(Conexao));
+    ThreadCarga *threads = calloc((size_t)num_threads, sizeof(ThreadCarga));
+    if (conexoes == NULL || threads == NULL) {
+        fprintf(stderr, "❌ Sem memória\n");
+        return 1;
+    }
+    for (int i = 0; i < num_conexoes; i++) {
+        conexoes[i].fd = -1;
+        if (num_origens > 1) {
+            conexoes[i].origem = htonl(0x7f000001u | ((uint32_t)(i % num_origens) << 8));
+        }
+    }
+
+    printf("🚀 %s, %d conexões em %d thread%s, %.0f s (%.0f s de aquecimento)%s\n",
+           taxa > 0 ? "Laço aberto" : "Laço fechado", num_conexoes, num_threads,
+           num_threads > 1 ? "s" : "", duracao_s, aquecimento_s,
+           manter_conexao ? "" : ", sem keep-alive");
+    printf("   Mistura:");
+    for (int op = 0; op < NUM_OPS; op++) printf(" %s=%u", NOMES_OP[op], pesos[op]);
+    printf("\n");
+    fflush(stdout);
+
+    // Conexões distribuídas em blocos contíguos, uma fatia por thread
+    uint64_t partida = agora_us();
+    inicio_us = partida + (uint64_t)(aquecimento_s * 1e6);
+    fim_us = partida + (uint64_t)(duracao_s * 1e6);
+    int base = 0;
+    for (int t = 0; t < num_threads; t++) {
+        int n = num_conexoes / num_threads + (t < num_conexoes % num_threads ? 1 : 0);
+        preparar_thread(&threads[t], t, conexoes + base, n, partida);
+        base += n;
+    }
+    for (int t = 0; t < num_threads; t++) {
+        if (pthread_create(&threads[t].thread, NULL, executar_thread, &threads[t]) != 0) {
+            perror("❌ Erro ao criar thread");
+            return 1;
+        }
+    }
+    for (int t = 0; t < num_threads; t++) {
+        pthread_join(threads[t].thread, NULL);
+    }
+
+    relatorio(threads);
+
+    for (int i = 0; i < num_conexoes; i++) fechar_socket(&conexoes[i]);
+    for (int t = 0; t < num_threads; t++) close(threads[t].epoll_fd);
+    free(conexoes);
+    free(threads);
+    free(usuarios);
+    free(tokens);
+    return 0;
+}
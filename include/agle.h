@@ -24,16 +24,83 @@ extern "C" {
  * AGLE Context - Main Structure
  * ============================================================================ */
 
+#if defined(__GNUC__) || defined(__clang__)
+#define AGLE_CACHE_ALIGNED __attribute__((aligned(64)))
+#else
+#define AGLE_CACHE_ALIGNED
+#endif
+
+#define AGLE_STATE_SIZE 64
+
 /**
- * @brief Opaque-like context for AGLE operations.
+ * @brief Opaque-like context for AGLE operations (192 bytes).
+ *
+ * Hot metadata fills the first cache line; the secret state sits on its
+ * own line so flag and counter checks never pull key material into cache.
  */
 typedef struct {
-    uint8_t state[256];
-    size_t position;
-    int urandom_fd;
-    uint8_t entropy_pool[4096];
+    uint32_t flags;           /* AGLE_CTX_* state bits */
+    uint32_t init_flags;      /* AGLE_INIT_* options given at init */
+    uint32_t backend;         /* AGLE_Backend in use */
+    uint32_t health_discards; /* Inputs discarded after a failed health test */
+    uint64_t reseed_counter;  /* Generate requests since last (re)seed */
+    uint64_t seed_counter;    /* Successful seeds and reseeds since init */
+    uint64_t split_counter;
+    uint64_t entropy_counter; /* Deterministic entropy blocks drawn */
+    uint64_t health_inputs;   /* Entropy inputs that passed health tests */
+    uint64_t health_samples;  /* Bytes that passed health tests */
+    uint8_t state[AGLE_STATE_SIZE] AGLE_CACHE_ALIGNED;
+    uint8_t seed_key[32];     /* Deterministic mode only */
 } AGLE_CTX;
 
+/**
+ * @brief Context state bits (AGLE_CTX.flags).
+ */
+#define AGLE_CTX_SEEDED 0x1u
+#define AGLE_CTX_DETERMINISTIC 0x2u
+#define AGLE_CTX_HEALTH_RCT_FAIL 0x4u    /* SP 800-90B repetition count */
+#define AGLE_CTX_HEALTH_APT_FAIL 0x8u    /* SP 800-90B adaptive proportion */
+#define AGLE_CTX_HEALTH_FAILED (AGLE_CTX_HEALTH_RCT_FAIL | AGLE_CTX_HEALTH_APT_FAIL)
+
+/**
+ * @brief Initialization flags for AGLE_InitEx().
+ */
+typedef enum {
+    AGLE_INIT_DEFAULT = 0,    /* Seed immediately */
+    AGLE_INIT_LAZY = 1        /* Defer seeding until first use */
+} AGLE_InitFlags;
+
+/**
+ * @brief Generator backends selectable with AGLE_InitEx().
+ */
+typedef enum {
+    AGLE_BACKEND_SHAKE256 = 0,        /* SHAKE256 over fresh entropy (default) */
+    AGLE_BACKEND_AES256_CTR_DRBG = 1, /* SP 800-90A CTR_DRBG, AES-NI when available */
+    AGLE_BACKEND_CHACHA20 = 2         /* ChaCha20 with fast key erasure */
+} AGLE_Backend;
+
+/**
+ * @brief Options for AGLE_InitEx(). Zero-initialize for defaults.
+ */
+typedef struct {
+    uint32_t flags;           /* AGLE_InitFlags */
+    uint32_t backend;         /* AGLE_Backend */
+    const uint8_t *seed;      /* Non-NULL: deterministic mode (tests only) */
+    size_t seed_len;
+} AGLE_InitOptions;
+
+/**
+ * @brief Compact child generator derived with AGLE_Split() (40 bytes).
+ *
+ * Deterministic SHAKE256 stream keyed by a secret derived from the parent.
+ * Small enough to embed in task descriptors; not thread-safe, each task
+ * owns its own child.
+ */
+typedef struct {
+    uint8_t key[32];
+    uint64_t counter;
+} AGLE_SPLIT_CTX;
+
 /* ============================================================================
  * Core RNG Functions
  * ============================================================================ */
@@ -45,6 +112,41 @@ typedef struct {
  */
 bool AGLE_Init(AGLE_CTX *ctx);
 
+/**
+ * Initialize AGLE context with options
+ * With AGLE_INIT_LAZY no entropy is read here; the context is seeded on
+ * the first call that needs it, which then reports any seeding failure.
+ * @param ctx: AGLE context pointer
+ * @param opts: Options, or NULL for defaults (same as AGLE_Init)
+ * @return: true on success, false on failure (including unknown backend)
+ */
+bool AGLE_InitEx(AGLE_CTX *ctx, const AGLE_InitOptions *opts);
+
+/**
+ * Initialize AGLE context in deterministic mode
+ * Runs the normal generation pipeline, but every entropy input is drawn
+ * from a SHAKE256 stream keyed by the seed instead of the kernel. Output
+ * is reproducible bit-for-bit: use for benchmarks and known-answer tests,
+ * NEVER for production secrets.
+ * @param ctx: AGLE context pointer
+ * @param seed: Seed bytes
+ * @param seed_len: Seed length (> 0, 32 or more recommended)
+ * @return: true on success, false on failure
+ */
+bool AGLE_InitSeeded(AGLE_CTX *ctx, const uint8_t *seed, size_t seed_len);
+
+/**
+ * Check the continuous health tests of a context
+ * Every entropy input is run through the SP 800-90B repetition count and
+ * adaptive proportion tests. A failing input is discarded and replaced
+ * (counted in health_discards); only after three failures in a row does
+ * the context fail closed: its state is wiped and every call returns false
+ * until it is re-initialized.
+ * @param ctx: AGLE context
+ * @return: true if no health test has failed, false otherwise
+ */
+bool AGLE_IsHealthy(const AGLE_CTX *ctx);
+
 /**
  * Generate cryptographic random bytes
  * @param ctx: AGLE context
@@ -77,6 +179,51 @@ bool AGLE_GetRandom64(AGLE_CTX *ctx, uint64_t *out);
  */
 void AGLE_Cleanup(AGLE_CTX *ctx);
 
+/* ============================================================================
+ * Splittable Generators
+ * ============================================================================ */
+
+/**
+ * Derive an independent child generator from a context
+ * No syscalls: the child key is SHAKE256(parent state, split counter),
+ * so the same parent yields the same sequence of children.
+ * @param parent: Initialized AGLE context
+ * @param child: Output child generator
+ * @return: true on success, false on failure
+ */
+bool AGLE_Split(AGLE_CTX *parent, AGLE_SPLIT_CTX *child);
+
+/**
+ * Derive a grandchild from a child generator (recursive task spawning)
+ * @param parent: Child generator to split
+ * @param child: Output child generator
+ * @return: true on success, false on failure
+ */
+bool AGLE_SplitChild(AGLE_SPLIT_CTX *parent, AGLE_SPLIT_CTX *child);
+
+/**
+ * Generate random bytes from a child generator
+ * @param ctx: Child generator
+ * @param out: Output buffer
+ * @param n: Number of bytes to generate
+ * @return: true on success, false on failure
+ */
+bool AGLE_SplitGetRandomBytes(AGLE_SPLIT_CTX *ctx, uint8_t *out, size_t n);
+
+/**
+ * Generate a random 64-bit integer from a child generator
+ * @param ctx: Child generator
+ * @param out: Pointer to output value
+ * @return: true on success, false on failure
+ */
+bool AGLE_SplitGetRandom64(AGLE_SPLIT_CTX *ctx, uint64_t *out);
+
+/**
+ * Clear a child generator
+ * @param ctx: Child generator
+ */
+void AGLE_SplitCleanup(AGLE_SPLIT_CTX *ctx);
+
 /* ============================================================================
  * Password Generation
  * ============================================================================ */
@@ -189,6 +336,35 @@ bool AGLE_GenerateSessionToken(AGLE_CTX *ctx, uint8_t *token, size_t token_len);
  */
 bool AGLE_GenerateSessionTokenHex(AGLE_CTX *ctx, char *token_hex, size_t token_bytes);
 
+/*
+ * Checked tokens: AGLE_CHECKED_TOKEN_PREFIX + hex(random bytes) + 8 hex
+ * digits of CRC32C over everything before them. The checksum is not a MAC;
+ * it lets AGLE_CheckSessionToken() turn away truncated, mistyped or random
+ * strings in a few nanoseconds, before any digest, table lookup or
+ * constant-time compare is spent on them.
+ */
+#define AGLE_CHECKED_TOKEN_PREFIX "agle_"
+#define AGLE_CHECKED_TOKEN_LEN(token_bytes) \
+    (sizeof(AGLE_CHECKED_TOKEN_PREFIX) - 1 + 2 * (token_bytes) + 8)
+
+/**
+ * Generate a checked session token
+ * @param ctx: AGLE context
+ * @param token: Output string (min AGLE_CHECKED_TOKEN_LEN(token_bytes) + 1)
+ * @param token_bytes: Random bytes in the token (16-512)
+ * @return: true on success, false on failure
+ */
+bool AGLE_GenerateSessionTokenChecked(AGLE_CTX *ctx, char *token, size_t token_bytes);
+
+/**
+ * Check the form of a token from AGLE_GenerateSessionTokenChecked: length,
+ * prefix and checksum. Says nothing about whether the session exists.
+ * @param token: Candidate token (need not be NUL-terminated)
+ * @param token_len: Length in characters
+ * @return: true if well-formed
+ */
+bool AGLE_CheckSessionToken(const char *token, size_t token_len);
+
 /**
  * Generate cryptographic nonce (number used once)
  * @param ctx: AGLE context
@@ -197,6 +373,562 @@ bool AGLE_GenerateSessionTokenHex(AGLE_CTX *ctx, char *token_hex, size_t token_b
  */
 uint64_t AGLE_GenerateNonce(AGLE_CTX *ctx, uint8_t *nonce);
 
+/* ============================================================================
+ * Session Store
+ * ============================================================================ */
+
+#define AGLE_SESSION_USERNAME_MAX 64
+
+/**
+ * @brief Session record kept by AGLE_SESSION_STORE (times in seconds).
+ */
+typedef struct {
+    char username[AGLE_SESSION_USERNAME_MAX];
+    int64_t created_at;
+    int64_t expires_at;
+} AGLE_SessionInfo;
+
+/**
+ * @brief Thread-safe session table keyed by a SHAKE256 digest of the token.
+ *
+ * Lock-striped open addressing: a lookup hashes the token once, probes a
+ * single shard under its read lock and compares the full digest of the one
+ * candidate slot in constant time. Shards grow independently. Tokens
+ * themselves are never stored.
+ */
+typedef struct AGLE_SESSION_STORE AGLE_SESSION_STORE;
+
+/**
+ * Create a session store
+ * @param expected_sessions: Sizing hint (0 for a small default); the table grows as needed
+ * @return: Store, or NULL on allocation failure
+ */
+AGLE_SESSION_STORE* AGLE_SessionStoreNew(size_t expected_sessions);
+
+/**
+ * Free a session store and wipe its records
+ * @param store: Store (may be NULL)
+ */
+void AGLE_SessionStoreFree(AGLE_SESSION_STORE *store);
+
+/**
+ * Add a session
+ * @param store: Session store
+ * @param token: Session token (any bytes, typically hex from AGLE_GenerateSessionTokenHex)
+ * @param token_len: Token length
+ * @param info: Record to store
+ * @return: true on success, false if the token exists or on allocation failure
+ */
+bool AGLE_SessionInsert(AGLE_SESSION_STORE *store, const char *token, size_t token_len,
+                        const AGLE_SessionInfo *info);
+
+/**
+ * Look up a live session
+ * @param store: Session store
+ * @param token: Session token
+ * @param token_len: Token length
+ * @param now: Current time; sessions with expires_at <= now are not returned
+ * @param out: Copy of the record (may be NULL)
+ * @return: true if the session exists and has not expired
+ */
+bool AGLE_SessionLookup(AGLE_SESSION_STORE *store, const char *token, size_t token_len,
+                        int64_t now, AGLE_SessionInfo *out);
+
+/**
+ * Look up many live sessions at once
+ * Tokens are hashed a window at a time, grouped by shard and probed under
+ * one read lock per shard, with the next candidate slots prefetched. Cheaper
+ * than count calls to AGLE_SessionLookup() for large batches.
+ * @param store: Session store
+ * @param tokens: count token pointers (NULL entries are not found)
+ * @param token_lens: count token lengths
+ * @param count: Number of tokens
+ * @param now: Current time; sessions with expires_at <= now are not returned
+ * @param out: count records, zeroed where not found (may be NULL)
+ * @param found: count flags, set where the session exists and has not expired
+ * @return: Number of sessions found (0 if found is NULL or on allocation failure)
+ */
+size_t AGLE_SessionLookupBatch(AGLE_SESSION_STORE *store, const char *const *tokens,
+                               const size_t *token_lens, size_t count, int64_t now,
+                               AGLE_SessionInfo *out, bool *found);
+
+/**
+ * Remove a session
+ * @param store: Session store
+ * @param token: Session token
+ * @param token_len: Token length
+ * @param out: Copy of the removed record (may be NULL)
+ * @return: true if a session was removed
+ */
+bool AGLE_SessionRemove(AGLE_SESSION_STORE *store, const char *token, size_t token_len,
+                        AGLE_SessionInfo *out);
+
+/**
+ * Expire sessions on the store's timing wheel
+ * Call about once per second (e.g. from an event loop tick); the cost is
+ * proportional to the sessions that expire, not to the table size. Safe to
+ * call from several threads.
+ * @param store: Session store
+ * @param now: Current time in seconds
+ * @return: Number of sessions removed
+ */
+size_t AGLE_SessionStoreTick(AGLE_SESSION_STORE *store, int64_t now);
+
+/**
+ * Remove every session with expires_at <= now (full sweep of all shards)
+ * Prefer AGLE_SessionStoreTick(); this is for callers without a periodic tick.
+ * @param store: Session store
+ * @param now: Current time
+ * @return: Number of sessions removed
+ */
+size_t AGLE_SessionStorePurge(AGLE_SESSION_STORE *store, int64_t now);
+
+/**
+ * Number of sessions held (including expired ones not yet purged)
+ * @param store: Session store
+ * @return: Session count
+ */
+size_t AGLE_SessionStoreCount(const AGLE_SESSION_STORE *store);
+
+/**
+ * Number of slots currently allocated across all shards
+ * Count / capacity is the table occupancy; shards grow past 3/4.
+ * @param store: Session store
+ * @return: Slot count
+ */
+size_t AGLE_SessionStoreCapacity(const AGLE_SESSION_STORE *store);
+
+/* ============================================================================
+ * User Directory
+ * ============================================================================ */
+
+#define AGLE_USERNAME_MAX 64      /* Including the terminating NUL */
+#define AGLE_USER_SALT_LEN 16
+#define AGLE_USER_HASH_LEN 32
+
+/**
+ * @brief Copy of one account held by AGLE_USER_DIR.
+ */
+typedef struct {
+    char username[AGLE_USERNAME_MAX];
+    uint8_t salt[AGLE_USER_SALT_LEN];
+    uint8_t hash[AGLE_USER_HASH_LEN];
+    uint32_t kdf_iterations;      /* Cost the hash was made with (0 = caller's legacy scheme) */
+    uint32_t failed_attempts;
+    int64_t locked_until;
+} AGLE_UserRecord;
+
+/**
+ * @brief Thread-safe account table with O(1) lookup by username.
+ *
+ * Usernames are indexed in a SipHash-keyed open-addressing table (random
+ * key per directory). Records are stored column-wise (names, salts, hashes,
+ * lockout state) and addressed by a dense id that never changes; records
+ * are never removed. Lookups and lockout updates run concurrently under a
+ * shared lock; only inserts that grow the table take it exclusively.
+ */
+typedef struct AGLE_USER_DIR AGLE_USER_DIR;
+
+/**
+ * Create a user directory
+ * @param expected_users: Sizing hint (0 for a small default); the table grows as needed
+ * @return: Directory, or NULL on failure
+ */
+AGLE_USER_DIR* AGLE_UserDirNew(size_t expected_users);
+
+/**
+ * Free a user directory and wipe its records
+ * @param dir: Directory (may be NULL)
+ */
+void AGLE_UserDirFree(AGLE_USER_DIR *dir);
+
+/**
+ * Add an account
+ * @param dir: User directory
+ * @param username: NUL-terminated, at most AGLE_USERNAME_MAX - 1 bytes
+ * @param salt: AGLE_USER_SALT_LEN bytes
+ * @param hash: AGLE_USER_HASH_LEN bytes
+ * @param kdf_iterations: KDF cost stored with the hash, so it can be raised later
+ * @param id_out: Id of the new record (may be NULL)
+ * @return: true on success, false if the name exists, is too long, or on allocation failure
+ */
+bool AGLE_UserDirAdd(AGLE_USER_DIR *dir, const char *username,
+                     const uint8_t *salt, const uint8_t *hash,
+                     uint32_t kdf_iterations, uint32_t *id_out);
+
+/**
+ * Find an account by username
+ * @param dir: User directory
+ * @param username: NUL-terminated username
+ * @param id_out: Id of the record (may be NULL)
+ * @return: true if found
+ */
+bool AGLE_UserDirFind(AGLE_USER_DIR *dir, const char *username, uint32_t *id_out);
+
+/**
+ * Copy a record
+ * @param dir: User directory
+ * @param id: Record id (0 .. AGLE_UserDirCount() - 1)
+ * @param out: Copy of the record
+ * @return: true on success, false if id is out of range
+ */
+bool AGLE_UserDirGet(AGLE_USER_DIR *dir, uint32_t id, AGLE_UserRecord *out);
+
+/**
+ * Count a failed login (atomic)
+ * @param dir: User directory
+ * @param id: Record id
+ * @return: Failed attempts including this one (0 if id is out of range)
+ */
+uint32_t AGLE_UserDirNoteFailure(AGLE_USER_DIR *dir, uint32_t id);
+
+/**
+ * Reset failed attempts and lockout after a successful login (atomic)
+ * @param dir: User directory
+ * @param id: Record id
+ */
+void AGLE_UserDirNoteSuccess(AGLE_USER_DIR *dir, uint32_t id);
+
+/**
+ * Lock an account until a given time (atomic)
+ * @param dir: User directory
+ * @param id: Record id
+ * @param until: Time the lockout ends
+ */
+void AGLE_UserDirLock(AGLE_USER_DIR *dir, uint32_t id, int64_t until);
+
+/**
+ * Time the lockout of an account ends (atomic)
+ * @param dir: User directory
+ * @param id: Record id
+ * @return: Lockout end, 0 if not locked or id is out of range
+ */
+int64_t AGLE_UserDirLockedUntil(AGLE_USER_DIR *dir, uint32_t id);
+
+/**
+ * Number of accounts
+ * @param dir: User directory
+ * @return: Account count; ids are 0 .. count - 1
+ */
+size_t AGLE_UserDirCount(AGLE_USER_DIR *dir);
+
+/* ============================================================================
+ * Persistence
+ * ============================================================================ */
+
+/*
+ * Durable storage for a user directory and a session store:
+ * <prefix>.wal is an append-only, CRC32C-checked log of mutations written by
+ * a background thread with group commit (one write + fdatasync per batch);
+ * <prefix>.snap is a compact, mmap-able snapshot that replaces the log once
+ * it grows. Apply a mutation to the in-memory structure first, then log it.
+ */
+typedef struct AGLE_PERSIST AGLE_PERSIST;
+
+/**
+ * Load <prefix>.snap and replay <prefix>.wal into users and sessions, then
+ * start the writer thread. A torn record at the end of the log is dropped.
+ * @param path_prefix: Path of the files without extension
+ * @param users: Directory to restore into (normally empty)
+ * @param sessions: Session store to restore into; sessions expired at now are skipped
+ * @param now: Current time (unix seconds)
+ * @return: Handle or NULL on error (unreadable or corrupt snapshot, I/O error)
+ */
+AGLE_PERSIST* AGLE_PersistOpen(const char *path_prefix, AGLE_USER_DIR *users,
+                               AGLE_SESSION_STORE *sessions, int64_t now);
+
+/**
+ * Write everything queued, stop the writer thread and free the handle
+ * @param p: Handle (NULL is accepted)
+ */
+void AGLE_PersistClose(AGLE_PERSIST *p);
+
+/**
+ * Queue an account creation. Does not wait for the disk.
+ * @return: true if queued, false if the backlog is full or the log failed
+ */
+bool AGLE_PersistUserAdd(AGLE_PERSIST *p, const char *username,
+                         const uint8_t *salt, const uint8_t *hash,
+                         uint32_t kdf_iterations);
+
+/**
+ * Queue a session creation (only the token digest is stored)
+ * @return: true if queued, false if the backlog is full or the log failed
+ */
+bool AGLE_PersistSessionAdd(AGLE_PERSIST *p, const char *token, size_t token_len,
+                            const AGLE_SessionInfo *info);
+
+/**
+ * Queue a session removal
+ * @return: true if queued, false if the backlog is full or the log failed
+ */
+bool AGLE_PersistSessionRemove(AGLE_PERSIST *p, const char *token, size_t token_len);
+
+/**
+ * Ask the writer thread for a snapshot (also taken automatically when the
+ * log grows past 16 MiB). Does not wait; see AGLE_PersistFlush.
+ * @return: true if requested
+ */
+bool AGLE_PersistSnapshot(AGLE_PERSIST *p);
+
+/**
+ * Wait until everything queued so far (including a requested snapshot) is on disk
+ * @return: true on success, false if the log has failed
+ */
+bool AGLE_PersistFlush(AGLE_PERSIST *p);
+
+/* ============================================================================
+ * Rate Limiting
+ * ============================================================================ */
+
+/*
+ * Token buckets in a fixed-size table of 64-bit words, updated with CAS and
+ * no locks. Keys are not stored: each key hashes (keyed SipHash) to two
+ * buckets in one cache line and is admitted if either has a token, so a
+ * collision with a heavy key does not throttle a light one. Memory never
+ * grows with the number of clients.
+ */
+typedef struct AGLE_RATE_LIMITER AGLE_RATE_LIMITER;
+
+/**
+ * Create a limiter
+ * @param buckets: Table size (rounded up to a power of two, min 8); 8 bytes each
+ * @param rate_per_sec: Tokens added per second to each bucket
+ * @param burst: Bucket capacity (max 4000000)
+ * @return: Limiter or NULL on error
+ */
+AGLE_RATE_LIMITER* AGLE_RateLimiterNew(size_t buckets, uint32_t rate_per_sec, uint32_t burst);
+
+/**
+ * Free a limiter
+ * @param rl: Limiter (NULL is accepted)
+ */
+void AGLE_RateLimiterFree(AGLE_RATE_LIMITER *rl);
+
+/**
+ * Take one token for key
+ * @param key: Client identifier (e.g. IP address bytes)
+ * @param now_ms: Monotonic time in milliseconds; a coarse cached clock is
+ *                enough, and values slightly behind earlier calls are fine
+ * @return: true if allowed, false if the key is over its rate
+ */
+bool AGLE_RateLimitTake(AGLE_RATE_LIMITER *rl, const void *key, size_t key_len,
+                        uint64_t now_ms);
+
+/* ============================================================================
+ * Revocation Set
+ * ============================================================================ */
+
+/*
+ * Set of revoked ids (token ids, token digests) kept until they expire.
+ * A cuckoo filter of 16-bit fingerprints answers most lookups from one
+ * cache line; a fingerprint match is confirmed against a table of 128-bit
+ * keyed digests of the ids, so false positives are negligible. Memory is
+ * proportional to the number of ids held (40 to 70 bytes each): purges
+ * drop expired ids and shrink both structures.
+ */
+typedef struct AGLE_REVOCATION_SET AGLE_REVOCATION_SET;
+
+/**
+ * Create an empty set (thread-safe; 16 lock-striped shards)
+ * @return: Set or NULL on error
+ */
+AGLE_REVOCATION_SET* AGLE_RevocationSetNew(void);
+
+/**
+ * Free a set
+ * @param set: Set (NULL is accepted)
+ */
+void AGLE_RevocationSetFree(AGLE_REVOCATION_SET *set);
+
+/**
+ * Add an id, or extend its expiry if already present
+ * @param id_len: Id length (> 0); ids are stored as keyed digests
+ * @param expires_at: Kept until a purge with now >= expires_at
+ * @return: true on success, false on invalid input or allocation failure
+ */
+bool AGLE_RevocationAdd(AGLE_REVOCATION_SET *set, const void *id, size_t id_len,
+                        int64_t expires_at);
+
+/**
+ * Remove an id (un-revoke)
+ * @return: true if it was present
+ */
+bool AGLE_RevocationRemove(AGLE_REVOCATION_SET *set, const void *id, size_t id_len);
+
+/**
+ * Check an id. Ids past their expiry still count until the next purge.
+ * @return: true if revoked
+ */
+bool AGLE_RevocationContains(AGLE_REVOCATION_SET *set, const void *id, size_t id_len);
+
+/**
+ * Drop ids with expires_at <= now and rebuild the affected shards at the
+ * size of what is left. Shards with nothing expired are skipped.
+ * @return: Number of ids removed
+ */
+size_t AGLE_RevocationPurge(AGLE_REVOCATION_SET *set, int64_t now);
+
+/**
+ * Number of ids held
+ */
+size_t AGLE_RevocationCount(const AGLE_REVOCATION_SET *set);
+
+/**
+ * Bytes allocated by the set (filter, exact table and header)
+ */
+size_t AGLE_RevocationSetBytes(AGLE_REVOCATION_SET *set);
+
+/* ============================================================================
+ * Signed Tokens
+ * ============================================================================ */
+
+/*
+ * Stateless session tokens: "st1." + base64url(payload || tag), where the
+ * 24-byte payload holds key id, user id, expiry and a random token id, and
+ * the tag is a 128-bit KMAC256 over the payload. Any process holding the
+ * key validates a token with one parse and one short Keccak call; nothing
+ * is looked up. Logout adds the token id to the signer's revocation set
+ * until the token would have expired anyway.
+ */
+#define AGLE_SIGNED_TOKEN_PREFIX "st1."
+#define AGLE_SIGNED_TOKEN_LEN 58          /* Characters, without the NUL */
+#define AGLE_SIGNED_TOKEN_KEY_LEN 32      /* Recommended key length */
+#define AGLE_SIGNED_TOKEN_MAX_KEYS 4
+
+/**
+ * @brief Fields carried by a signed token (expires_at in seconds).
+ */
+typedef struct {
+    uint32_t key_id;
+    uint32_t user_id;
+    int64_t expires_at;
+    uint64_t token_id;        /* Random, never 0; identifies the token for revocation */
+} AGLE_TokenClaims;
+
+typedef struct AGLE_TOKEN_SIGNER AGLE_TOKEN_SIGNER;
+
+/**
+ * Create a signer. The KMAC key schedule is computed here once; signing
+ * and verifying only copy it.
+ * @param key_id: Identifier written into every token signed with key
+ * @param key: Secret key (16-64 bytes), or NULL for a fresh random key
+ *             that only this process knows
+ * @param key_len: Key length (ignored when key is NULL)
+ * @return: Signer or NULL on error
+ */
+AGLE_TOKEN_SIGNER* AGLE_TokenSignerNew(uint32_t key_id, const uint8_t *key, size_t key_len);
+
+/**
+ * Free a signer and wipe its keys
+ * @param signer: Signer (NULL is accepted)
+ */
+void AGLE_TokenSignerFree(AGLE_TOKEN_SIGNER *signer);
+
+/**
+ * Add a key and make it the signing key; earlier keys still verify. For
+ * rotation; call before the signer is shared between threads.
+ * @return: false if key_id is taken, the key is invalid or the signer
+ *          already holds AGLE_SIGNED_TOKEN_MAX_KEYS keys
+ */
+bool AGLE_TokenSignerAddKey(AGLE_TOKEN_SIGNER *signer, uint32_t key_id,
+                            const uint8_t *key, size_t key_len);
+
+/**
+ * Issue a token (thread-safe)
+ * @param ctx: AGLE context for the token id (one per thread)
+ * @param token: Output, AGLE_SIGNED_TOKEN_LEN + 1 bytes, NUL-terminated
+ * @param claims: Filled with the signed fields (may be NULL)
+ * @return: true on success, false on failure
+ */
+bool AGLE_TokenIssue(AGLE_TOKEN_SIGNER *signer, AGLE_CTX *ctx, uint32_t user_id,
+                     int64_t expires_at, char *token, AGLE_TokenClaims *claims);
+
+/**
+ * Verify a token (thread-safe)
+ * @param claims: Filled on success (may be NULL)
+ * @return: true if the tag is valid, the key is known, expires_at > now and
+ *          the token is not revoked
+ */
+bool AGLE_TokenVerify(AGLE_TOKEN_SIGNER *signer, const char *token, size_t token_len,
+                      int64_t now, AGLE_TokenClaims *claims);
+
+/**
+ * Revoke a verified token until its expiry (thread-safe)
+ * @return: true on success, false on allocation failure
+ */
+bool AGLE_TokenRevoke(AGLE_TOKEN_SIGNER *signer, const AGLE_TokenClaims *claims);
+
+/**
+ * Drop revocations of tokens that have expired by now
+ * @return: Number of entries removed
+ */
+size_t AGLE_TokenPurgeRevoked(AGLE_TOKEN_SIGNER *signer, int64_t now);
+
+/**
+ * Number of revocations currently held
+ */
+size_t AGLE_TokenRevokedCount(const AGLE_TOKEN_SIGNER *signer);
+
+/* ============================================================================
+ * Replay Cache
+ * ============================================================================ */
+
+/*
+ * Remembers (client, nonce) pairs of signed requests for as long as their
+ * timestamps are acceptable, so a replayed request is refused without a
+ * database round trip. Pairs are filed under the epoch (a quarter of the
+ * window) of the request's own timestamp, in a ring of per-epoch sets of
+ * 64-byte buckets stamped with their epoch: a bucket left from an older
+ * epoch counts as empty and is cleared on the next insert, so expiry costs
+ * nothing and memory is fixed. Each pair is a 32-bit fingerprint in one of
+ * two buckets; a fresh request is mistaken for a replay with probability
+ * below 1e-8.
+ */
+typedef struct AGLE_REPLAY_CACHE AGLE_REPLAY_CACHE;
+
+typedef enum {
+    AGLE_REPLAY_FRESH = 0,    /* First time seen, now recorded: accept */
+    AGLE_REPLAY_SEEN = 1,     /* Same client and nonce already seen: reject */
+    AGLE_REPLAY_STALE = 2,    /* Timestamp outside the window: reject */
+    AGLE_REPLAY_FULL = 3      /* More requests than the cache was sized for: reject */
+} AGLE_ReplayResult;
+
+/**
+ * Create a cache (thread-safe; 64 lock-striped shards)
+ * @param window_ms: Accepted clock difference between a request's timestamp
+ *                   and the server, either way (min 4)
+ * @param expected_per_window: Requests expected per window_ms across all
+ *                   clients; memory is about 22 bytes per request
+ * @return: Cache or NULL on error
+ */
+AGLE_REPLAY_CACHE* AGLE_ReplayCacheNew(uint64_t window_ms, size_t expected_per_window);
+
+/**
+ * Free a cache
+ * @param cache: Cache (NULL is accepted)
+ */
+void AGLE_ReplayCacheFree(AGLE_REPLAY_CACHE *cache);
+
+/**
+ * Check a request and record it if it is fresh. Only accept the request
+ * on AGLE_REPLAY_FRESH, after its signature (which must cover client,
+ * nonce and timestamp) has been verified.
+ * @param client: Client identifier (API key id, account)
+ * @param nonce: Request nonce (> 0 bytes)
+ * @param timestamp_ms: Request timestamp in milliseconds
+ * @param now_ms: Server time in the same clock; a coarse cached clock is enough
+ * @return: AGLE_ReplayResult
+ */
+AGLE_ReplayResult AGLE_ReplayCheck(AGLE_REPLAY_CACHE *cache, const void *client,
+                                   size_t client_len, const void *nonce, size_t nonce_len,
+                                   uint64_t timestamp_ms, uint64_t now_ms);
+
+/**
+ * Bytes allocated by the cache (fixed at creation)
+ */
+size_t AGLE_ReplayCacheBytes(const AGLE_REPLAY_CACHE *cache);
+
 /* ============================================================================
  * Utility Functions
  * ============================================================================ */
@@ -247,6 +979,13 @@ const char* AGLE_GetVersion(void);
  */
 const char* AGLE_GetInfo(void);
 
+/**
+ * Get library info including the backend active in a context
+ * @param ctx: AGLE context (NULL returns the same as AGLE_GetInfo)
+ * @return: Info string
+ */
+const char* AGLE_GetContextInfo(const AGLE_CTX *ctx);
+
 #ifdef __cplusplus
 }
 #endif
@@ -10,18 +10,10 @@
  */
 
 #define MAX_PASSWORD_LEN 256
-#define MAX_USERS 100
+#define KDF_ITERACOES 100000   // Gravado junto de cada hash
 
-typedef struct {
-    char username[64];
-    uint8_t salt[16];
-    uint8_t hash[32];
-    int login_attempts;
-    time_t locked_until;
-} UserRecord;
-
-UserRecord users[MAX_USERS];
-int user_count = 0;
+// Diretório de usuários da AGLE: busca por nome em O(1), sem limite fixo
+AGLE_USER_DIR *usuarios = NULL;
 
 /**
  * Mascara uma senha para exibição (mostra só * e primeiros/últimos chars)
@@ -44,38 +36,34 @@ void mascarar_senha(const char *senha, char *masked) {
  * Registrar novo usuário com senha
  */
 bool registrar_usuario(AGLE_CTX *ctx, const char *username, const char *password) {
-    if (user_count >= MAX_USERS) {
-        printf("❌ Banco de usuários cheio!\n");
-        return false;
-    }
-
     // Verificar se usuário existe
-    for (int i = 0; i < user_count; i++) {
-        if (strcmp(users[i].username, username) == 0) {
-            printf("❌ Usuário '%s' já existe!\n", username);
-            return false;
-        }
+    if (AGLE_UserDirFind(usuarios, username, NULL)) {
+        printf("❌ Usuário '%s' já existe!\n", username);
+        return false;
     }
 
-    UserRecord *user = &users[user_count];
-    strcpy(user->username, username);
-    user->login_attempts = 0;
-    user->locked_until = 0;
+    uint8_t salt[AGLE_USER_SALT_LEN];
+    uint8_t hash[AGLE_USER_HASH_LEN];
 
     // 1. Gerar salt aleatório
-    if (!AGLE_GetRandomBytes(ctx, user->salt, 16)) {
+    if (!AGLE_GetRandomBytes(ctx, salt, sizeof(salt))) {
         printf("❌ Erro ao gerar salt!\n");
         return false;
     }
 
     // 2. Derivar hash com KDF
     if (!AGLE_DeriveKey((uint8_t*)password, strlen(password),
-                        user->salt, 16, 100000, user->hash, 32)) {
+                        salt, sizeof(salt), KDF_ITERACOES, hash, sizeof(hash))) {
         printf("❌ Erro ao derivar chave!\n");
         return false;
     }
 
-    user_count++;
+    bool inserido = AGLE_UserDirAdd(usuarios, username, salt, hash, KDF_ITERACOES, NULL);
+    AGLE_SecureZero(hash, sizeof(hash));
+    if (!inserido) {
+        printf("❌ Não foi possível registrar '%s'!\n", username);
+        return false;
+    }
 
     // Exibir info (mascará a senha)
     char masked[MAX_PASSWORD_LEN];
@@ -85,7 +73,7 @@ bool registrar_usuario(AGLE_CTX *ctx, const char *username, const char *password
     printf("├─ Usuário: %s\n", username);
     printf("├─ Senha: %s (mascarada para exibição)\n", masked);
     printf("└─ Salt armazenado: ");
-    for (int i = 0; i < 16; i++) printf("%02x", user->salt[i]);
+    for (int i = 0; i < 16; i++) printf("%02x", salt[i]);
     printf("\n");
 
     return true;
@@ -98,22 +86,17 @@ bool autenticar_usuario(AGLE_CTX *ctx, const char *username, const char *passwor
     (void)ctx;  // Parâmetro mantido para consistência de API
     
     // Procurar usuário
-    UserRecord *user = NULL;
-    
-    for (int i = 0; i < user_count; i++) {
-        if (strcmp(users[i].username, username) == 0) {
-            user = &users[i];
-            break;
-        }
-    }
+    uint32_t id;
+    AGLE_UserRecord user;
 
-    if (user == NULL) {
+    if (!AGLE_UserDirFind(usuarios, username, &id) ||
+        !AGLE_UserDirGet(usuarios, id, &user)) {
         printf("❌ Usuário '%s' não encontrado!\n", username);
         return false;
     }
 
     // Verificar se está bloqueado
-    if (user->locked_until > time(NULL)) {
+    if (user.locked_until > time(NULL)) {
         printf("❌ Conta bloqueada! Tente novamente mais tarde.\n");
         return false;
     }
@@ -121,16 +104,15 @@ bool autenticar_usuario(AGLE_CTX *ctx, const char *username, const char *passwor
     // Derivar hash com o salt armazenado
     uint8_t hash_tentativa[32];
     if (!AGLE_DeriveKey((uint8_t*)password, strlen(password),
-                        user->salt, 16, 100000, hash_tentativa, 32)) {
+                        user.salt, 16, user.kdf_iterations, hash_tentativa, 32)) {
         printf("❌ Erro ao processar senha!\n");
         return false;
     }
 
     // Comparar hashes
-    if (memcmp(user->hash, hash_tentativa, 32) == 0) {
+    if (memcmp(user.hash, hash_tentativa, 32) == 0) {
         // Sucesso!
-        user->login_attempts = 0;
-        user->locked_until = 0;
+        AGLE_UserDirNoteSuccess(usuarios, id);
 
         printf("\n✅ AUTENTICAÇÃO SUCESSO!\n");
         printf("├─ Benvindo, %s!\n", username);
@@ -139,17 +121,17 @@ bool autenticar_usuario(AGLE_CTX *ctx, const char *username, const char *passwor
         return true;
     } else {
         // Falha!
-        user->login_attempts++;
+        uint32_t tentativas = AGLE_UserDirNoteFailure(usuarios, id);
         
-        if (user->login_attempts >= 3) {
-            user->locked_until = time(NULL) + 300; // 5 minutos
+        if (tentativas >= 3) {
+            AGLE_UserDirLock(usuarios, id, (int64_t)time(NULL) + 300); // 5 minutos
             printf("❌ SENHA INCORRETA!\n");
-            printf("├─ Tentativas: %d/3\n", user->login_attempts);
+            printf("├─ Tentativas: %u/3\n", tentativas);
             printf("└─ ⚠️ Conta BLOQUEADA por 5 minutos!\n");
             return false;
         } else {
             printf("❌ SENHA INCORRETA!\n");
-            printf("├─ Tentativas: %d/3\n", user->login_attempts);
+            printf("├─ Tentativas: %u/3\n", tentativas);
             printf("└─ Cuidado! Mais 2 tentativas e conta bloqueia.\n");
             return false;
         }
@@ -160,7 +142,8 @@ bool autenticar_usuario(AGLE_CTX *ctx, const char *username, const char *passwor
  * Listar todos os usuários (sem mostrar hashes!)
  */
 void listar_usuarios() {
-    if (user_count == 0) {
+    size_t total = AGLE_UserDirCount(usuarios);
+    if (total == 0) {
         printf("ℹ️  Nenhum usuário registrado.\n");
         return;
     }
@@ -170,15 +153,18 @@ void listar_usuarios() {
     printf("│ Usuário          │ Tentativas       │ Status       │\n");
     printf("├──────────────────┼──────────────────┼──────────────┤\n");
 
-    for (int i = 0; i < user_count; i++) {
+    for (uint32_t i = 0; i < total; i++) {
+        AGLE_UserRecord user;
+        if (!AGLE_UserDirGet(usuarios, i, &user)) break;
+
         const char *status = "✅ Ativo";
-        if (users[i].locked_until > time(NULL)) {
+        if (user.locked_until > time(NULL)) {
             status = "🔒 Bloqueado";
         }
 
-        printf("│ %-16s │ %d/3             │ %-12s │\n",
-               users[i].username,
-               users[i].login_attempts,
+        printf("│ %-16s │ %u/3             │ %-12s │\n",
+               user.username,
+               user.failed_attempts,
                status);
     }
     printf("└──────────────────┴──────────────────┴──────────────┘\n");
@@ -210,6 +196,12 @@ int main(void) {
         return 1;
     }
 
+    usuarios = AGLE_UserDirNew(0);
+    if (usuarios == NULL) {
+        fprintf(stderr, "❌ Erro ao criar diretório de usuários\n");
+        return 1;
+    }
+
     printf("\n╔═════════════════════════════════════════╗\n");
     printf("║   Sistema de Validação de Senhas AGLE  ║\n");
     printf("║                                         ║\n");
@@ -300,6 +292,7 @@ int main(void) {
             case 4: {
                 // Sair
                 printf("\n👋 Até logo!\n");
+                AGLE_UserDirFree(usuarios);
                 AGLE_Cleanup(&ctx);
                 return 0;
             }
@@ -3,21 +3,85 @@
  * Protocolo HTTP com API REST usando biblioteca AGLE
  */
 
+#define _GNU_SOURCE
 #include "agle.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <sys/eventfd.h>
+#include <semaphore.h>
+#include <sched.h>
 #include <netinet/in.h>
 #include <time.h>
 #include <stdbool.h>
+#include <inttypes.h>
+#include <stdarg.h>
 #include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #define PORT 8080
-#define MAX_USERS 100
-#define MAX_SESSIONS 100
+#define USUARIOS_ESPERADOS 1024  // Dimensionamento inicial (o diretório cresce)
+#define SESSOES_ESPERADAS 4096   // Dimensionamento inicial (a tabela cresce)
 #define SESSION_TIMEOUT 3600  // 1 hora
+#define BYTES_TOKEN 32        // Aleatoriedade do token de sessão
+#define TAM_TOKEN 96          // "agle_" + 64 hex + CRC32C (77) ou assinado (58), com folga
+
+// Loop de eventos
+#define MAX_EVENTOS 256
+#define TAM_ENTRADA 16384         // Buffer de recepção (pipeline ou um lote de ~190 tokens)
+#define TAM_SAIDA 16384           // Respostas enfileiradas em pipeline
+#define TAM_RESPOSTA_MAX 2048     // Espaço livre exigido antes de processar outra requisição
+#define TAM_CORPO_MAX 1024        // Maior corpo JSON montado dinamicamente
+#define MAX_IOV 64                // Trechos de saída enfileirados por conexão
+#define IOV_POR_RESPOSTA 4        // Status+CORS, Content-Length, Connection, corpo
+#define TIMEOUT_CONEXAO_MS 10000  // Conexão ociosa é fechada após 10s
+#define TICK_MS 1000              // Intervalo máximo entre varreduras de timeout
+#define MAX_THREADS 256
+
+// POST /validate/batch
+#define MAX_TOKENS_LOTE 256
+#define TAM_ITEM_LOTE 128         // {"valid":true,"username":...,"expires_in":...}
+
+// Tokens assinados (-s)
+#define LIMPEZA_REVOGADOS_MS 60000  // Descarte das revogações já expiradas
+
+// Pool de KDF: hashing de senha fora das threads de rede
+#define KDF_ITERACOES 100000      // AGLE_DeriveKey; gravado com cada hash
+#define CAPACIDADE_FILA_KDF 1024  // Por faixa; potência de 2
+#define MAX_TRABALHADORES_KDF 64
+
+// Controle de admissão: limites por endpoint e prazos de fila
+#define LIMITE_KDF_LOGIN 512        // /login na fila ou em execução; acima: 429
+#define LIMITE_KDF_REGISTRO 64      // /register idem
+#define ORCAMENTO_FILA_KDF_MS 1000  // Espera estimada acima disso: 503 imediato
+#define PRAZO_FILA_KDF_MS 2000      // Tarefa que esperou mais é descartada (503)
+#define CUSTO_KDF_INICIAL_US 100000 // Estimativa até a primeira medição
+
+// Limite de taxa por cliente (login/register), checado antes da fila de KDF
+#define TAXA_IP_POR_S 5             // Tokens por segundo por endereço IPv4
+#define RAJADA_IP 20
+#define TAXA_SUBREDE_POR_S 50       // Idem por /24: contém ataques distribuídos
+#define RAJADA_SUBREDE 200
+#define BALDES_LIMITE 65536         // Memória fixa: 512 KiB por limitador
+
+// Log assíncrono: anéis por thread esvaziados por uma thread formatadora
+#define CAPACIDADE_ANEL_LOG 1024    // Registros por thread; potência de 2
+#define MAX_ANEIS_LOG (MAX_THREADS + MAX_TRABALHADORES_KDF + 1)
+#define TAM_TEXTO_LOG 96
+#define PAUSA_LOG_MS 10             // Espera do formatador quando não há registros
+
+// Métricas (GET /metrics): contadores por thread somados na coleta
+#define ENDPOINTS_METRICA 16        // Rotas + "outros"; checado em iniciar_rotas()
+#define TAM_METRICAS_MAX (256 * 1024)
 
 // Comparação constant-time para prevenir timing attacks
 bool constant_time_compare(const uint8_t *a, const uint8_t *b, size_t len) {
@@ -28,58 +92,427 @@ bool constant_time_compare(const uint8_t *a, const uint8_t *b, size_t len) {
     return result == 0;
 }
 
-// Estrutura de usuário
+// Trecho de um buffer (sem cópia e sem terminador NUL)
 typedef struct {
-    char username[64];
-    uint8_t salt[16];
-    uint8_t password_hash[32];
-    bool active;
-    int failed_attempts;
-    time_t locked_until;
-} User;
-
-// Estrutura de sessão
+    const char *ptr;
+    size_t len;
+} Fatia;
+
+// Requisição analisada: todas as fatias apontam para o buffer de recepção
 typedef struct {
-    char token[65];
-    char username[64];
-    time_t created_at;
-    time_t expires_at;
-    bool valid;
-} Session;
-
-// Dados globais
-static AGLE_CTX ctx;
-static User users[MAX_USERS];
-static Session sessions[MAX_SESSIONS];
-static int user_count = 0;
-static int session_count = 0;
+    Fatia metodo;
+    Fatia caminho;
+    Fatia autorizacao;            // Valor do cabeçalho Authorization
+    Fatia corpo;
+    size_t tamanho;               // Bytes consumidos (cabeçalhos + corpo)
+    bool manter_conexao;          // HTTP/1.1 keep-alive
+} Requisicao;
+
+// Conexão persistente: o buffer de recepção guarda [entrada_ini, entrada_fim);
+// requisições em pipeline são processadas em ordem e as respostas enfileiradas
+typedef struct Conexao {
+    int fd;
+    uint32_t ip;                  // IPv4 do cliente (ordem de rede)
+    bool pode_ler;                // Socket pode ter dados (edge-triggered)
+    bool fim_entrada;             // Cliente fechou o lado de escrita
+    bool fechar_apos_envio;       // "Connection: close" ou erro de protocolo
+    uint64_t ultima_atividade_ms;
+    struct Conexao *ant, *prox;   // Lista por atividade (timeouts em O(1))
+    size_t entrada_ini;
+    size_t entrada_fim;
+    size_t varrido;               // Até onde já se procurou o fim dos cabeçalhos
+    bool aguardando_kdf;          // Requisição na fila de KDF: pipeline pausado
+    bool fechada;                 // Fechada com KDF pendente: liberada na conclusão
+    int endpoint;                 // Índice de métricas da requisição em andamento
+    int ultimo_status;            // Status da última resposta enfileirada
+    uint64_t inicio_us;           // Chegada da requisição em andamento (latência)
+    char *anexo;                  // Corpo grande (malloc) referenciado por iov; livre após envio
+    size_t saida_len;             // Bytes usados em saida (partes dinâmicas)
+    struct iovec iov[MAX_IOV];    // Respostas em ordem: blocos estáticos ou trechos de saida
+    int iov_ini;                  // Primeiro trecho ainda não enviado
+    int iov_fim;
+    char entrada[TAM_ENTRADA];
+    char saida[TAM_SAIDA];
+} Conexao;
+
+// Um loop por thread: socket SO_REUSEPORT, epoll e gerador AGLE próprios
+typedef struct {
+    int id;
+    pthread_t thread;
+    int epoll_fd;
+    int listen_fd;
+    Conexao *mais_antiga;         // Cabeça: menos recente
+    Conexao *mais_recente;        // Cauda: mais recente
+    size_t conexoes_ativas;
+    uint64_t agora_ms;            // Relógio grosso: lido uma vez por despertar do epoll
+    int evento_fd;                // eventfd: trabalhadores de KDF avisam conclusões
+    struct TarefaKdf *concluidas; // Pilha lock-free preenchida pelos trabalhadores
+    struct MetricasThread *metricas;
+    AGLE_CTX ctx;
+} LoopEventos;
+
+// Usuários: diretório da AGLE (índice hash, leitura concorrente, bloqueio atômico)
+static AGLE_USER_DIR *usuarios = NULL;
+
+// Sessões: tabela da AGLE indexada pelo hash do token (locks por shard)
+static AGLE_SESSION_STORE *sessoes = NULL;
+
+// Tokens assinados com KMAC256 (opcional, -s): validados sem consultar a
+// tabela; NULL = todo login cria sessão na tabela
+static AGLE_TOKEN_SIGNER *assinador = NULL;
+
+// Log + snapshot em disco (opcional, -d PREFIXO); NULL = só memória
+static AGLE_PERSIST *persistencia = NULL;
+
+// Token buckets por IP e por sub-rede /24 (memória fixa, sem locks)
+static AGLE_RATE_LIMITER *limite_ip = NULL;
+static AGLE_RATE_LIMITER *limite_subrede = NULL;
+
+// Gerador AGLE da thread atual (loop de eventos ou trabalhador de KDF)
+static __thread AGLE_CTX *gerador_atual = NULL;
+
+// Loop da thread de rede atual (destino das conclusões de KDF)
+static __thread LoopEventos *loop_atual = NULL;
+
+// eventfd escrito por SIGINT/SIGTERM; em todos os epolls, sem EPOLLET, então
+// continua pronto até todos os loops verem o pedido de parada
+static int parada_fd = -1;
+
+static void metricas_rng(const AGLE_CTX *ctx);
+static AGLE_CTX *gerador(void);
 
 // ═══════════════════════════════════════════════════════════
-//                    FUNÇÕES DE USUÁRIO
+//                    LOG ASSÍNCRONO
 // ═══════════════════════════════════════════════════════════
 
-User* encontrar_usuario(const char *username) {
-    for (int i = 0; i < user_count; i++) {
-        if (users[i].active && strcmp(users[i].username, username) == 0) {
-            return &users[i];
+/*
+ * Quem atende requisições não formata nem escreve: grava um registro
+ * binário de tamanho fixo no anel da própria thread (um produtor, um
+ * consumidor, sem locks) e segue. Uma thread formatadora esvazia os anéis
+ * e escreve em stdout. Anel cheio descarta o registro e conta a perda, em
+ * vez de bloquear. Cada evento tem nível e um teto de registros por segundo
+ * por thread; o excedente é resumido no próximo registro do mesmo evento.
+ */
+
+typedef enum { LOG_DEBUG, LOG_INFO, LOG_AVISO, LOG_ERRO } NivelLog;
+
+typedef enum {
+    LOG_REQUISICAO,           // texto: "MÉTODO caminho"
+    LOG_SENHA_FRACA,          // a: 0 curta, 1 longa, 2 sem complexidade
+    LOG_USUARIO_REGISTRADO,
+    LOG_USUARIO_NAO_GRAVADO,
+    LOG_CONTA_BLOQUEADA,      // a: segundos restantes
+    LOG_LOGIN_OK,
+    LOG_LOGIN_FALHA,          // a: tentativa
+    LOG_BLOQUEIO_APLICADO,    // a: minutos, b: tentativas
+    LOG_SESSOES_EXPIRADAS,    // a: quantidade
+    LOG_SESSAO_CRIADA,
+    LOG_SESSAO_NAO_GRAVADA,
+    LOG_LOGOUT,
+    LOG_GERADOR_REINICIADO,   // a: 1 se o novo contexto passou nos testes de saúde
+    LOG_SERVIDOR_PARADO,
+    NUM_EVENTOS_LOG
+} EventoLog;
+
+static const struct {
+    NivelLog nivel;
+    uint16_t por_segundo;     // Teto por thread; 0 = sem amostragem
+} EVENTOS_LOG[NUM_EVENTOS_LOG] = {
+    [LOG_REQUISICAO]          = { LOG_INFO, 50 },
+    [LOG_SENHA_FRACA]         = { LOG_INFO, 20 },
+    [LOG_USUARIO_REGISTRADO]  = { LOG_INFO, 0 },
+    [LOG_USUARIO_NAO_GRAVADO] = { LOG_ERRO, 0 },
+    [LOG_CONTA_BLOQUEADA]     = { LOG_AVISO, 20 },
+    [LOG_LOGIN_OK]            = { LOG_INFO, 50 },
+    [LOG_LOGIN_FALHA]         = { LOG_AVISO, 20 },
+    [LOG_BLOQUEIO_APLICADO]   = { LOG_AVISO, 0 },
+    [LOG_SESSOES_EXPIRADAS]   = { LOG_INFO, 0 },
+    [LOG_SESSAO_CRIADA]       = { LOG_DEBUG, 50 },
+    [LOG_SESSAO_NAO_GRAVADA]  = { LOG_ERRO, 0 },
+    [LOG_LOGOUT]              = { LOG_INFO, 50 },
+    [LOG_GERADOR_REINICIADO]  = { LOG_ERRO, 1 },
+    [LOG_SERVIDOR_PARADO]     = { LOG_INFO, 0 },
+};
+
+// 128 bytes: dois registros por linha de cache
+typedef struct {
+    int64_t instante_ms;      // Relógio de parede (grosso)
+    uint32_t suprimidos;      // Registros do mesmo evento descartados antes deste
+    uint16_t evento;
+    uint16_t texto_len;
+    int64_t a, b;
+    char texto[TAM_TEXTO_LOG];
+} RegistroLog;
+
+typedef struct {
+    RegistroLog registros[CAPACIDADE_ANEL_LOG];
+    uint32_t cabeca AGLE_CACHE_ALIGNED;  // Só o produtor escreve
+    uint32_t cauda AGLE_CACHE_ALIGNED;   // Só o formatador escreve
+    uint64_t perdidos;                   // Anel cheio (lido pelo formatador)
+    // Amostragem: estado só do produtor
+    int64_t janela_s;
+    uint16_t emitidos[NUM_EVENTOS_LOG];
+    uint32_t suprimidos[NUM_EVENTOS_LOG];
+} AnelLog;
+
+static NivelLog nivel_log = LOG_INFO;
+static AnelLog *aneis_log[MAX_ANEIS_LOG];
+static uint32_t num_aneis_log = 0;
+static __thread AnelLog *anel_atual = NULL;
+static bool parar_formatador = false;
+static pthread_t formatador;
+
+// Anel da thread, criado no primeiro registro; NULL se acabaram os anéis
+static AnelLog *anel_da_thread(void) {
+    if (anel_atual != NULL) return anel_atual;
+    
+    uint32_t i = __atomic_fetch_add(&num_aneis_log, 1, __ATOMIC_RELAXED);
+    void *mem = NULL;
+    if (i >= MAX_ANEIS_LOG || posix_memalign(&mem, 64, sizeof(AnelLog)) != 0) {
+        return NULL;
+    }
+    memset(mem, 0, sizeof(AnelLog));
+    anel_atual = mem;
+    __atomic_store_n(&aneis_log[i], anel_atual, __ATOMIC_RELEASE);
+    return anel_atual;
+}
+
+static void registrar_log(EventoLog evento, const char *texto, size_t texto_len,
+                          int64_t a, int64_t b) {
+    if (EVENTOS_LOG[evento].nivel < nivel_log) return;
+    AnelLog *anel = anel_da_thread();
+    if (anel == NULL) return;
+    
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    
+    uint16_t teto = EVENTOS_LOG[evento].por_segundo;
+    if (teto != 0) {
+        if (ts.tv_sec != anel->janela_s) {
+            anel->janela_s = ts.tv_sec;
+            memset(anel->emitidos, 0, sizeof(anel->emitidos));
+        }
+        if (anel->emitidos[evento] >= teto) {
+            anel->suprimidos[evento]++;
+            return;
+        }
+        anel->emitidos[evento]++;
+    }
+    
+    uint32_t cabeca = anel->cabeca;
+    if (cabeca - __atomic_load_n(&anel->cauda, __ATOMIC_ACQUIRE) == CAPACIDADE_ANEL_LOG) {
+        __atomic_fetch_add(&anel->perdidos, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    
+    RegistroLog *r = &anel->registros[cabeca & (CAPACIDADE_ANEL_LOG - 1)];
+    r->instante_ms = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    r->suprimidos = anel->suprimidos[evento];
+    anel->suprimidos[evento] = 0;
+    r->evento = (uint16_t)evento;
+    r->texto_len = (uint16_t)(texto_len < TAM_TEXTO_LOG ? texto_len : TAM_TEXTO_LOG);
+    memcpy(r->texto, texto, r->texto_len);
+    r->a = a;
+    r->b = b;
+    __atomic_store_n(&anel->cabeca, cabeca + 1, __ATOMIC_RELEASE);
+}
+
+static void log_evento(EventoLog evento, const char *texto, int64_t a, int64_t b) {
+    registrar_log(evento, texto, texto != NULL ? strlen(texto) : 0, a, b);
+}
+
+static void formatar_registro(FILE *saida, const RegistroLog *r) {
+    static const char *const motivos_senha[] = {
+        "Senha muito curta (mínimo 12 caracteres)",
+        "Senha muito longa (máximo 240 caracteres)",
+        "Senha deve ter: maiúscula, minúscula, número e símbolo",
+    };
+    time_t segundos = (time_t)(r->instante_ms / 1000);
+    struct tm tm;
+    localtime_r(&segundos, &tm);
+    fprintf(saida, "[%02d:%02d:%02d.%03d] ", tm.tm_hour, tm.tm_min, tm.tm_sec,
+            (int)(r->instante_ms % 1000));
+    
+    int n = r->texto_len;
+    const char *t = r->texto;
+    switch ((EventoLog)r->evento) {
+    case LOG_REQUISICAO:
+        fprintf(saida, "📨 %.*s", n, t);
+        break;
+    case LOG_SENHA_FRACA:
+        fprintf(saida, "❌ %s", motivos_senha[r->a < 0 || r->a > 2 ? 2 : r->a]);
+        break;
+    case LOG_USUARIO_REGISTRADO:
+        fprintf(saida, "✅ Usuário registrado: %.*s", n, t);
+        break;
+    case LOG_USUARIO_NAO_GRAVADO:
+        fprintf(saida, "⚠️  Usuário %.*s não foi gravado no log", n, t);
+        break;
+    case LOG_CONTA_BLOQUEADA:
+        fprintf(saida, "🔒 Conta bloqueada: %.*s (aguarde %" PRId64 " segundos)", n, t, r->a);
+        break;
+    case LOG_LOGIN_OK:
+        fprintf(saida, "✅ Login bem-sucedido: %.*s", n, t);
+        break;
+    case LOG_LOGIN_FALHA:
+        fprintf(saida, "❌ Falha de login: %.*s (tentativa %" PRId64 ")", n, t, r->a);
+        break;
+    case LOG_BLOQUEIO_APLICADO:
+        fprintf(saida, "🔒 Conta %.*s bloqueada por %" PRId64 " minutos após %" PRId64 " tentativas",
+                n, t, r->a, r->b);
+        break;
+    case LOG_SESSOES_EXPIRADAS:
+        fprintf(saida, "🧹 %" PRId64 " sessões expiradas limpas", r->a);
+        break;
+    case LOG_SESSAO_CRIADA:
+        fprintf(saida, "✅ Sessão criada para: %.*s (expira em 1h)", n, t);
+        break;
+    case LOG_SESSAO_NAO_GRAVADA:
+        fprintf(saida, "⚠️  Sessão de %.*s não foi gravada no log", n, t);
+        break;
+    case LOG_LOGOUT:
+        fprintf(saida, "🚪 Logout: %.*s", n, t);
+        break;
+    case LOG_GERADOR_REINICIADO:
+        fprintf(saida, r->a ? "⚠️  Gerador reiniciado após falha nos testes de entropia"
+                            : "❌ Fonte de entropia reprovada de novo; gerador indisponível");
+        break;
+    case LOG_SERVIDOR_PARADO:
+        fprintf(saida, "⏹️  Servidor parado");
+        break;
+    default:
+        fprintf(saida, "? evento %u", r->evento);
+        break;
+    }
+    if (r->suprimidos > 0) {
+        fprintf(saida, " (+%u semelhantes omitidos)", r->suprimidos);
+    }
+    fputc('\n', saida);
+}
+
+// Esvazia todos os anéis uma vez; retorna quantos registros escreveu
+static size_t drenar_logs(FILE *saida, uint64_t *perdidos_vistos) {
+    size_t escritos = 0;
+    uint32_t total = __atomic_load_n(&num_aneis_log, __ATOMIC_RELAXED);
+    if (total > MAX_ANEIS_LOG) total = MAX_ANEIS_LOG;
+    
+    for (uint32_t i = 0; i < total; i++) {
+        AnelLog *anel = __atomic_load_n(&aneis_log[i], __ATOMIC_ACQUIRE);
+        if (anel == NULL) continue;  // Sendo criado
+        
+        uint32_t cauda = anel->cauda;
+        uint32_t cabeca = __atomic_load_n(&anel->cabeca, __ATOMIC_ACQUIRE);
+        for (; cauda != cabeca; cauda++) {
+            formatar_registro(saida, &anel->registros[cauda & (CAPACIDADE_ANEL_LOG - 1)]);
+            escritos++;
+        }
+        __atomic_store_n(&anel->cauda, cauda, __ATOMIC_RELEASE);
+        
+        uint64_t perdidos = __atomic_load_n(&anel->perdidos, __ATOMIC_RELAXED);
+        if (perdidos != perdidos_vistos[i]) {
+            fprintf(saida, "⚠️  %" PRIu64 " registros de log perdidos (anel cheio)\n",
+                    perdidos - perdidos_vistos[i]);
+            perdidos_vistos[i] = perdidos;
+            escritos++;
+        }
+    }
+    if (escritos > 0) fflush(saida);
+    return escritos;
+}
+
+static void *thread_formatador(void *arg) {
+    (void)arg;
+    static uint64_t perdidos_vistos[MAX_ANEIS_LOG];
+    struct timespec pausa = { 0, PAUSA_LOG_MS * 1000000L };
+    
+    while (!__atomic_load_n(&parar_formatador, __ATOMIC_ACQUIRE)) {
+        if (drenar_logs(stdout, perdidos_vistos) == 0) {
+            nanosleep(&pausa, NULL);
         }
     }
+    drenar_logs(stdout, perdidos_vistos);
     return NULL;
 }
 
-bool registrar_usuario(const char *username, const char *password) {
-    if (user_count >= MAX_USERS || encontrar_usuario(username) != NULL) {
-        return false;
+static void iniciar_log(void) {
+    if (pthread_create(&formatador, NULL, thread_formatador, NULL) != 0) {
+        perror("❌ Erro ao criar thread de log");
+        exit(1);
+    }
+}
+
+static void parar_log(void) {
+    __atomic_store_n(&parar_formatador, true, __ATOMIC_RELEASE);
+    pthread_join(formatador, NULL);
+}
+
+// Um contexto que reprovou a fonte de entropia várias vezes seguidas falha
+// fechado para sempre; em vez de recusar toda requisição da thread até o
+// processo reiniciar, tenta um contexto novo (que passa pelos testes outra vez)
+static AGLE_CTX *gerador(void) {
+    if (!AGLE_IsHealthy(gerador_atual)) {
+        bool ok = AGLE_Init(gerador_atual);
+        log_evento(LOG_GERADOR_REINICIADO, NULL, ok, 0);
+    }
+    return gerador_atual;
+}
+
+// ═══════════════════════════════════════════════════════════
+//                    FUNÇÕES DE USUÁRIO
+// ═══════════════════════════════════════════════════════════
+
+// Busca O(1) no índice do diretório; o id do registro nunca muda
+bool encontrar_usuario(const char *username, uint32_t *id) {
+    return AGLE_UserDirFind(usuarios, username, id);
+}
+
+/*
+ * Hash da senha com o custo gravado no registro:
+ *   0       → SHAKE256(senha || salt), contas criadas antes do KDF
+ *   N > 0   → AGLE_DeriveKey com N iterações sobre SHAKE256(senha), já que
+ *             a AGLE_DeriveKey só usa os primeiros 32 bytes da senha
+ */
+static bool calcular_hash(const char *password, const uint8_t *salt, uint32_t iteracoes,
+                          uint8_t hash[AGLE_USER_HASH_LEN]) {
+    size_t pass_len = strlen(password);
+    if (pass_len > 240) return false;
+    
+    if (iteracoes == 0) {
+        uint8_t combined[256];
+        memcpy(combined, password, pass_len);
+        memcpy(combined + pass_len, salt, AGLE_USER_SALT_LEN);
+        bool ok = AGLE_HashSHAKE256(combined, pass_len + AGLE_USER_SALT_LEN,
+                                    hash, AGLE_USER_HASH_LEN);
+        AGLE_SecureZero(combined, sizeof(combined));
+        return ok;
     }
     
+    uint8_t pre_hash[AGLE_USER_HASH_LEN];
+    bool ok = AGLE_HashSHAKE256((const uint8_t *)password, pass_len, pre_hash, sizeof(pre_hash)) &&
+              AGLE_DeriveKey(pre_hash, sizeof(pre_hash), salt, AGLE_USER_SALT_LEN,
+                             iteracoes, hash, AGLE_USER_HASH_LEN);
+    AGLE_SecureZero(pre_hash, sizeof(pre_hash));
+    return ok;
+}
+
+// Login de nome inexistente: paga o mesmo KDF, senão o 401 chega em
+// microssegundos e denuncia quais contas existem
+static void simular_validacao(const char *password) {
+    static const uint8_t salt_ficticio[AGLE_USER_SALT_LEN] = {0};
+    uint8_t hash[AGLE_USER_HASH_LEN];
+    calcular_hash(password, salt_ficticio, KDF_ITERACOES, hash);
+    AGLE_SecureZero(hash, sizeof(hash));
+}
+
+bool registrar_usuario(const char *username, const char *password) {
     // VALIDAÇÃO DE SENHA FORTE
     size_t pass_len = strlen(password);
     if (pass_len < 12) {
-        printf("❌ Senha muito curta (mínimo 12 caracteres)\n");
+        log_evento(LOG_SENHA_FRACA, NULL, 0, 0);
         return false;
     }
     if (pass_len > 240) {
-        printf("❌ Senha muito longa (máximo 240 caracteres)\n");
+        log_evento(LOG_SENHA_FRACA, NULL, 1, 0);
         return false;
     }
     
@@ -93,86 +526,96 @@ bool registrar_usuario(const char *username, const char *password) {
         if (!isalnum(password[i])) tem_simbolo = true;
     }
     if (!(tem_maiuscula && tem_minuscula && tem_numero && tem_simbolo)) {
-        printf("❌ Senha deve ter: maiúscula, minúscula, número e símbolo\n");
+        log_evento(LOG_SENHA_FRACA, NULL, 2, 0);
         return false;
     }
     
-    User *user = &users[user_count];
-    strncpy(user->username, username, sizeof(user->username) - 1);
-    user->active = true;
-    user->failed_attempts = 0;
-    user->locked_until = 0;
-    
-    // Gerar salt aleatório
-    AGLE_GetRandomBytes(&ctx, user->salt, 16);
+    // Nome repetido sai antes do KDF; o AGLE_UserDirAdd ainda decide corridas
+    if (encontrar_usuario(username, NULL)) {
+        return false;
+    }
     
-    // Criar buffer: password + salt (criptografia determinística)
-    uint8_t combined[256];
-    memcpy(combined, password, pass_len);
-    memcpy(combined + pass_len, user->salt, 16);
+    // Roda num trabalhador de KDF: não bloqueia as threads de rede
+    uint8_t salt[AGLE_USER_SALT_LEN];
+    uint8_t password_hash[AGLE_USER_HASH_LEN];
     
-    // Usar SHAKE256 direto (100% determinístico)
-    AGLE_HashSHAKE256(combined, pass_len + 16, user->password_hash, 32);
+    // Gerar salt aleatório; sem ele não há registro
+    AGLE_CTX *g = gerador();
+    bool sorteado = AGLE_GetRandomBytes(g, salt, sizeof(salt));
+    metricas_rng(g);
+    if (!sorteado) {
+        return false;
+    }
     
-    // ZEROIZAR SENHA DA MEMÓRIA
-    memset(combined, 0, sizeof(combined));
+    if (!calcular_hash(password, salt, KDF_ITERACOES, password_hash)) {
+        return false;
+    }
     
-    user_count++;
+    // Falha se o nome já existe (checado atomicamente pelo diretório)
+    bool inserido = AGLE_UserDirAdd(usuarios, username, salt, password_hash,
+                                    KDF_ITERACOES, NULL);
+    // Memória primeiro, log depois; a gravação em disco é feita pela thread da AGLE
+    if (inserido && persistencia != NULL &&
+        !AGLE_PersistUserAdd(persistencia, username, salt, password_hash, KDF_ITERACOES)) {
+        log_evento(LOG_USUARIO_NAO_GRAVADO, username, 0, 0);
+    }
+    AGLE_SecureZero(password_hash, sizeof(password_hash));
+    if (!inserido) {
+        return false;
+    }
     
     // LOG SEGURO (SEM SALT)
-    printf("✅ Usuário registrado: %s\n", username);
+    log_evento(LOG_USUARIO_REGISTRADO, username, 0, 0);
     
     return true;
 }
 
-bool validar_senha(User *user, const char *password) {
+bool validar_senha(uint32_t id, const char *password) {
+    AGLE_UserRecord user;
+    if (!AGLE_UserDirGet(usuarios, id, &user)) {
+        return false;
+    }
+    
     // VERIFICAR BLOQUEIO POR RATE LIMITING
     time_t now = time(NULL);
-    if (now < user->locked_until) {
-        int tempo_restante = (int)(user->locked_until - now);
-        printf("🔒 Conta bloqueada: %s (aguarde %d segundos)\n", 
-               user->username, tempo_restante);
+    if (now < user.locked_until) {
+        log_evento(LOG_CONTA_BLOQUEADA, user.username, user.locked_until - (int64_t)now, 0);
+        AGLE_SecureZero(&user, sizeof(user));
         return false;
     }
     
-    // Recriar a mesma combinação: password + salt
-    size_t pass_len = strlen(password);
-    uint8_t combined[256];
-    uint8_t hash[32];
-    
-    memcpy(combined, password, pass_len);
-    memcpy(combined + pass_len, user->salt, 16);
-    
-    // Gerar hash com SHAKE256 (determinístico)
-    AGLE_HashSHAKE256(combined, pass_len + 16, hash, 32);
-    
-    // ZEROIZAR SENHA DA MEMÓRIA
-    memset(combined, 0, sizeof(combined));
+    // Recalcular com o salt e o custo do registro
+    uint8_t hash[AGLE_USER_HASH_LEN];
+    if (!calcular_hash(password, user.salt, user.kdf_iterations, hash)) {
+        AGLE_SecureZero(&user, sizeof(user));
+        return false;
+    }
     
     // USAR COMPARAÇÃO CONSTANT-TIME
-    bool resultado = constant_time_compare(hash, user->password_hash, 32);
+    bool resultado = constant_time_compare(hash, user.hash, sizeof(hash));
+    AGLE_SecureZero(hash, sizeof(hash));
     
+    // Contadores atualizados atomicamente pelo diretório
     if (resultado) {
         // SUCESSO: Resetar contadores
-        user->failed_attempts = 0;
-        user->locked_until = 0;
-        printf("✅ Login bem-sucedido: %s\n", user->username);
+        AGLE_UserDirNoteSuccess(usuarios, id);
+        log_evento(LOG_LOGIN_OK, user.username, 0, 0);
     } else {
         // FALHA: Incrementar tentativas
-        user->failed_attempts++;
-        printf("❌ Falha de login: %s (tentativa %d)\n", 
-               user->username, user->failed_attempts);
+        uint32_t tentativas = AGLE_UserDirNoteFailure(usuarios, id);
+        log_evento(LOG_LOGIN_FALHA, user.username, tentativas, 0);
         
         // RATE LIMITING EXPONENCIAL
-        if (user->failed_attempts >= 5) {
-            user->locked_until = now + 900;  // 15 minutos
-            printf("🔒 Conta bloqueada por 15 minutos após 5 tentativas\n");
-        } else if (user->failed_attempts >= 3) {
-            user->locked_until = now + 300;  // 5 minutos
-            printf("🔒 Conta bloqueada por 5 minutos após 3 tentativas\n");
+        if (tentativas >= 5) {
+            AGLE_UserDirLock(usuarios, id, (int64_t)now + 900);  // 15 minutos
+            log_evento(LOG_BLOQUEIO_APLICADO, user.username, 15, tentativas);
+        } else if (tentativas >= 3) {
+            AGLE_UserDirLock(usuarios, id, (int64_t)now + 300);  // 5 minutos
+            log_evento(LOG_BLOQUEIO_APLICADO, user.username, 5, tentativas);
         }
     }
     
+    AGLE_SecureZero(&user, sizeof(user));
     return resultado;
 }
 
@@ -180,84 +623,125 @@ bool validar_senha(User *user, const char *password) {
 //                    FUNÇÕES DE SESSÃO
 // ═══════════════════════════════════════════════════════════
 
-void limpar_sessoes_expiradas() {
-    time_t now = time(NULL);
-    int removidas = 0;
-    
-    for (int i = 0; i < session_count; i++) {
-        if (sessions[i].expires_at < now || !sessions[i].valid) {
-            // Zeroizar dados da sessão
-            memset(&sessions[i], 0, sizeof(Session));
-            
-            // Mover última sessão para esta posição
-            if (i < session_count - 1) {
-                sessions[i] = sessions[session_count - 1];
-                i--;  // Reprocessar esta posição
-            }
-            session_count--;
-            removidas++;
-        }
-    }
+// Avança a roda de expiração da tabela: custo proporcional ao que expira
+static void expirar_sessoes(time_t agora) {
+    size_t removidas = AGLE_SessionStoreTick(sessoes, (int64_t)agora);
     
     if (removidas > 0) {
-        printf("🧹 %d sessões expiradas limpas\n", removidas);
+        log_evento(LOG_SESSOES_EXPIRADAS, NULL, (int64_t)removidas, 0);
     }
 }
 
-char* criar_sessao(const char *username) {
-    // LIMPAR SESSÕES EXPIRADAS ANTES DE CRIAR NOVA
-    limpar_sessoes_expiradas();
-    
-    if (session_count >= MAX_SESSIONS) {
-        return NULL;
+// Copia o token para token_saida (mín. TAM_TOKEN bytes)
+bool criar_sessao(const char *username, uint32_t id, char *token_saida) {
+    if (assinador != NULL) {
+        // Sem estado: o token carrega id e validade, nada é guardado
+        int64_t expira = (int64_t)time(NULL) + SESSION_TIMEOUT;
+        AGLE_CTX *g = gerador();
+        bool emitido = AGLE_TokenIssue(assinador, g, id, expira, token_saida, NULL);
+        metricas_rng(g);
+        if (!emitido) {
+            return false;
+        }
+        log_evento(LOG_SESSAO_CRIADA, username, 0, 0);
+        return true;
     }
     
-    Session *sess = &sessions[session_count];
+    AGLE_SessionInfo nova;
+    memset(&nova, 0, sizeof(nova));
     
-    // Gerar token único
-    AGLE_GenerateSessionTokenHex(&ctx, sess->token, 32);
-    strncpy(sess->username, username, sizeof(sess->username) - 1);
-    sess->created_at = time(NULL);
-    sess->expires_at = sess->created_at + SESSION_TIMEOUT;
-    sess->valid = true;
+    // Gerar token único com o gerador da thread; o CRC32C no fim deixa
+    // descartar lixo antes de qualquer busca
+    char token[TAM_TOKEN];
+    AGLE_CTX *g = gerador();
+    bool gerado = AGLE_GenerateSessionTokenChecked(g, token, BYTES_TOKEN);
+    metricas_rng(g);
+    if (!gerado) {
+        return false;
+    }
+    size_t token_len = AGLE_CHECKED_TOKEN_LEN(BYTES_TOKEN);
+    strncpy(nova.username, username, sizeof(nova.username) - 1);
+    nova.created_at = (int64_t)time(NULL);
+    nova.expires_at = nova.created_at + SESSION_TIMEOUT;
+    
+    if (!AGLE_SessionInsert(sessoes, token, token_len, &nova)) {
+        AGLE_SecureZero(token, sizeof(token));
+        return false;
+    }
+    if (persistencia != NULL && !AGLE_PersistSessionAdd(persistencia, token, token_len, &nova)) {
+        log_evento(LOG_SESSAO_NAO_GRAVADA, username, 0, 0);
+    }
     
-    session_count++;
-    printf("✅ Sessão criada para: %s (expira em 1h)\n", username);
-    return sess->token;
+    memcpy(token_saida, token, token_len + 1);
+    AGLE_SecureZero(token, sizeof(token));
+    log_evento(LOG_SESSAO_CRIADA, username, 0, 0);
+    return true;
 }
 
-Session* validar_token(const char *token) {
-    time_t now = time(NULL);
-    size_t token_len = strlen(token);
-    
-    for (int i = 0; i < session_count; i++) {
-        // USAR COMPARAÇÃO CONSTANT-TIME PARA TOKENS
-        if (sessions[i].valid && 
-            strlen(sessions[i].token) == token_len &&
-            constant_time_compare((uint8_t*)sessions[i].token, 
-                                 (uint8_t*)token, 
-                                 token_len)) {
-            
-            if (sessions[i].expires_at > now) {
-                return &sessions[i];
-            } else {
-                // Sessão expirada
-                sessions[i].valid = false;
-                printf("⏰ Sessão expirada: %s\n", sessions[i].username);
-                return NULL;
-            }
-        }
+static bool token_assinado(const char *token, size_t token_len) {
+    return assinador != NULL && token_len == AGLE_SIGNED_TOKEN_LEN &&
+           memcmp(token, AGLE_SIGNED_TOKEN_PREFIX, sizeof(AGLE_SIGNED_TOKEN_PREFIX) - 1) == 0;
+}
+
+// Só vale a pena procurar na tabela tokens com checksum correto ou no
+// formato antigo (64 hex minúsculos, de sessões gravadas antes dele)
+static bool token_na_tabela(const char *token, size_t token_len) {
+    if (token_len != 64) {
+        return AGLE_CheckSessionToken(token, token_len);
     }
-    return NULL;
+    for (size_t i = 0; i < token_len; i++) {
+        char c = token[i];
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) return false;
+    }
+    return true;
 }
 
-void invalidar_sessao(const char *token) {
-    for (int i = 0; i < session_count; i++) {
-        if (strcmp(sessions[i].token, token) == 0) {
-            sessions[i].valid = false;
-            printf("🚪 Logout: %s\n", sessions[i].username);
-            return;
+// Token assinado: uma chamada KMAC e o nome lido do diretório pelo id
+static bool validar_assinado(const char *token, size_t token_len, int64_t agora,
+                             AGLE_TokenClaims *claims, AGLE_SessionInfo *saida) {
+    AGLE_UserRecord user;
+    if (!AGLE_TokenVerify(assinador, token, token_len, agora, claims) ||
+        !AGLE_UserDirGet(usuarios, claims->user_id, &user)) {
+        return false;
+    }
+    memset(saida, 0, sizeof(*saida));
+    snprintf(saida->username, sizeof(saida->username), "%s", user.username);
+    saida->created_at = claims->expires_at - SESSION_TIMEOUT;
+    saida->expires_at = claims->expires_at;
+    AGLE_SecureZero(&user, sizeof(user));
+    return true;
+}
+
+// Busca O(1): a comparação constant-time é feita pela AGLE no slot candidato.
+// Tokens assinados não tocam a tabela.
+bool validar_token(const char *token, size_t token_len, AGLE_SessionInfo *saida) {
+    if (token_assinado(token, token_len)) {
+        AGLE_TokenClaims claims;
+        return validar_assinado(token, token_len, (int64_t)time(NULL), &claims, saida);
+    }
+    if (!token_na_tabela(token, token_len)) {
+        return false;
+    }
+    return AGLE_SessionLookup(sessoes, token, token_len, (int64_t)time(NULL), saida);
+}
+
+void invalidar_sessao(const char *token, size_t token_len) {
+    AGLE_SessionInfo sess;
+    if (token_assinado(token, token_len)) {
+        // Revogado até a validade original; depois disso é descartado
+        AGLE_TokenClaims claims;
+        if (validar_assinado(token, token_len, (int64_t)time(NULL), &claims, &sess) &&
+            AGLE_TokenRevoke(assinador, &claims)) {
+            log_evento(LOG_LOGOUT, sess.username, 0, 0);
+        }
+        return;
+    }
+    
+    if (token_na_tabela(token, token_len) && AGLE_SessionRemove(sessoes, token, token_len, &sess)) {
+        if (persistencia != NULL) {
+            AGLE_PersistSessionRemove(persistencia, token, token_len);
         }
+        log_evento(LOG_LOGOUT, sess.username, 0, 0);
     }
 }
 
@@ -265,261 +749,2219 @@ void invalidar_sessao(const char *token) {
 //                    PROTOCOLO HTTP/REST
 // ═══════════════════════════════════════════════════════════
 
-void extrair_campo(const char *body, const char *campo, char *destino, size_t max_len) {
-    char padrao[128];
-    snprintf(padrao, sizeof(padrao), "\"%s\":\"", campo);
-    
-    const char *inicio = strstr(body, padrao);
-    if (inicio) {
-        inicio += strlen(padrao);
-        const char *fim = strchr(inicio, '"');
-        if (fim) {
-            size_t len = fim - inicio;
-            if (len >= max_len) len = max_len - 1;
-            strncpy(destino, inicio, len);
-            destino[len] = '\0';
-        }
+// ───────────────────────────── JSON ─────────────────────────────
+
+/*
+ * Leitor de corpo JSON em uma passada, sem alocação: percorre o objeto de
+ * topo uma única vez e devolve, para cada chave pedida, uma fatia do valor
+ * string direto no buffer de recepção (escapes ainda não resolvidos).
+ * Valores aninhados e chaves não pedidas são pulados sem cópia.
+ */
+#define JSON_PROFUNDIDADE_MAX 64
+
+typedef struct {
+    const char *nome;
+    size_t nome_len;
+    Fatia valor;                  // Entre as aspas, sem resolver escapes
+    bool escapado;                // valor contém '\'
+    bool bruto;                   // Não é string: valor é o texto JSON inteiro (array, número...)
+    bool encontrado;
+} CampoJson;
+
+#define CAMPO_JSON(nome) { (nome), sizeof(nome) - 1, { NULL, 0 }, false, false, false }
+
+static const char *json_espacos(const char *p, const char *fim) {
+    while (p < fim && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+    return p;
+}
+
+/*
+ * Primeiro '"', '\' ou caractere de controle em [p, fim): os únicos bytes
+ * que interessam dentro de uma string. 16 bytes por comparação com SSE2.
+ */
+static const char *json_proximo_em_string(const char *p, const char *fim) {
+#if defined(__SSE2__)
+    const __m128i aspas = _mm_set1_epi8('"');
+    const __m128i barra = _mm_set1_epi8('\\');
+    const __m128i limite = _mm_set1_epi8(0x1f);
+    while (fim - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        // Controle (< 0x20): min(v, 0x1f) == v, sem sinal
+        __m128i especial = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, aspas), _mm_cmpeq_epi8(v, barra)),
+            _mm_cmpeq_epi8(_mm_min_epu8(v, limite), v));
+        int mascara = _mm_movemask_epi8(especial);
+        if (mascara != 0) return p + __builtin_ctz((unsigned)mascara);
+        p += 16;
     }
+#endif
+    while (p < fim && *p != '"' && *p != '\\' && (unsigned char)*p >= 0x20) p++;
+    return p;
 }
 
-void enviar_resposta(int client_socket, int status, const char *json_body) {
-    char response[4096];
-    const char *status_text = (status == 200) ? "OK" : 
-                              (status == 401) ? "Unauthorized" : 
-                              (status == 400) ? "Bad Request" : "Error";
-    
-    snprintf(response, sizeof(response),
-        "HTTP/1.1 %d %s\r\n"
-        "Content-Type: application/json\r\n"
-        "Access-Control-Allow-Origin: *\r\n"
-        "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"
-        "Access-Control-Allow-Headers: Content-Type, Authorization\r\n"
-        "Connection: close\r\n"
-        "\r\n"
-        "%s", status, status_text, json_body);
-    
-    ssize_t written = write(client_socket, response, strlen(response));
-    (void)written;  // Ignorar intencionalmente
+// Próximo '"', '{', '}', '[' ou ']' em [p, fim) (para pular valores aninhados)
+static const char *json_proximo_estrutural(const char *p, const char *fim) {
+#if defined(__SSE2__)
+    const __m128i aspas = _mm_set1_epi8('"');
+    const __m128i chave_abre = _mm_set1_epi8('{');
+    const __m128i chave_fecha = _mm_set1_epi8('}');
+    const __m128i colchete_abre = _mm_set1_epi8('[');
+    const __m128i colchete_fecha = _mm_set1_epi8(']');
+    while (fim - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i especial = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, aspas), _mm_cmpeq_epi8(v, chave_abre)),
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, chave_fecha),
+                                      _mm_cmpeq_epi8(v, colchete_abre)),
+                         _mm_cmpeq_epi8(v, colchete_fecha)));
+        int mascara = _mm_movemask_epi8(especial);
+        if (mascara != 0) return p + __builtin_ctz((unsigned)mascara);
+        p += 16;
+    }
+#endif
+    while (p < fim && *p != '"' && *p != '{' && *p != '}' && *p != '[' && *p != ']') p++;
+    return p;
 }
 
-void processar_requisicao(int client_socket, const char *request) {
-    char method[16], path[256], body[2048];
-    char username[64] = {0}, password[128] = {0}, token[128] = {0};
-    
-    // Parsear método e path
-    sscanf(request, "%s %s", method, path);
+// p aponta logo após a aspa de abertura; retorna a aspa de fechamento ou NULL
+static const char *json_fim_string(const char *p, const char *fim, bool *escapado) {
+    for (;;) {
+        p = json_proximo_em_string(p, fim);
+        if (p == fim || (unsigned char)*p < 0x20) return NULL;
+        if (*p == '"') return p;
+        
+        // Escape: valida aqui para que a cópia posterior não precise
+        *escapado = true;
+        if (fim - p < 2) return NULL;
+        if (p[1] == 'u') {
+            if (fim - p < 6) return NULL;
+            for (int i = 2; i < 6; i++) {
+                if (!isxdigit((unsigned char)p[i])) return NULL;
+            }
+            p += 6;
+        } else if (p[1] != '\0' && strchr("\"\\/bfnrt", p[1]) != NULL) {
+            p += 2;
+        } else {
+            return NULL;
+        }
+    }
+}
+
+// Pula um valor que não é string (número, literal, objeto ou array)
+static const char *json_pular_valor(const char *p, const char *fim) {
+    if (p == fim) return NULL;
     
-    // Extrair body (após \r\n\r\n)
-    const char *body_start = strstr(request, "\r\n\r\n");
-    if (body_start) {
-        strncpy(body, body_start + 4, sizeof(body) - 1);
-    } else {
-        body[0] = '\0';
+    if (*p == '{' || *p == '[') {
+        uint64_t pilha = 0;       // 1 = objeto, 0 = array, um bit por nível
+        int profundidade = 0;
+        while ((p = json_proximo_estrutural(p, fim)) < fim) {
+            char c = *p;
+            if (c == '"') {
+                bool escapado = false;
+                p = json_fim_string(p + 1, fim, &escapado);
+                if (p == NULL) return NULL;
+            } else if (c == '{' || c == '[') {
+                if (profundidade == JSON_PROFUNDIDADE_MAX) return NULL;
+                pilha = (pilha << 1) | (c == '{');
+                profundidade++;
+            } else {
+                if (profundidade == 0 || (pilha & 1) != (uint64_t)(c == '}')) return NULL;
+                pilha >>= 1;
+                if (--profundidade == 0) return p + 1;
+            }
+            p++;
+        }
+        return NULL;
     }
     
-    printf("\n📨 %s %s\n", method, path);
+    static const char *const literais[] = { "true", "false", "null" };
+    for (size_t i = 0; i < 3; i++) {
+        size_t n = strlen(literais[i]);
+        if ((size_t)(fim - p) >= n && memcmp(p, literais[i], n) == 0) return p + n;
+    }
     
-    // OPTIONS (CORS preflight)
-    if (strcmp(method, "OPTIONS") == 0) {
-        enviar_resposta(client_socket, 200, "{}");
-        return;
+    const char *ini = p;
+    while (p < fim && (isdigit((unsigned char)*p) || *p == '-' || *p == '+' ||
+                       *p == '.' || *p == 'e' || *p == 'E')) {
+        p++;
+    }
+    return p > ini ? p : NULL;
+}
+
+// Registra o valor se a chave foi pedida; false se ela se repete
+static bool json_marcar(CampoJson *campos, size_t n, const char *chave, size_t chave_len,
+                        Fatia valor, bool escapado, bool bruto) {
+    for (size_t i = 0; i < n; i++) {
+        if (campos[i].nome_len == chave_len && memcmp(campos[i].nome, chave, chave_len) == 0) {
+            if (campos[i].encontrado) return false;
+            campos[i].valor = valor;
+            campos[i].escapado = escapado;
+            campos[i].bruto = bruto;
+            campos[i].encontrado = true;
+        }
     }
+    return true;
+}
+
+/*
+ * Lê o objeto de topo e preenche os campos pedidos: strings entre aspas,
+ * demais valores como texto bruto (ver json_array_strings).
+ * Retorna false para JSON malformado, lixo após o objeto ou chave pedida
+ * repetida (evita ambiguidade entre leitores diferentes do mesmo corpo).
+ */
+static bool json_extrair(Fatia corpo, CampoJson *campos, size_t n) {
+    const char *p = json_espacos(corpo.ptr, corpo.ptr + corpo.len);
+    const char *fim = corpo.ptr + corpo.len;
+    
+    if (p == fim || *p != '{') return false;
+    p = json_espacos(p + 1, fim);
+    if (p < fim && *p == '}') return json_espacos(p + 1, fim) == fim;
     
-    // POST /register
-    if (strcmp(path, "/register") == 0) {
-        extrair_campo(body, "username", username, sizeof(username));
-        extrair_campo(body, "password", password, sizeof(password));
+    for (;;) {
+        bool chave_escapada = false;
+        if (p == fim || *p != '"') return false;
+        const char *chave = p + 1;
+        p = json_fim_string(chave, fim, &chave_escapada);
+        if (p == NULL) return false;
+        size_t chave_len = (size_t)(p - chave);
         
-        if (strlen(username) == 0 || strlen(password) < 8) {
-            enviar_resposta(client_socket, 400, 
-                "{\"success\":false,\"error\":\"Dados inválidos\"}");
-            return;
-        }
+        p = json_espacos(p + 1, fim);
+        if (p == fim || *p != ':') return false;
+        p = json_espacos(p + 1, fim);
         
-        if (registrar_usuario(username, password)) {
-            enviar_resposta(client_socket, 200,
-                "{\"success\":true,\"message\":\"Usuário registrado!\"}");
+        if (p < fim && *p == '"') {
+            bool escapado = false;
+            const char *valor = p + 1;
+            p = json_fim_string(valor, fim, &escapado);
+            if (p == NULL) return false;
+            
+            // Chaves com escape nunca casam: os nomes pedidos são ASCII simples
+            if (!chave_escapada &&
+                !json_marcar(campos, n, chave, chave_len,
+                             (Fatia){ valor, (size_t)(p - valor) }, escapado, false)) {
+                return false;
+            }
+            p++;
         } else {
-            enviar_resposta(client_socket, 400,
-                "{\"success\":false,\"error\":\"Usuário já existe\"}");
+            const char *valor = p;
+            p = json_pular_valor(p, fim);
+            if (p == NULL) return false;
+            if (!chave_escapada &&
+                !json_marcar(campos, n, chave, chave_len,
+                             (Fatia){ valor, (size_t)(p - valor) }, false, true)) {
+                return false;
+            }
         }
-        return;
+        
+        p = json_espacos(p, fim);
+        if (p < fim && *p == ',') {
+            p = json_espacos(p + 1, fim);
+            continue;
+        }
+        if (p < fim && *p == '}') return json_espacos(p + 1, fim) == fim;
+        return false;
+    }
+}
+
+static unsigned json_hex4(const char *p) {
+    unsigned v = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        v = (v << 4) | (unsigned)(isdigit((unsigned char)c) ? c - '0' : (tolower((unsigned char)c) - 'a' + 10));
+    }
+    return v;
+}
+
+/*
+ * Copia o valor para destino (terminado em NUL), resolvendo escapes e
+ * \uXXXX para UTF-8. Falha se o campo não veio, não cabe em max_len ou
+ * contém NUL (que truncaria a string C).
+ */
+static bool json_copiar(const CampoJson *campo, char *destino, size_t max_len) {
+    if (!campo->encontrado || campo->bruto || max_len == 0) return false;
+    
+    const char *p = campo->valor.ptr, *fim = p + campo->valor.len;
+    size_t n = 0;
+    if (!campo->escapado) {
+        if (campo->valor.len >= max_len) return false;
+        memcpy(destino, p, campo->valor.len);
+        destino[campo->valor.len] = '\0';
+        return true;
     }
     
-    // POST /login
-    if (strcmp(path, "/login") == 0) {
-        extrair_campo(body, "username", username, sizeof(username));
-        extrair_campo(body, "password", password, sizeof(password));
+    while (p < fim) {
+        const char *barra = memchr(p, '\\', (size_t)(fim - p));
+        size_t literal = (size_t)((barra ? barra : fim) - p);
+        if (n + literal >= max_len) return false;
+        memcpy(destino + n, p, literal);
+        n += literal;
+        p += literal;
+        if (p == fim) break;
         
-        User *user = encontrar_usuario(username);
-        if (user && validar_senha(user, password)) {
-            char *session_token = criar_sessao(username);
-            char json[512];
-            snprintf(json, sizeof(json),
-                "{\"success\":true,\"token\":\"%s\",\"username\":\"%s\"}",
-                session_token, username);
-            enviar_resposta(client_socket, 200, json);
-        } else {
-            enviar_resposta(client_socket, 401,
-                "{\"success\":false,\"error\":\"Credenciais inválidas\"}");
+        // Escapes já validados por json_fim_string
+        char utf8[4];
+        size_t utf8_len = 1;
+        char c = p[1];
+        p += 2;
+        switch (c) {
+            case 'b': utf8[0] = '\b'; break;
+            case 'f': utf8[0] = '\f'; break;
+            case 'n': utf8[0] = '\n'; break;
+            case 'r': utf8[0] = '\r'; break;
+            case 't': utf8[0] = '\t'; break;
+            case 'u': {
+                unsigned cp = json_hex4(p);
+                p += 4;
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    // Par substituto: precisa do \uDC00-\uDFFF seguinte
+                    if (fim - p < 6 || p[0] != '\\' || p[1] != 'u') return false;
+                    unsigned baixo = json_hex4(p + 2);
+                    if (baixo < 0xDC00 || baixo > 0xDFFF) return false;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (baixo - 0xDC00);
+                    p += 6;
+                } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    return false;
+                }
+                if (cp == 0) return false;
+                if (cp < 0x80) {
+                    utf8[0] = (char)cp;
+                } else if (cp < 0x800) {
+                    utf8[0] = (char)(0xC0 | (cp >> 6));
+                    utf8[1] = (char)(0x80 | (cp & 0x3F));
+                    utf8_len = 2;
+                } else if (cp < 0x10000) {
+                    utf8[0] = (char)(0xE0 | (cp >> 12));
+                    utf8[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+                    utf8[2] = (char)(0x80 | (cp & 0x3F));
+                    utf8_len = 3;
+                } else {
+                    utf8[0] = (char)(0xF0 | (cp >> 18));
+                    utf8[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+                    utf8[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+                    utf8[3] = (char)(0x80 | (cp & 0x3F));
+                    utf8_len = 4;
+                }
+                break;
+            }
+            default: utf8[0] = c; break;       // " \ /
         }
-        return;
+        if (n + utf8_len >= max_len) return false;
+        memcpy(destino + n, utf8, utf8_len);
+        n += utf8_len;
     }
+    destino[n] = '\0';
+    return true;
+}
+
+/*
+ * Itens de um array de strings (campo bruto de json_extrair, já validado),
+ * como fatias entre as aspas e sem resolver escapes. Retorna quantos, -1 se
+ * não é um array só de strings ou -2 se passa de max.
+ */
+static int json_array_strings(Fatia array, Fatia *itens, int max) {
+    const char *p = array.ptr, *fim = array.ptr + array.len;
+    if (p == fim || *p != '[') return -1;
+    p = json_espacos(p + 1, fim);
+    if (p < fim && *p == ']') return 0;
     
-    // GET /validate
-    if (strcmp(path, "/validate") == 0) {
-        // Extrair token do header Authorization
-        const char *auth_header = strstr(request, "Authorization: Bearer ");
-        if (auth_header) {
-            sscanf(auth_header + 22, "%64s", token);
-        }
+    int n = 0;
+    for (;;) {
+        if (p == fim || *p != '"') return -1;
+        if (n == max) return -2;
+        bool escapado = false;
+        const char *valor = p + 1;
+        p = json_fim_string(valor, fim, &escapado);
+        if (p == NULL) return -1;
+        itens[n++] = (Fatia){ valor, (size_t)(p - valor) };
         
-        Session *sess = validar_token(token);
-        if (sess) {
-            char json[512];
-            time_t tempo_restante = sess->expires_at - time(NULL);
-            snprintf(json, sizeof(json),
-                "{\"success\":true,\"username\":\"%s\",\"expires_in\":%ld}",
-                sess->username, tempo_restante);
-            enviar_resposta(client_socket, 200, json);
-        } else {
-            enviar_resposta(client_socket, 401,
-                "{\"success\":false,\"error\":\"Token inválido ou expirado\"}");
+        p = json_espacos(p + 1, fim);
+        if (p < fim && *p == ',') {
+            p = json_espacos(p + 1, fim);
+            continue;
         }
-        return;
+        return (p < fim && *p == ']') ? n : -1;
     }
-    
-    // POST /logout
-    if (strcmp(path, "/logout") == 0) {
-        extrair_campo(body, "token", token, sizeof(token));
-        invalidar_sessao(token);
-        enviar_resposta(client_socket, 200,
-            "{\"success\":true,\"message\":\"Logout realizado\"}");
-        return;
+}
+
+// Nome seguro para ecoar em JSON e em logs: sem aspas, barras ou controles
+static bool nome_valido(const char *nome) {
+    if (nome[0] == '\0') return false;
+    for (const unsigned char *c = (const unsigned char *)nome; *c; c++) {
+        if (*c < 0x20 || *c == '"' || *c == '\\' || *c == 0x7f) return false;
     }
-    
-    // GET /stats
-    if (strcmp(path, "/stats") == 0) {
-        char json[512];
-        snprintf(json, sizeof(json),
-            "{\"users\":%d,\"sessions\":%d,\"active_sessions\":%d}",
-            user_count, session_count, session_count);  // Simplificado
-        enviar_resposta(client_socket, 200, json);
-        return;
+    return true;
+}
+
+// ─────────────────────────── Respostas ───────────────────────────
+
+/*
+ * Cada resposta vira até IOV_POR_RESPOSTA trechos enviados com um único
+ * sendmsg junto com as demais respostas do pipeline:
+ *   [linha de status + cabeçalhos fixos]  estático, montado em compilação
+ *   [tamanho do corpo]                    dígitos em conn->saida
+ *   [Connection + linha vazia]            estático
+ *   [corpo]                               literal estático ou cópia em conn->saida
+ */
+#define CABECALHOS_CORS \
+    "Access-Control-Allow-Origin: *\r\n" \
+    "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n" \
+    "Access-Control-Allow-Headers: Content-Type, Authorization\r\n" \
+    "Content-Length: "
+
+#define CABECALHOS_FIXOS "Content-Type: application/json\r\n" CABECALHOS_CORS
+
+typedef struct {
+    int status;
+    const char *bloco;
+    size_t len;
+} BlocoStatus;
+
+#define BLOCO_STATUS_CAB(cod, texto, extra) \
+    { cod, "HTTP/1.1 " #cod " " texto "\r\n" extra CABECALHOS_FIXOS, \
+      sizeof("HTTP/1.1 " #cod " " texto "\r\n" extra CABECALHOS_FIXOS) - 1 }
+#define BLOCO_STATUS(cod, texto) BLOCO_STATUS_CAB(cod, texto, "")
+
+static const BlocoStatus BLOCOS_STATUS[] = {
+    BLOCO_STATUS(200, "OK"),
+    BLOCO_STATUS(400, "Bad Request"),
+    BLOCO_STATUS(401, "Unauthorized"),
+    BLOCO_STATUS(404, "Not Found"),
+    BLOCO_STATUS(413, "Payload Too Large"),
+    BLOCO_STATUS_CAB(429, "Too Many Requests", "Retry-After: 1\r\n"),
+    BLOCO_STATUS_CAB(503, "Service Unavailable", "Retry-After: 1\r\n"),
+    BLOCO_STATUS(500, "Internal Server Error"),  // Último: usado como padrão
+};
+
+#define NUM_STATUS (sizeof(BLOCOS_STATUS) / sizeof(BLOCOS_STATUS[0]))
+
+// Exposição Prometheus: texto puro em vez de JSON
+static const BlocoStatus BLOCO_METRICAS = {
+    200, "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n" CABECALHOS_CORS,
+    sizeof("HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n" CABECALHOS_CORS) - 1
+};
+
+static const char FIM_MANTER[] = "\r\nConnection: keep-alive\r\n\r\n";
+static const char FIM_FECHAR[] = "\r\nConnection: close\r\n\r\n";
+
+static const BlocoStatus *bloco_status(int status) {
+    for (size_t i = 0; i < NUM_STATUS; i++) {
+        if (BLOCOS_STATUS[i].status == status) return &BLOCOS_STATUS[i];
     }
+    return &BLOCOS_STATUS[NUM_STATUS - 1];
+}
+
+// Decimal sem snprintf; retorna o número de dígitos (destino: 20 bytes)
+static size_t escrever_decimal(char *destino, uint64_t v) {
+    char tmp[20];
+    size_t n = 0;
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    for (size_t i = 0; i < n; i++) destino[i] = tmp[n - 1 - i];
+    return n;
+}
+
+static void saida_trecho(Conexao *conn, const void *base, size_t len) {
+    conn->iov[conn->iov_fim].iov_base = (void *)base;
+    conn->iov[conn->iov_fim].iov_len = len;
+    conn->iov_fim++;
+}
+
+/*
+ * Enfileira uma resposta. Corpos estáticos não são copiados; os demais vão
+ * para conn->saida. Quem processa requisições garante TAM_RESPOSTA_MAX
+ * livres em saida e IOV_POR_RESPOSTA trechos, então nada é truncado.
+ */
+static void responder_bloco(Conexao *conn, const BlocoStatus *b, const char *corpo, size_t len,
+                            bool copiar) {
+    conn->ultimo_status = b->status;
+    saida_trecho(conn, b->bloco, b->len);
     
-    // GET / (rota raiz)
-    if (strcmp(path, "/") == 0) {
-        enviar_resposta(client_socket, 200,
-            "{\"status\":\"online\",\"message\":\"Servidor de Autenticação AGLE\"}");
-        return;
-    }
+    char *digitos = conn->saida + conn->saida_len;
+    size_t n = escrever_decimal(digitos, len);
+    conn->saida_len += n;
+    saida_trecho(conn, digitos, n);
     
-    // Ignorar favicon (não é erro)
-    if (strstr(path, "favicon.ico") != NULL) {
-        enviar_resposta(client_socket, 404, "{\"error\":\"Not found\"}");
-        return;
+    if (conn->fechar_apos_envio) {
+        saida_trecho(conn, FIM_FECHAR, sizeof(FIM_FECHAR) - 1);
+    } else {
+        saida_trecho(conn, FIM_MANTER, sizeof(FIM_MANTER) - 1);
     }
     
-    // 404 - Rota não encontrada
-    enviar_resposta(client_socket, 400, "{\"error\":\"Rota não encontrada\"}");
+    if (copiar) {
+        char *destino = conn->saida + conn->saida_len;
+        memcpy(destino, corpo, len);
+        conn->saida_len += len;
+        corpo = destino;
+    }
+    if (len > 0) saida_trecho(conn, corpo, len);
 }
 
-// ═══════════════════════════════════════════════════════════
-//                    SERVIDOR HTTP
-// ═══════════════════════════════════════════════════════════
+static void responder(Conexao *conn, int status, const char *corpo, size_t len, bool copiar) {
+    responder_bloco(conn, bloco_status(status), corpo, len, copiar);
+}
 
-void iniciar_servidor(void) {
-    int server_socket, client_socket;
-    struct sockaddr_in server_addr, client_addr;
-    socklen_t client_len = sizeof(client_addr);
-    char buffer[4096];
+// Corpo constante: só o ponteiro vai para a fila
+#define RESPONDER(conn, status, literal) \
+    responder((conn), (status), (literal), sizeof(literal) - 1, false)
+
+// Corpo JSON montado por partes, com limite fixo e sem formatação printf
+typedef struct {
+    char buf[TAM_CORPO_MAX];
+    size_t len;
+    bool estourou;
+    char *grande;                 // Se não NULL, substitui buf (malloc, grande_cap bytes)
+    size_t grande_cap;
+} CorpoJson;
+
+static void corpo_bytes(CorpoJson *c, const char *s, size_t n) {
+    char *destino = c->grande != NULL ? c->grande : c->buf;
+    size_t cap = c->grande != NULL ? c->grande_cap : sizeof(c->buf);
+    if (c->estourou || n > cap - c->len) {
+        c->estourou = true;
+        return;
+    }
+    memcpy(destino + c->len, s, n);
+    c->len += n;
+}
+
+#define CORPO_LIT(c, literal) corpo_bytes((c), (literal), sizeof(literal) - 1)
+
+static void corpo_int(CorpoJson *c, int64_t v) {
+    char digitos[21];
+    size_t n = 0;
+    uint64_t u = (uint64_t)v;
+    if (v < 0) {
+        digitos[n++] = '-';
+        u = 0 - u;
+    }
+    n += escrever_decimal(digitos + n, u);
+    corpo_bytes(c, digitos, n);
+}
+
+// String JSON entre aspas, com escape de aspas, barras e controles
+static void corpo_str(CorpoJson *c, const char *s) {
+    static const char hex[] = "0123456789abcdef";
+    corpo_bytes(c, "\"", 1);
+    const char *trecho = s;
+    for (; *s; s++) {
+        unsigned char ch = (unsigned char)*s;
+        if (ch >= 0x20 && ch != '"' && ch != '\\') continue;
+        corpo_bytes(c, trecho, (size_t)(s - trecho));
+        char esc[6] = { '\\', (char)ch, 0, 0, 0, 0 };
+        size_t n = 2;
+        if (ch < 0x20) {
+            esc[1] = 'u'; esc[2] = '0'; esc[3] = '0';
+            esc[4] = hex[ch >> 4]; esc[5] = hex[ch & 0xf];
+            n = 6;
+        }
+        corpo_bytes(c, esc, n);
+        trecho = s + 1;
+    }
+    corpo_bytes(c, trecho, (size_t)(s - trecho));
+    corpo_bytes(c, "\"", 1);
+}
+
+// Um corpo grande vira o anexo da conexão (sem cópia); o pipeline pausa até o envio
+static void responder_corpo(Conexao *conn, int status, CorpoJson *c) {
+    if (c->estourou) {
+        free(c->grande);
+        c->grande = NULL;
+        RESPONDER(conn, 500, "{\"error\":\"Resposta muito grande\"}");
+        return;
+    }
+    if (c->grande != NULL) {
+        conn->anexo = c->grande;
+        c->grande = NULL;
+        responder(conn, status, conn->anexo, c->len, false);
+        return;
+    }
+    responder(conn, status, c->buf, c->len, true);
+}
+
+// ───────────────────────────── Métricas ─────────────────────────────
+
+/*
+ * Cada thread (loop de eventos ou trabalhador de KDF) conta num bloco
+ * próprio: só o dono escreve, com load + store relaxados, então registrar
+ * não custa RMW atômico nem disputa linhas de cache. GET /metrics soma os
+ * blocos de todas as threads; uma soma pode perder os últimos eventos de
+ * uma thread, nunca vê um contador pela metade.
+ *
+ * Histogramas no estilo HDR: baldes de 1 µs abaixo de 8 µs e, acima, 8
+ * sub-baldes por potência de 2 (erro relativo ≤ 12,5%) até ~18 minutos.
+ */
+#define SUBBALDES_HIST 8
+#define EXPOENTE_MAX_HIST 30                 // 2^30 µs; acima disso, último balde
+#define NUM_BALDES_HIST ((EXPOENTE_MAX_HIST - 1) * SUBBALDES_HIST)
+#define ENDPOINT_OUTROS (ENDPOINTS_METRICA - 1)  // OPTIONS, rota inexistente, erro de protocolo
+
+typedef struct {
+    uint64_t baldes[NUM_BALDES_HIST];
+    uint64_t soma_us;
+} Histograma;
+
+typedef enum {
+    REJEICAO_TAXA,                // Limite de taxa do cliente
+    REJEICAO_LIMITE,              // Teto de tarefas do endpoint
+    REJEICAO_ORCAMENTO,           // Espera estimada acima do orçamento
+    REJEICAO_PRAZO,               // Esperou demais na fila
+    NUM_REJEICOES
+} MotivoRejeicao;
+
+static const char *const NOMES_REJEICAO[NUM_REJEICOES] = {
+    "rate_limit", "endpoint_limit", "queue_budget", "queue_deadline"
+};
+
+typedef struct MetricasThread {
+    uint64_t requisicoes[ENDPOINTS_METRICA][NUM_STATUS];
+    Histograma latencia[ENDPOINTS_METRICA];
+    Histograma espera_kdf;        // Da chegada da requisição ao início do KDF
+    Histograma duracao_kdf;
+    uint64_t rejeicoes[NUM_REJEICOES];
+    uint64_t rng_pedidos;         // Chamadas ao gerador da thread
+    uint64_t rng_semeaduras;      // Semeaduras e reseeds dos geradores da thread
+    uint64_t conexoes;            // Gauge: conexões abertas no loop
+} MetricasThread;
+
+#define MAX_BLOCOS_METRICAS (MAX_THREADS + MAX_TRABALHADORES_KDF)
+
+// Criados antes das threads; cada thread guarda o seu em metricas_atual
+static MetricasThread *blocos_metricas[MAX_BLOCOS_METRICAS];
+static __thread MetricasThread *metricas_atual = NULL;
+static const char *nomes_endpoint[ENDPOINTS_METRICA];  // Preenchido por iniciar_rotas()
+
+static MetricasThread *novo_bloco_metricas(size_t indice) {
+    void *mem = NULL;
+    if (posix_memalign(&mem, 64, sizeof(MetricasThread)) != 0) {
+        fprintf(stderr, "❌ Sem memória para métricas\n");
+        exit(1);
+    }
+    memset(mem, 0, sizeof(MetricasThread));
+    blocos_metricas[indice] = mem;
+    return mem;
+}
+
+// Só o dono escreve no contador: sem RMW atômico
+static inline void somar(uint64_t *contador, uint64_t n) {
+    __atomic_store_n(contador, __atomic_load_n(contador, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+static unsigned balde_hist(uint64_t us) {
+    if (us < SUBBALDES_HIST) return (unsigned)us;
+    unsigned e = 63u - (unsigned)__builtin_clzll(us);
+    if (e > EXPOENTE_MAX_HIST) return NUM_BALDES_HIST - 1;
+    return (e - 2) * SUBBALDES_HIST + (unsigned)((us >> (e - 3)) & (SUBBALDES_HIST - 1));
+}
+
+// Menor valor (µs) que cai no balde i
+static uint64_t inicio_balde_hist(unsigned i) {
+    if (i < SUBBALDES_HIST) return i;
+    unsigned e = i / SUBBALDES_HIST + 2;
+    return (uint64_t)(SUBBALDES_HIST + i % SUBBALDES_HIST) << (e - 3);
+}
+
+static void histograma_registrar(Histograma *h, uint64_t us) {
+    somar(&h->baldes[balde_hist(us)], 1);
+    somar(&h->soma_us, us);
+}
+
+static void metricas_status(int endpoint, int status) {
+    size_t s = (size_t)(bloco_status(status) - BLOCOS_STATUS);
+    somar(&metricas_atual->requisicoes[endpoint][s], 1);
+}
+
+static void metricas_requisicao(int endpoint, int status, uint64_t duracao_us) {
+    metricas_status(endpoint, status);
+    histograma_registrar(&metricas_atual->latencia[endpoint], duracao_us);
+}
+
+static void metricas_rejeicao(MotivoRejeicao motivo) {
+    somar(&metricas_atual->rejeicoes[motivo], 1);
+}
+
+// Semeaduras já vistas do gerador da thread; AGLE_Init zera o contador
+static __thread uint64_t semeaduras_vistas = 0;
+
+// Depois de cada uso, para contar a semeadura que o próprio pedido causou;
+// o contexto só é lido pela thread dona
+static void metricas_rng(const AGLE_CTX *ctx) {
+    somar(&metricas_atual->rng_pedidos, 1);
+    if (ctx->seed_counter < semeaduras_vistas) {
+        semeaduras_vistas = 0;
+    }
+    somar(&metricas_atual->rng_semeaduras, ctx->seed_counter - semeaduras_vistas);
+    semeaduras_vistas = ctx->seed_counter;
+}
+
+static void histograma_acumular(Histograma *total, const Histograma *h) {
+    for (unsigned i = 0; i < NUM_BALDES_HIST; i++) {
+        total->baldes[i] += __atomic_load_n(&h->baldes[i], __ATOMIC_RELAXED);
+    }
+    total->soma_us += __atomic_load_n(&h->soma_us, __ATOMIC_RELAXED);
+}
+
+static void coletar_metricas(MetricasThread *total) {
+    memset(total, 0, sizeof(*total));
+    for (size_t b = 0; b < MAX_BLOCOS_METRICAS; b++) {
+        const MetricasThread *m = blocos_metricas[b];
+        if (m == NULL) continue;
+        for (int e = 0; e < ENDPOINTS_METRICA; e++) {
+            for (size_t s = 0; s < NUM_STATUS; s++) {
+                total->requisicoes[e][s] += __atomic_load_n(&m->requisicoes[e][s], __ATOMIC_RELAXED);
+            }
+            histograma_acumular(&total->latencia[e], &m->latencia[e]);
+        }
+        histograma_acumular(&total->espera_kdf, &m->espera_kdf);
+        histograma_acumular(&total->duracao_kdf, &m->duracao_kdf);
+        for (int r = 0; r < NUM_REJEICOES; r++) {
+            total->rejeicoes[r] += __atomic_load_n(&m->rejeicoes[r], __ATOMIC_RELAXED);
+        }
+        total->rng_pedidos += __atomic_load_n(&m->rng_pedidos, __ATOMIC_RELAXED);
+        total->rng_semeaduras += __atomic_load_n(&m->rng_semeaduras, __ATOMIC_RELAXED);
+        total->conexoes += __atomic_load_n(&m->conexoes, __ATOMIC_RELAXED);
+    }
+}
+
+// ───────────────────────── Parser HTTP incremental ─────────────────────────
+
+typedef enum {
+    PARSE_INCOMPLETO,     // Faltam bytes: aguardar próxima leitura
+    PARSE_OK,
+    PARSE_ERRO,           // Requisição malformada
+    PARSE_GRANDE          // Não cabe no buffer de recepção
+} ResultadoParse;
+
+static bool fatia_igual_ci(Fatia f, const char *lit, size_t lit_len) {
+    return f.len == lit_len && strncasecmp(f.ptr, lit, lit_len) == 0;
+}
+
+static Fatia fatia_aparar(Fatia f) {
+    while (f.len > 0 && (f.ptr[0] == ' ' || f.ptr[0] == '\t')) { f.ptr++; f.len--; }
+    while (f.len > 0 && (f.ptr[f.len - 1] == ' ' || f.ptr[f.len - 1] == '\t')) f.len--;
+    return f;
+}
+
+// Procura o próximo CRLF em [p, fim); retorna NULL se não houver
+static const char *proxima_linha(const char *p, const char *fim) {
+    const char *cr = memchr(p, '\r', (size_t)(fim - p));
+    while (cr != NULL && cr + 1 < fim && cr[1] != '\n') {
+        cr = memchr(cr + 1, '\r', (size_t)(fim - cr - 1));
+    }
+    return (cr != NULL && cr + 1 < fim) ? cr : NULL;
+}
+
+/*
+ * Analisa a próxima requisição em [entrada_ini, entrada_fim) sem copiar.
+ * O fim dos cabeçalhos é procurado só nos bytes novos (conn->varrido), então
+ * cabeçalhos que chegam aos poucos custam O(n) no total.
+ */
+static ResultadoParse http_analisar(Conexao *conn, Requisicao *req) {
+    const char *ini = conn->entrada + conn->entrada_ini;
+    const char *fim = conn->entrada + conn->entrada_fim;
+
+    size_t desde = conn->varrido > conn->entrada_ini + 3 ? conn->varrido - 3 : conn->entrada_ini;
+    const char *fim_cab = memmem(conn->entrada + desde, (size_t)(fim - conn->entrada) - desde,
+                                 "\r\n\r\n", 4);
+    if (fim_cab == NULL) {
+        conn->varrido = conn->entrada_fim;
+        return (conn->entrada_ini == 0 && conn->entrada_fim == TAM_ENTRADA) ?
+               PARSE_GRANDE : PARSE_INCOMPLETO;
+    }
+
+    memset(req, 0, sizeof(*req));
+
+    // Linha de requisição: MÉTODO SP CAMINHO SP VERSÃO
+    const char *eol = proxima_linha(ini, fim_cab + 2);
+    const char *sp1 = memchr(ini, ' ', (size_t)(eol - ini));
+    if (sp1 == NULL) return PARSE_ERRO;
+    const char *sp2 = memchr(sp1 + 1, ' ', (size_t)(eol - sp1 - 1));
+    if (sp2 == NULL) return PARSE_ERRO;
+
+    req->metodo = (Fatia){ ini, (size_t)(sp1 - ini) };
+    req->caminho = (Fatia){ sp1 + 1, (size_t)(sp2 - sp1 - 1) };
+    Fatia versao = { sp2 + 1, (size_t)(eol - sp2 - 1) };
+    if (req->metodo.len == 0 || req->caminho.len == 0) return PARSE_ERRO;
+    req->manter_conexao = fatia_igual_ci(versao, "HTTP/1.1", 8);
+
+    // Cabeçalhos relevantes. O enquadramento é estrito: com pipeline, um
+    // tamanho ambíguo faria o resto do corpo virar a próxima requisição
+    size_t content_length = 0;
+    bool tem_tamanho = false;
+    const char *linha = eol + 2;
+    while (linha < fim_cab + 2) {
+        const char *fim_linha = proxima_linha(linha, fim_cab + 2);
+        const char *dois_pontos = memchr(linha, ':', (size_t)(fim_linha - linha));
+        if (dois_pontos == NULL) return PARSE_ERRO;
+
+        Fatia nome = { linha, (size_t)(dois_pontos - linha) };
+        Fatia valor = fatia_aparar((Fatia){ dois_pontos + 1, (size_t)(fim_linha - dois_pontos - 1) });
+
+        if (fatia_igual_ci(nome, "Content-Length", 14)) {
+            // Repetido ou vazio: erro, nunca "vale o último" nem zero
+            if (tem_tamanho || valor.len == 0) return PARSE_ERRO;
+            tem_tamanho = true;
+            for (size_t i = 0; i < valor.len; i++) {
+                if (!isdigit((unsigned char)valor.ptr[i])) return PARSE_ERRO;
+                content_length = content_length * 10 + (size_t)(valor.ptr[i] - '0');
+                if (content_length > TAM_ENTRADA) return PARSE_GRANDE;
+            }
+        } else if (fatia_igual_ci(nome, "Transfer-Encoding", 17)) {
+            // Sem suporte a chunked: o corpo seria lido como outra requisição
+            return PARSE_ERRO;
+        } else if (fatia_igual_ci(nome, "Connection", 10)) {
+            if (fatia_igual_ci(valor, "close", 5)) req->manter_conexao = false;
+            else if (fatia_igual_ci(valor, "keep-alive", 10)) req->manter_conexao = true;
+        } else if (fatia_igual_ci(nome, "Authorization", 13)) {
+            req->autorizacao = valor;
+        }
+        linha = fim_linha + 2;
+    }
+
+    size_t cab_len = (size_t)(fim_cab + 4 - ini);
+    if (cab_len + content_length > TAM_ENTRADA) return PARSE_GRANDE;
+    if ((size_t)(fim - ini) < cab_len + content_length) return PARSE_INCOMPLETO;
+
+    req->corpo = (Fatia){ fim_cab + 4, content_length };
+    req->tamanho = cab_len + content_length;
+    return PARSE_OK;
+}
+
+// ───────────────────────────── Pool de KDF ─────────────────────────────
+
+/*
+ * Register e login custam uma derivação de chave (~80 ms). Para não travar
+ * as outras conexões do loop, a requisição vira uma tarefa numa fila
+ * lock-free; um trabalhador calcula o hash, monta a resposta e a devolve
+ * ao loop dono da conexão por uma pilha lock-free + eventfd. Enquanto isso
+ * o pipeline da conexão fica pausado, então as respostas saem em ordem.
+ *
+ * Sob sobrecarga a fila não cresce sem limite: cada endpoint tem um teto de
+ * tarefas, a espera estimada tem um orçamento e tarefas velhas demais são
+ * descartadas sem KDF. Endpoints baratos (/validate, /stats...) nunca entram
+ * na fila: rodam direto no loop, à frente de qualquer hashing.
+ */
+
+static uint64_t agora_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static uint64_t agora_ms(void) {
+    return agora_us() / 1000u;
+}
+
+// Também a ordem de prioridade das faixas: login antes de registro
+typedef enum { TAREFA_LOGIN, TAREFA_REGISTRO, NUM_TIPOS_TAREFA } TipoTarefa;
+
+typedef struct TarefaKdf {
+    TipoTarefa tipo;
+    Conexao *conn;
+    LoopEventos *loop;            // Dono da conexão: recebe a conclusão
+    struct TarefaKdf *prox;       // Pilha de concluídas do loop
+    uint64_t chegada_us;          // Chegada da requisição: prazo e tempo de espera
+    char username[64];
+    char password[128];
+    int status;                   // Resposta montada pelo trabalhador
+    CorpoJson corpo;
+} TarefaKdf;
+
+// Fila MPMC limitada (Vyukov): a sequência de cada célula diz de quem é a vez
+typedef struct {
+    size_t seq;
+    TarefaKdf *tarefa;
+} CelulaKdf;
+
+typedef struct {
+    CelulaKdf celulas[CAPACIDADE_FILA_KDF];
+    size_t cabeca AGLE_CACHE_ALIGNED;  // Próxima posição a enfileirar
+    size_t cauda AGLE_CACHE_ALIGNED;   // Próxima posição a desenfileirar
+} FilaKdf;
+
+static const uint32_t LIMITES_KDF[NUM_TIPOS_TAREFA] = {
+    [TAREFA_LOGIN] = LIMITE_KDF_LOGIN,
+    [TAREFA_REGISTRO] = LIMITE_KDF_REGISTRO,
+};
+
+static struct {
+    FilaKdf faixas[NUM_TIPOS_TAREFA];  // Uma faixa por endpoint
+    uint32_t pendentes[NUM_TIPOS_TAREFA] AGLE_CACHE_ALIGNED;  // Na fila ou em execução
+    uint64_t custo_medio_us;           // Média móvel do tempo de uma tarefa
+    int trabalhadores;
+    bool parar;                        // Encerramento: trabalhadores saem ao acordar
+    sem_t disponiveis;                 // Uma unidade por tarefa enfileirada
+} pool_kdf;
+
+typedef struct {
+    AGLE_CTX ctx;
+    MetricasThread *metricas;
+} TrabalhadorKdf;
+
+static TrabalhadorKdf contextos_kdf[MAX_TRABALHADORES_KDF];
+static pthread_t trabalhadores_kdf[MAX_TRABALHADORES_KDF];
+
+static bool fila_kdf_enfileirar(FilaKdf *f, TarefaKdf *t) {
+    size_t pos = __atomic_load_n(&f->cabeca, __ATOMIC_RELAXED);
+    for (;;) {
+        CelulaKdf *c = &f->celulas[pos & (CAPACIDADE_FILA_KDF - 1)];
+        size_t seq = __atomic_load_n(&c->seq, __ATOMIC_ACQUIRE);
+        intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+        if (dif == 0) {
+            if (__atomic_compare_exchange_n(&f->cabeca, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                c->tarefa = t;
+                __atomic_store_n(&c->seq, pos + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+        } else if (dif < 0) {
+            return false;  // Cheia: a célula ainda não foi consumida
+        } else {
+            pos = __atomic_load_n(&f->cabeca, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static TarefaKdf *fila_kdf_desenfileirar(FilaKdf *f) {
+    size_t pos = __atomic_load_n(&f->cauda, __ATOMIC_RELAXED);
+    for (;;) {
+        CelulaKdf *c = &f->celulas[pos & (CAPACIDADE_FILA_KDF - 1)];
+        size_t seq = __atomic_load_n(&c->seq, __ATOMIC_ACQUIRE);
+        intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (dif == 0) {
+            if (__atomic_compare_exchange_n(&f->cauda, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                TarefaKdf *t = c->tarefa;
+                __atomic_store_n(&c->seq, pos + CAPACIDADE_FILA_KDF, __ATOMIC_RELEASE);
+                return t;
+            }
+        } else if (dif < 0) {
+            return NULL;  // Vazia (ou produtor ainda publicando a célula)
+        } else {
+            pos = __atomic_load_n(&f->cauda, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// Faixas em ordem de prioridade: logins de contas existentes passam na frente
+static TarefaKdf *proxima_tarefa(void) {
+    for (int i = 0; i < NUM_TIPOS_TAREFA; i++) {
+        TarefaKdf *t = fila_kdf_desenfileirar(&pool_kdf.faixas[i]);
+        if (t != NULL) return t;
+    }
+    return NULL;
+}
+
+// Roda no trabalhador: a mesma lógica que antes rodava no loop de eventos
+static void executar_tarefa(TarefaKdf *t) {
+    CorpoJson *corpo = &t->corpo;
+    
+    if (t->tipo == TAREFA_REGISTRO) {
+        if (registrar_usuario(t->username, t->password)) {
+            t->status = 200;
+            CORPO_LIT(corpo, "{\"success\":true,\"message\":\"Usuário registrado!\"}");
+        } else {
+            t->status = 400;
+            CORPO_LIT(corpo, "{\"success\":false,\"error\":\"Usuário já existe\"}");
+        }
+    } else {
+        uint32_t id;
+        char session_token[TAM_TOKEN];
+        bool existe = encontrar_usuario(t->username, &id);
+        if (!existe) {
+            simular_validacao(t->password);
+        }
+        if (existe && validar_senha(id, t->password) &&
+            criar_sessao(t->username, id, session_token)) {
+            t->status = 200;
+            CORPO_LIT(corpo, "{\"success\":true,\"token\":");
+            corpo_str(corpo, session_token);
+            CORPO_LIT(corpo, ",\"username\":");
+            corpo_str(corpo, t->username);
+            CORPO_LIT(corpo, "}");
+            AGLE_SecureZero(session_token, sizeof(session_token));
+        } else {
+            t->status = 401;
+            CORPO_LIT(corpo, "{\"success\":false,\"error\":\"Credenciais inválidas\"}");
+        }
+    }
+}
+
+// Devolve a tarefa ao loop dono: push na pilha e aviso pelo eventfd
+static void concluir_tarefa(TarefaKdf *t) {
+    LoopEventos *loop = t->loop;
+    TarefaKdf *topo = __atomic_load_n(&loop->concluidas, __ATOMIC_RELAXED);
+    do {
+        t->prox = topo;
+    } while (!__atomic_compare_exchange_n(&loop->concluidas, &topo, t, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    
+    uint64_t um = 1;
+    while (write(loop->evento_fd, &um, sizeof(um)) < 0 && errno == EINTR) {}
+}
+
+static void *trabalhador_kdf(void *arg) {
+    TrabalhadorKdf *eu = arg;
+    gerador_atual = &eu->ctx;
+    metricas_atual = eu->metricas;
+    for (;;) {
+        while (sem_wait(&pool_kdf.disponiveis) != 0) {}  // EINTR
+        if (__atomic_load_n(&pool_kdf.parar, __ATOMIC_ACQUIRE)) break;
+        
+        // O semáforo garante uma tarefa; ela pode estar sendo publicada
+        TarefaKdf *t;
+        while ((t = proxima_tarefa()) == NULL) sched_yield();
+        
+        uint64_t inicio = agora_us();
+        uint64_t espera = inicio - t->chegada_us;
+        histograma_registrar(&metricas_atual->espera_kdf, espera);
+        if (espera / 1000u > PRAZO_FILA_KDF_MS) {
+            // O cliente provavelmente já desistiu: não gastar um KDF nela
+            t->status = 503;
+            CORPO_LIT(&t->corpo, "{\"success\":false,\"error\":\"Servidor ocupado\"}");
+            metricas_rejeicao(REJEICAO_PRAZO);
+        } else {
+            executar_tarefa(t);
+            // Média móvel (1/8): corridas entre trabalhadores só perdem amostras
+            uint64_t custo = agora_us() - inicio;
+            histograma_registrar(&metricas_atual->duracao_kdf, custo);
+            uint64_t media = __atomic_load_n(&pool_kdf.custo_medio_us, __ATOMIC_RELAXED);
+            __atomic_store_n(&pool_kdf.custo_medio_us, (media * 7 + custo) / 8, __ATOMIC_RELAXED);
+        }
+        AGLE_SecureZero(t->password, sizeof(t->password));
+        
+        // Antes da conclusão: depois dela a tarefa pertence ao loop
+        __atomic_fetch_sub(&pool_kdf.pendentes[t->tipo], 1, __ATOMIC_RELAXED);
+        concluir_tarefa(t);
+    }
+    return NULL;
+}
+
+static void iniciar_pool_kdf(int num_trabalhadores) {
+    for (int f = 0; f < NUM_TIPOS_TAREFA; f++) {
+        for (size_t i = 0; i < CAPACIDADE_FILA_KDF; i++) {
+            pool_kdf.faixas[f].celulas[i].seq = i;
+        }
+    }
+    pool_kdf.custo_medio_us = CUSTO_KDF_INICIAL_US;
+    pool_kdf.trabalhadores = num_trabalhadores;
+    if (sem_init(&pool_kdf.disponiveis, 0, 0) != 0) {
+        perror("❌ Erro no sem_init");
+        exit(1);
+    }
+    
+    for (int i = 0; i < num_trabalhadores; i++) {
+        if (!AGLE_Init(&contextos_kdf[i].ctx)) {
+            fprintf(stderr, "❌ Erro ao inicializar AGLE!\n");
+            exit(1);
+        }
+        contextos_kdf[i].metricas = novo_bloco_metricas(MAX_THREADS + (size_t)i);
+        if (pthread_create(&trabalhadores_kdf[i], NULL, trabalhador_kdf, &contextos_kdf[i]) != 0) {
+            perror("❌ Erro ao criar trabalhador de KDF");
+            exit(1);
+        }
+    }
+}
+
+// Tarefas em execução terminam (e gravam no log); as ainda na fila são
+// descartadas junto com suas conexões
+static void parar_pool_kdf(void) {
+    __atomic_store_n(&pool_kdf.parar, true, __ATOMIC_RELEASE);
+    for (int i = 0; i < pool_kdf.trabalhadores; i++) {
+        sem_post(&pool_kdf.disponiveis);
+    }
+    for (int i = 0; i < pool_kdf.trabalhadores; i++) {
+        pthread_join(trabalhadores_kdf[i], NULL);
+        AGLE_Cleanup(&contextos_kdf[i].ctx);
+    }
+}
+
+/*
+ * Admissão, do mais barato ao mais caro de recusar depois:
+ *   - limite de tarefas do endpoint (na fila + em execução) → 429
+ *   - espera estimada acima do orçamento → 503
+ * A estimativa conta só as faixas que seriam atendidas antes desta.
+ */
+static int admitir_kdf(TipoTarefa tipo) {
+    uint32_t pendentes = __atomic_add_fetch(&pool_kdf.pendentes[tipo], 1, __ATOMIC_RELAXED);
+    if (pendentes > LIMITES_KDF[tipo]) return 429;
+    
+    uint64_t a_frente = 0;
+    for (int i = 0; i <= (int)tipo; i++) {
+        a_frente += __atomic_load_n(&pool_kdf.pendentes[i], __ATOMIC_RELAXED);
+    }
+    uint64_t custo = __atomic_load_n(&pool_kdf.custo_medio_us, __ATOMIC_RELAXED);
+    uint64_t espera_ms = a_frente * custo / (uint64_t)pool_kdf.trabalhadores / 1000u;
+    if (a_frente > (uint64_t)pool_kdf.trabalhadores && espera_ms > ORCAMENTO_FILA_KDF_MS) {
+        return 503;
+    }
+    return 200;
+}
+
+/*
+ * Limite de taxa do cliente: um SipHash e dois CAS por limitador, então um
+ * cliente abusivo custa nanossegundos em vez de um KDF. Vale para qualquer
+ * usuário, ao contrário do bloqueio por conta em validar_senha().
+ */
+static bool cliente_dentro_do_limite(const Conexao *conn) {
+    uint32_t subrede = conn->ip & htonl(0xffffff00u);
+    uint64_t agora = loop_atual->agora_ms;
+    if (AGLE_RateLimitTake(limite_ip, &conn->ip, sizeof(conn->ip), agora) &&
+        AGLE_RateLimitTake(limite_subrede, &subrede, sizeof(subrede), agora)) {
+        return true;
+    }
+    metricas_rejeicao(REJEICAO_TAXA);
+    return false;
+}
+
+// Enfileira o hashing; a resposta chega depois, via receber_concluidas()
+static void submeter_kdf(Conexao *conn, TipoTarefa tipo, const char *username,
+                         const char *password) {
+    if (!cliente_dentro_do_limite(conn)) {
+        RESPONDER(conn, 429, "{\"success\":false,\"error\":\"Muitas tentativas deste endereço\"}");
+        return;
+    }
+    
+    int admissao = admitir_kdf(tipo);
+    TarefaKdf *t = NULL;
+    if (admissao == 200) {
+        t = calloc(1, sizeof(TarefaKdf));
+    }
+    if (t != NULL) {
+        t->tipo = tipo;
+        t->conn = conn;
+        t->loop = loop_atual;
+        t->chegada_us = conn->inicio_us;
+        memcpy(t->username, username, sizeof(t->username));
+        memcpy(t->password, password, sizeof(t->password));
+        if (fila_kdf_enfileirar(&pool_kdf.faixas[tipo], t)) {
+            conn->aguardando_kdf = true;
+            sem_post(&pool_kdf.disponiveis);
+            return;
+        }
+        AGLE_SecureZero(t, sizeof(TarefaKdf));
+        free(t);
+        admissao = 503;
+    }
+    
+    __atomic_fetch_sub(&pool_kdf.pendentes[tipo], 1, __ATOMIC_RELAXED);
+    metricas_rejeicao(admissao == 429 ? REJEICAO_LIMITE : REJEICAO_ORCAMENTO);
+    if (admissao == 429) {
+        RESPONDER(conn, 429, "{\"success\":false,\"error\":\"Muitas requisições, tente novamente\"}");
+    } else {
+        RESPONDER(conn, 503, "{\"success\":false,\"error\":\"Servidor ocupado\"}");
+    }
+}
+
+// ───────────────────────────── Rotas ─────────────────────────────
+
+static void rota_register(Conexao *conn, const Requisicao *req) {
+    char username[64] = {0}, password[128] = {0};
+    CampoJson campos[] = { CAMPO_JSON("username"), CAMPO_JSON("password") };
+    bool lido = json_extrair(req->corpo, campos, 2) &&
+                json_copiar(&campos[0], username, sizeof(username)) &&
+                json_copiar(&campos[1], password, sizeof(password));
+    
+    if (!lido || !nome_valido(username) || strlen(password) < 8) {
+        AGLE_SecureZero(password, sizeof(password));
+        RESPONDER(conn, 400, 
+            "{\"success\":false,\"error\":\"Dados inválidos\"}");
+        return;
+    }
+    
+    submeter_kdf(conn, TAREFA_REGISTRO, username, password);
+    AGLE_SecureZero(password, sizeof(password));
+}
+
+static void rota_login(Conexao *conn, const Requisicao *req) {
+    char username[64] = {0}, password[128] = {0};
+    CampoJson campos[] = { CAMPO_JSON("username"), CAMPO_JSON("password") };
+    if (!json_extrair(req->corpo, campos, 2)) {
+        RESPONDER(conn, 400,
+            "{\"success\":false,\"error\":\"JSON inválido\"}");
+        return;
+    }
+    
+    if (json_copiar(&campos[0], username, sizeof(username)) &&
+        json_copiar(&campos[1], password, sizeof(password))) {
+        submeter_kdf(conn, TAREFA_LOGIN, username, password);
+    } else {
+        RESPONDER(conn, 401,
+            "{\"success\":false,\"error\":\"Credenciais inválidas\"}");
+    }
+    AGLE_SecureZero(password, sizeof(password));
+}
+
+static void rota_validate(Conexao *conn, const Requisicao *req) {
+    // Token do header Authorization, direto do buffer de recepção
+    Fatia auth = req->autorizacao;
+    Fatia token = { NULL, 0 };
+    if (auth.len > 7 && strncasecmp(auth.ptr, "Bearer ", 7) == 0) {
+        token = (Fatia){ auth.ptr + 7, auth.len - 7 };
+    }
+    
+    AGLE_SessionInfo sess;
+    if (validar_token(token.ptr, token.len, &sess)) {
+        CorpoJson corpo = {0};
+        CORPO_LIT(&corpo, "{\"success\":true,\"username\":");
+        corpo_str(&corpo, sess.username);
+        CORPO_LIT(&corpo, ",\"expires_in\":");
+        corpo_int(&corpo, sess.expires_at - (int64_t)time(NULL));
+        CORPO_LIT(&corpo, "}");
+        responder_corpo(conn, 200, &corpo);
+    } else {
+        RESPONDER(conn, 401,
+            "{\"success\":false,\"error\":\"Token inválido ou expirado\"}");
+    }
+}
+
+/*
+ * Valida até MAX_TOKENS_LOTE tokens numa requisição: {"tokens":["...",...]}
+ * → {"success":true,"results":[{"valid":...},...]} na mesma ordem. Uma só
+ * passada pela tabela (AGLE_SessionLookupBatch, com prefetch) em vez de uma
+ * ida e volta HTTP por token. Tokens assinados são verificados à parte.
+ */
+static void rota_validate_lote(Conexao *conn, const Requisicao *req) {
+    CampoJson campos[] = { CAMPO_JSON("tokens") };
+    Fatia itens[MAX_TOKENS_LOTE];
+    int n = -1;
+    if (json_extrair(req->corpo, campos, 1) && campos[0].bruto) {
+        n = json_array_strings(campos[0].valor, itens, MAX_TOKENS_LOTE);
+    }
+    if (n == -2) {
+        RESPONDER(conn, 413, "{\"success\":false,\"error\":\"Tokens demais no lote\"}");
+        return;
+    }
+    if (n < 0) {
+        RESPONDER(conn, 400, "{\"success\":false,\"error\":\"JSON inválido\"}");
+        return;
+    }
+    
+    // Resultados em sessoes_lote[0..n); a busca na tabela escreve em [n..2n)
+    CorpoJson corpo = {0};
+    corpo.grande_cap = (size_t)n * TAM_ITEM_LOTE + 64;
+    corpo.grande = malloc(corpo.grande_cap);
+    size_t tam_lote = (size_t)(2 * n + 1) * sizeof(AGLE_SessionInfo);
+    AGLE_SessionInfo *sessoes_lote = malloc(tam_lote);
+    if (corpo.grande == NULL || sessoes_lote == NULL) {
+        free(corpo.grande);
+        free(sessoes_lote);
+        RESPONDER(conn, 500, "{\"error\":\"Sem memória\"}");
+        return;
+    }
+    
+    int64_t agora = (int64_t)time(NULL);
+    const char *tokens[MAX_TOKENS_LOTE];
+    size_t tamanhos[MAX_TOKENS_LOTE];
+    int posicoes[MAX_TOKENS_LOTE];
+    bool validos[MAX_TOKENS_LOTE];
+    bool achados[MAX_TOKENS_LOTE];
+    size_t na_tabela = 0;
+    for (int i = 0; i < n; i++) {
+        if (token_assinado(itens[i].ptr, itens[i].len)) {
+            AGLE_TokenClaims claims;
+            validos[i] = validar_assinado(itens[i].ptr, itens[i].len, agora, &claims,
+                                          &sessoes_lote[i]);
+        } else if (!token_na_tabela(itens[i].ptr, itens[i].len)) {
+            validos[i] = false;
+        } else {
+            tokens[na_tabela] = itens[i].ptr;
+            tamanhos[na_tabela] = itens[i].len;
+            posicoes[na_tabela++] = i;
+        }
+    }
+    AGLE_SessionLookupBatch(sessoes, tokens, tamanhos, na_tabela, agora, sessoes_lote + n, achados);
+    for (size_t j = 0; j < na_tabela; j++) {
+        validos[posicoes[j]] = achados[j];
+        sessoes_lote[posicoes[j]] = sessoes_lote[n + j];
+    }
+    
+    CORPO_LIT(&corpo, "{\"success\":true,\"results\":[");
+    for (int i = 0; i < n; i++) {
+        if (i > 0) CORPO_LIT(&corpo, ",");
+        if (!validos[i]) {
+            CORPO_LIT(&corpo, "{\"valid\":false}");
+            continue;
+        }
+        CORPO_LIT(&corpo, "{\"valid\":true,\"username\":");
+        corpo_str(&corpo, sessoes_lote[i].username);
+        CORPO_LIT(&corpo, ",\"expires_in\":");
+        corpo_int(&corpo, sessoes_lote[i].expires_at - agora);
+        CORPO_LIT(&corpo, "}");
+    }
+    CORPO_LIT(&corpo, "]}");
+    AGLE_SecureZero(sessoes_lote, tam_lote);
+    free(sessoes_lote);
+    responder_corpo(conn, 200, &corpo);
+}
+
+static void rota_logout(Conexao *conn, const Requisicao *req) {
+    char token[128] = {0};
+    CampoJson campos[] = { CAMPO_JSON("token") };
+    if (!json_extrair(req->corpo, campos, 1)) {
+        RESPONDER(conn, 400,
+            "{\"success\":false,\"error\":\"JSON inválido\"}");
+        return;
+    }
+    if (json_copiar(&campos[0], token, sizeof(token))) {
+        invalidar_sessao(token, strlen(token));
+    }
+    RESPONDER(conn, 200,
+        "{\"success\":true,\"message\":\"Logout realizado\"}");
+}
+
+static void rota_stats(Conexao *conn, const Requisicao *req) {
+    (void)req;
+    MetricasThread *m = malloc(sizeof(MetricasThread));
+    if (m == NULL) {
+        RESPONDER(conn, 500, "{\"error\":\"Sem memória\"}");
+        return;
+    }
+    coletar_metricas(m);
+    uint64_t descartadas = m->rejeicoes[REJEICAO_LIMITE] + m->rejeicoes[REJEICAO_ORCAMENTO] +
+                           m->rejeicoes[REJEICAO_PRAZO];
+    uint64_t limitadas = m->rejeicoes[REJEICAO_TAXA];
+    free(m);
+    
+    size_t total_usuarios = AGLE_UserDirCount(usuarios);
+    size_t total_sessoes = AGLE_SessionStoreCount(sessoes);
+    // A roda só avança a cada tick: avançá-la agora deixa só as não expiradas
+    expirar_sessoes(time(NULL));
+    size_t sessoes_ativas = AGLE_SessionStoreCount(sessoes);
+    CorpoJson corpo = {0};
+    CORPO_LIT(&corpo, "{\"users\":");
+    corpo_int(&corpo, (int64_t)total_usuarios);
+    CORPO_LIT(&corpo, ",\"sessions\":");
+    corpo_int(&corpo, (int64_t)total_sessoes);
+    CORPO_LIT(&corpo, ",\"active_sessions\":");
+    corpo_int(&corpo, (int64_t)sessoes_ativas);
+    CORPO_LIT(&corpo, ",\"revoked_tokens\":");
+    corpo_int(&corpo, (int64_t)AGLE_TokenRevokedCount(assinador));
+    CORPO_LIT(&corpo, ",\"kdf_pending\":");
+    corpo_int(&corpo, (int64_t)(__atomic_load_n(&pool_kdf.pendentes[TAREFA_LOGIN], __ATOMIC_RELAXED) +
+                                __atomic_load_n(&pool_kdf.pendentes[TAREFA_REGISTRO], __ATOMIC_RELAXED)));
+    CORPO_LIT(&corpo, ",\"kdf_shed\":");
+    corpo_int(&corpo, (int64_t)descartadas);
+    CORPO_LIT(&corpo, ",\"rate_limited\":");
+    corpo_int(&corpo, (int64_t)limitadas);
+    CORPO_LIT(&corpo, "}");
+    responder_corpo(conn, 200, &corpo);
+}
+
+// Texto de /metrics: buffer malloc de tamanho fixo
+typedef struct {
+    char *buf;
+    size_t len;
+    bool estourou;
+} TextoMetricas;
+
+static void metricas_printf(TextoMetricas *t, const char *formato, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void metricas_printf(TextoMetricas *t, const char *formato, ...) {
+    if (t->estourou) return;
+    va_list args;
+    va_start(args, formato);
+    int n = vsnprintf(t->buf + t->len, TAM_METRICAS_MAX - t->len, formato, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= TAM_METRICAS_MAX - t->len) {
+        t->estourou = true;
+        return;
+    }
+    t->len += (size_t)n;
+}
+
+static uint64_t histograma_total(const Histograma *h) {
+    uint64_t total = 0;
+    for (unsigned i = 0; i < NUM_BALDES_HIST; i++) total += h->baldes[i];
+    return total;
+}
+
+// Quantil q em segundos, pelo meio do balde que o contém
+static double histograma_quantil(const Histograma *h, uint64_t total, double q) {
+    uint64_t alvo = (uint64_t)(q * (double)(total - 1));
+    uint64_t acumulado = 0;
+    for (unsigned i = 0; i < NUM_BALDES_HIST; i++) {
+        acumulado += h->baldes[i];
+        if (acumulado > alvo) {
+            double ini = (double)inicio_balde_hist(i);
+            double fim = i + 1 < NUM_BALDES_HIST ? (double)inicio_balde_hist(i + 1) : ini;
+            return (ini + fim) / 2 / 1e6;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Histograma Prometheus: baldes cumulativos nas potências de 2 de 16 µs a
+ * ~67 s (fronteiras exatas dos baldes internos), +Inf, soma e contagem.
+ * rotulos: pares extras já formatados (ex.: endpoint="/login") ou "".
+ */
+static void metricas_histograma(TextoMetricas *t, const char *nome, const char *rotulos,
+                                const Histograma *h) {
+    const char *sep = rotulos[0] ? "," : "";
+    uint64_t acumulado = 0;
+    unsigned i = 0;
+    for (unsigned e = 4; e <= 26; e++) {
+        uint64_t limite = UINT64_C(1) << e;
+        while (i < NUM_BALDES_HIST && inicio_balde_hist(i) < limite) acumulado += h->baldes[i++];
+        metricas_printf(t, "%s_bucket{%s%sle=\"%g\"} %" PRIu64 "\n",
+                        nome, rotulos, sep, (double)limite / 1e6, acumulado);
+    }
+    while (i < NUM_BALDES_HIST) acumulado += h->baldes[i++];
+    metricas_printf(t, "%s_bucket{%s%sle=\"+Inf\"} %" PRIu64 "\n", nome, rotulos, sep, acumulado);
+    const char *abre = rotulos[0] ? "{" : "", *fecha = rotulos[0] ? "}" : "";
+    metricas_printf(t, "%s_sum%s%s%s %.6f\n", nome, abre, rotulos, fecha, (double)h->soma_us / 1e6);
+    metricas_printf(t, "%s_count%s%s%s %" PRIu64 "\n", nome, abre, rotulos, fecha, acumulado);
+}
+
+// Soma os blocos de todas as threads e formata no padrão de texto do Prometheus
+static bool gerar_metricas(char **saida, size_t *len) {
+    static const char *const NOMES_FAIXA[NUM_TIPOS_TAREFA] = { "login", "register" };
+    static const double QUANTIS[] = { 0.5, 0.9, 0.99, 0.999 };
+    
+    MetricasThread *m = malloc(sizeof(MetricasThread));
+    TextoMetricas t = { malloc(TAM_METRICAS_MAX), 0, false };
+    if (m == NULL || t.buf == NULL) {
+        free(m);
+        free(t.buf);
+        return false;
+    }
+    coletar_metricas(m);
+    
+    metricas_printf(&t, "# HELP agle_http_requests_total Respostas por endpoint e status.\n"
+                        "# TYPE agle_http_requests_total counter\n");
+    for (int e = 0; e < ENDPOINTS_METRICA; e++) {
+        if (nomes_endpoint[e] == NULL) continue;
+        for (size_t s = 0; s < NUM_STATUS; s++) {
+            if (m->requisicoes[e][s] == 0) continue;
+            metricas_printf(&t, "agle_http_requests_total{endpoint=\"%s\",code=\"%d\"} %" PRIu64 "\n",
+                            nomes_endpoint[e], BLOCOS_STATUS[s].status, m->requisicoes[e][s]);
+        }
+    }
+    
+    metricas_printf(&t, "# HELP agle_http_request_duration_seconds Da chegada da requisição à resposta enfileirada.\n"
+                        "# TYPE agle_http_request_duration_seconds histogram\n");
+    for (int e = 0; e < ENDPOINTS_METRICA; e++) {
+        if (nomes_endpoint[e] == NULL || histograma_total(&m->latencia[e]) == 0) continue;
+        char rotulos[64];
+        snprintf(rotulos, sizeof(rotulos), "endpoint=\"%s\"", nomes_endpoint[e]);
+        metricas_histograma(&t, "agle_http_request_duration_seconds", rotulos, &m->latencia[e]);
+    }
+    
+    metricas_printf(&t, "# HELP agle_http_request_duration_quantile_seconds Quantis estimados dos histogramas de latência.\n"
+                        "# TYPE agle_http_request_duration_quantile_seconds gauge\n");
+    for (int e = 0; e < ENDPOINTS_METRICA; e++) {
+        uint64_t total = histograma_total(&m->latencia[e]);
+        if (nomes_endpoint[e] == NULL || total == 0) continue;
+        for (size_t q = 0; q < sizeof(QUANTIS) / sizeof(QUANTIS[0]); q++) {
+            metricas_printf(&t, "agle_http_request_duration_quantile_seconds{endpoint=\"%s\",quantile=\"%g\"} %.6f\n",
+                            nomes_endpoint[e], QUANTIS[q], histograma_quantil(&m->latencia[e], total, QUANTIS[q]));
+        }
+    }
+    
+    metricas_printf(&t, "# HELP agle_requests_rejected_total Requisições recusadas antes do KDF, por motivo.\n"
+                        "# TYPE agle_requests_rejected_total counter\n");
+    for (int r = 0; r < NUM_REJEICOES; r++) {
+        metricas_printf(&t, "agle_requests_rejected_total{reason=\"%s\"} %" PRIu64 "\n",
+                        NOMES_REJEICAO[r], m->rejeicoes[r]);
+    }
+    
+    metricas_printf(&t, "# HELP agle_kdf_queue_depth Tarefas de KDF na fila ou em execução.\n"
+                        "# TYPE agle_kdf_queue_depth gauge\n");
+    for (int f = 0; f < NUM_TIPOS_TAREFA; f++) {
+        metricas_printf(&t, "agle_kdf_queue_depth{lane=\"%s\"} %u\n", NOMES_FAIXA[f],
+                        __atomic_load_n(&pool_kdf.pendentes[f], __ATOMIC_RELAXED));
+    }
+    metricas_printf(&t, "# HELP agle_kdf_queue_wait_seconds Espera na fila de KDF.\n"
+                        "# TYPE agle_kdf_queue_wait_seconds histogram\n");
+    metricas_histograma(&t, "agle_kdf_queue_wait_seconds", "", &m->espera_kdf);
+    metricas_printf(&t, "# HELP agle_kdf_duration_seconds Tempo de execução de uma tarefa de KDF.\n"
+                        "# TYPE agle_kdf_duration_seconds histogram\n");
+    metricas_histograma(&t, "agle_kdf_duration_seconds", "", &m->duracao_kdf);
+    
+    metricas_printf(&t, "# HELP agle_sessions Sessões na tabela.\n"
+                        "# TYPE agle_sessions gauge\n"
+                        "agle_sessions %zu\n"
+                        "# HELP agle_session_capacity Slots alocados na tabela de sessões.\n"
+                        "# TYPE agle_session_capacity gauge\n"
+                        "agle_session_capacity %zu\n"
+                        "# HELP agle_users Usuários registrados.\n"
+                        "# TYPE agle_users gauge\n"
+                        "agle_users %zu\n"
+                        "# HELP agle_connections Conexões abertas.\n"
+                        "# TYPE agle_connections gauge\n"
+                        "agle_connections %" PRIu64 "\n",
+                    AGLE_SessionStoreCount(sessoes), AGLE_SessionStoreCapacity(sessoes),
+                    AGLE_UserDirCount(usuarios), m->conexoes);
+    
+    metricas_printf(&t, "# HELP agle_rng_requests_total Chamadas aos geradores AGLE das threads.\n"
+                        "# TYPE agle_rng_requests_total counter\n"
+                        "agle_rng_requests_total %" PRIu64 "\n"
+                        "# HELP agle_rng_seeds_total Semeaduras dos geradores (inicial e reseeds).\n"
+                        "# TYPE agle_rng_seeds_total counter\n"
+                        "agle_rng_seeds_total %" PRIu64 "\n",
+                    m->rng_pedidos, m->rng_semeaduras);
+    free(m);
+    
+    if (t.estourou) {
+        free(t.buf);
+        return false;
+    }
+    *saida = t.buf;
+    *len = t.len;
+    return true;
+}
+
+// O texto passa de TAM_SAIDA: vai como anexo da conexão, liberado após o envio
+static void rota_metricas(Conexao *conn, const Requisicao *req) {
+    (void)req;
+    expirar_sessoes(time(NULL));
+    char *texto;
+    size_t len;
+    if (!gerar_metricas(&texto, &len)) {
+        RESPONDER(conn, 500, "{\"error\":\"Falha ao gerar métricas\"}");
+        return;
+    }
+    conn->anexo = texto;
+    responder_bloco(conn, &BLOCO_METRICAS, texto, len, false);
+}
+
+static void rota_raiz(Conexao *conn, const Requisicao *req) {
+    (void)req;
+    RESPONDER(conn, 200,
+        "{\"status\":\"online\",\"message\":\"Servidor de Autenticação AGLE\"}");
+}
+
+static void rota_favicon(Conexao *conn, const Requisicao *req) {
+    // Ignorar favicon (não é erro)
+    (void)req;
+    RESPONDER(conn, 404, "{\"error\":\"Not found\"}");
+}
+
+typedef void (*TratadorRota)(Conexao *conn, const Requisicao *req);
+
+typedef struct {
+    const char *caminho;
+    size_t len;
+    TratadorRota tratar;
+} Rota;
+
+#define ROTA(c, f) { c, sizeof(c) - 1, f }
+
+static const Rota ROTAS[] = {
+    ROTA("/register", rota_register),
+    ROTA("/login", rota_login),
+    ROTA("/validate", rota_validate),
+    ROTA("/validate/batch", rota_validate_lote),
+    ROTA("/logout", rota_logout),
+    ROTA("/stats", rota_stats),
+    ROTA("/metrics", rota_metricas),
+    ROTA("/", rota_raiz),
+    ROTA("/favicon.ico", rota_favicon),
+};
+
+#define NUM_ROTAS (sizeof(ROTAS) / sizeof(ROTAS[0]))
+#define SLOTS_ROTAS 32   // Potência de 2, bem acima de NUM_ROTAS
+
+// Tabela hash (FNV-1a) montada uma vez: cada busca é um hash + um memcmp
+static const Rota *tabela_rotas[SLOTS_ROTAS];
+
+static uint32_t hash_caminho(const char *p, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)p[i]) * 16777619u;
+    }
+    return h;
+}
+
+static void iniciar_rotas(void) {
+    if (NUM_ROTAS >= ENDPOINTS_METRICA) {
+        fprintf(stderr, "❌ Aumente ENDPOINTS_METRICA (%zu rotas)\n", NUM_ROTAS);
+        exit(1);
+    }
+    nomes_endpoint[ENDPOINT_OUTROS] = "other";
+    for (size_t i = 0; i < NUM_ROTAS; i++) {
+        nomes_endpoint[i] = ROTAS[i].caminho;
+        uint32_t slot = hash_caminho(ROTAS[i].caminho, ROTAS[i].len) & (SLOTS_ROTAS - 1);
+        while (tabela_rotas[slot] != NULL) slot = (slot + 1) & (SLOTS_ROTAS - 1);
+        tabela_rotas[slot] = &ROTAS[i];
+    }
+}
+
+static const Rota *buscar_rota(Fatia caminho) {
+    uint32_t slot = hash_caminho(caminho.ptr, caminho.len) & (SLOTS_ROTAS - 1);
+    while (tabela_rotas[slot] != NULL) {
+        const Rota *r = tabela_rotas[slot];
+        if (r->len == caminho.len && memcmp(r->caminho, caminho.ptr, caminho.len) == 0) {
+            return r;
+        }
+        slot = (slot + 1) & (SLOTS_ROTAS - 1);
+    }
+    return NULL;
+}
+
+void processar_requisicao(Conexao *conn, const Requisicao *req) {
+    conn->inicio_us = agora_us();
+    
+    // Método e caminho são contíguos na linha de requisição
+    registrar_log(LOG_REQUISICAO, req->metodo.ptr,
+                  (size_t)(req->caminho.ptr + req->caminho.len - req->metodo.ptr), 0, 0);
+    
+    int endpoint = ENDPOINT_OUTROS;
+    const Rota *rota;
+    if (fatia_igual_ci(req->metodo, "OPTIONS", 7)) {
+        // OPTIONS (CORS preflight)
+        RESPONDER(conn, 200, "{}");
+    } else if ((rota = buscar_rota(req->caminho)) != NULL) {
+        endpoint = (int)(rota - ROTAS);
+        rota->tratar(conn, req);
+    } else {
+        // 404 - Rota não encontrada
+        RESPONDER(conn, 400, "{\"error\":\"Rota não encontrada\"}");
+    }
+    
+    if (conn->aguardando_kdf) {
+        conn->endpoint = endpoint;  // Medida quando o trabalhador concluir
+        return;
+    }
+    metricas_requisicao(endpoint, conn->ultimo_status, agora_us() - conn->inicio_us);
+}
+
+// ═══════════════════════════════════════════════════════════
+//                    LOOP DE EVENTOS (epoll)
+// ═══════════════════════════════════════════════════════════
+
+// Lista por atividade: a cabeça é sempre a próxima a expirar
+static void lista_remover(LoopEventos *loop, Conexao *conn) {
+    if (conn->ant) conn->ant->prox = conn->prox;
+    else loop->mais_antiga = conn->prox;
+    if (conn->prox) conn->prox->ant = conn->ant;
+    else loop->mais_recente = conn->ant;
+    conn->ant = conn->prox = NULL;
+}
+
+static void lista_inserir_fim(LoopEventos *loop, Conexao *conn) {
+    conn->prox = NULL;
+    conn->ant = loop->mais_recente;
+    if (loop->mais_recente) loop->mais_recente->prox = conn;
+    else loop->mais_antiga = conn;
+    loop->mais_recente = conn;
+}
+
+static void conexao_tocar(LoopEventos *loop, Conexao *conn, uint64_t agora) {
+    conn->ultima_atividade_ms = agora;
+    if (loop->mais_recente != conn) {
+        lista_remover(loop, conn);
+        lista_inserir_fim(loop, conn);
+    }
+}
+
+static void conexao_fechar(LoopEventos *loop, Conexao *conn) {
+    lista_remover(loop, conn);
+    close(conn->fd);  // Fechar também remove o fd do epoll
+    loop->conexoes_ativas--;
+    __atomic_store_n(&metricas_atual->conexoes, loop->conexoes_ativas, __ATOMIC_RELAXED);
+    free(conn->anexo);
+    conn->anexo = NULL;
+    if (conn->aguardando_kdf) {
+        // Um trabalhador ainda aponta para ela: liberada na conclusão
+        conn->fechada = true;
+        return;
+    }
+    free(conn);
+}
+
+// Envia o que for possível; false se a conexão deve ser fechada
+static bool conexao_escrever(Conexao *conn) {
+    while (conn->iov_ini < conn->iov_fim) {
+        // Todas as respostas do pipeline num único sendmsg
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = conn->iov + conn->iov_ini;
+        msg.msg_iovlen = (size_t)(conn->iov_fim - conn->iov_ini);
+        
+        ssize_t n = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+            return false;
+        }
+        
+        // Envio parcial: descarta os trechos completos e ajusta o primeiro restante
+        size_t enviado = (size_t)n;
+        while (conn->iov_ini < conn->iov_fim && enviado >= conn->iov[conn->iov_ini].iov_len) {
+            enviado -= conn->iov[conn->iov_ini].iov_len;
+            conn->iov_ini++;
+        }
+        if (enviado > 0) {
+            struct iovec *v = &conn->iov[conn->iov_ini];
+            v->iov_base = (char *)v->iov_base + enviado;
+            v->iov_len -= enviado;
+        }
+    }
+    conn->iov_ini = conn->iov_fim = 0;
+    conn->saida_len = 0;
+    free(conn->anexo);
+    conn->anexo = NULL;
+    return true;
+}
+
+// Lê até EAGAIN ou buffer cheio (edge-triggered); false em erro de socket
+static bool conexao_ler(Conexao *conn) {
+    // Compacta: move a requisição parcial para o início do buffer
+    if (conn->entrada_ini > 0 && conn->entrada_fim == TAM_ENTRADA) {
+        size_t resto = conn->entrada_fim - conn->entrada_ini;
+        memmove(conn->entrada, conn->entrada + conn->entrada_ini, resto);
+        conn->varrido -= conn->entrada_ini;
+        conn->entrada_ini = 0;
+        conn->entrada_fim = resto;
+    }
+
+    while (conn->entrada_fim < TAM_ENTRADA) {
+        ssize_t n = recv(conn->fd, conn->entrada + conn->entrada_fim,
+                         TAM_ENTRADA - conn->entrada_fim, 0);
+        if (n > 0) {
+            conn->entrada_fim += (size_t)n;
+            continue;
+        }
+        if (n == 0) {
+            // Cliente fechou o lado de escrita: ainda pode aguardar respostas
+            conn->fim_entrada = true;
+            conn->pode_ler = false;
+            return true;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            conn->pode_ler = false;
+            return true;
+        }
+        return false;
+    }
+    return true;  // Buffer cheio: pode_ler continua true
+}
+
+// Processa as requisições completas em pipeline; retorna quantas
+static int conexao_processar(Conexao *conn) {
+    int processadas = 0;
+
+    while (!conn->fechar_apos_envio && !conn->aguardando_kdf && conn->anexo == NULL &&
+           TAM_SAIDA - conn->saida_len >= TAM_RESPOSTA_MAX &&
+           conn->iov_fim + IOV_POR_RESPOSTA <= MAX_IOV) {
+        Requisicao req;
+        ResultadoParse r = http_analisar(conn, &req);
+
+        if (r == PARSE_INCOMPLETO) break;
+        if (r != PARSE_OK) {
+            conn->fechar_apos_envio = true;
+            metricas_status(ENDPOINT_OUTROS, r == PARSE_GRANDE ? 413 : 400);
+            if (r == PARSE_GRANDE) {
+                RESPONDER(conn, 413, "{\"error\":\"Requisição muito grande\"}");
+            } else {
+                RESPONDER(conn, 400, "{\"error\":\"Requisição malformada\"}");
+            }
+            break;
+        }
+
+        if (!req.manter_conexao) conn->fechar_apos_envio = true;
+        processar_requisicao(conn, &req);
+        processadas++;
+
+        conn->entrada_ini += req.tamanho;
+        conn->varrido = conn->entrada_ini;
+        if (conn->entrada_ini == conn->entrada_fim) {
+            conn->entrada_ini = conn->entrada_fim = conn->varrido = 0;
+        }
+    }
+    return processadas;
+}
+
+/*
+ * Avança a conexão o máximo possível: ler, processar em pipeline, escrever.
+ * Repete enquanto houver progresso, já que com edge-triggered não haverá
+ * novo evento para dados que já estão no buffer.
+ */
+static void conexao_trabalhar(LoopEventos *loop, Conexao *conn) {
+    for (;;) {
+        bool leu = false;
+        if (conn->pode_ler && conn->entrada_fim - conn->entrada_ini < TAM_ENTRADA) {
+            size_t antes = conn->entrada_fim - conn->entrada_ini;
+            if (!conexao_ler(conn)) {
+                conexao_fechar(loop, conn);
+                return;
+            }
+            leu = (conn->entrada_fim - conn->entrada_ini) != antes;
+        }
+
+        int processadas = conexao_processar(conn);
+
+        if (!conexao_escrever(conn)) {
+            conexao_fechar(loop, conn);
+            return;
+        }
+        if (conn->iov_fim > 0) return;  // Aguardando EPOLLOUT
+        if (conn->aguardando_kdf) return;  // Retomada por receber_concluidas()
+
+        if (conn->fechar_apos_envio) {
+            conexao_fechar(loop, conn);
+            return;
+        }
+        if (processadas == 0 && !leu) {
+            // Sem progresso possível: fim de entrada sem requisição completa fecha
+            if (conn->fim_entrada) conexao_fechar(loop, conn);
+            return;
+        }
+    }
+}
+
+static void conexao_evento(LoopEventos *loop, Conexao *conn, uint32_t eventos) {
+    if (eventos & EPOLLERR) {
+        conexao_fechar(loop, conn);
+        return;
+    }
+    if (eventos & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) {
+        conn->pode_ler = true;
+    }
+
+    conexao_tocar(loop, conn, loop->agora_ms);
+    conexao_trabalhar(loop, conn);
+}
+
+// Respostas prontas dos trabalhadores de KDF, entregues na ordem de conclusão
+static void receber_concluidas(LoopEventos *loop) {
+    uint64_t avisos;
+    while (read(loop->evento_fd, &avisos, sizeof(avisos)) < 0 && errno == EINTR) {}
     
-    // Criar socket
-    server_socket = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_socket < 0) {
+    // Esvazia a pilha de uma vez e inverte (LIFO → FIFO)
+    TarefaKdf *pilha = __atomic_exchange_n(&loop->concluidas, NULL, __ATOMIC_ACQUIRE);
+    TarefaKdf *fila = NULL;
+    while (pilha != NULL) {
+        TarefaKdf *prox = pilha->prox;
+        pilha->prox = fila;
+        fila = pilha;
+        pilha = prox;
+    }
+    
+    uint64_t agora = loop->agora_ms;
+    while (fila != NULL) {
+        TarefaKdf *t = fila;
+        fila = t->prox;
+        
+        Conexao *conn = t->conn;
+        conn->aguardando_kdf = false;
+        if (conn->fechada) {
+            free(conn);
+        } else {
+            responder_corpo(conn, t->status, &t->corpo);
+            metricas_requisicao(conn->endpoint, conn->ultimo_status, agora_us() - conn->inicio_us);
+            conexao_tocar(loop, conn, agora);
+            conexao_trabalhar(loop, conn);  // Escreve e retoma o pipeline
+        }
+        AGLE_SecureZero(t, sizeof(TarefaKdf));
+        free(t);
+    }
+}
+
+static void aceitar_conexoes(LoopEventos *loop) {
+    for (;;) {
+        struct sockaddr_in endereco;
+        socklen_t endereco_len = sizeof(endereco);
+        int fd = accept4(loop->listen_fd, (struct sockaddr *)&endereco, &endereco_len,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            // EAGAIN: fila vazia; EMFILE/ENFILE etc: tenta no próximo evento
+            return;
+        }
+
+        Conexao *conn = calloc(1, sizeof(Conexao));
+        if (conn == NULL) {
+            close(fd);
+            continue;
+        }
+        conn->fd = fd;
+        conn->ip = endereco.sin_addr.s_addr;
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = conn;
+        if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            free(conn);
+            continue;
+        }
+
+        conn->ultima_atividade_ms = loop->agora_ms;
+        lista_inserir_fim(loop, conn);
+        loop->conexoes_ativas++;
+        __atomic_store_n(&metricas_atual->conexoes, loop->conexoes_ativas, __ATOMIC_RELAXED);
+    }
+}
+
+static void expirar_conexoes(LoopEventos *loop, uint64_t agora) {
+    while (loop->mais_antiga &&
+           agora - loop->mais_antiga->ultima_atividade_ms >= TIMEOUT_CONEXAO_MS) {
+        conexao_fechar(loop, loop->mais_antiga);
+    }
+}
+
+static int criar_socket_escuta(void) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
         perror("❌ Erro ao criar socket");
         exit(1);
     }
     
-    // Permitir reutilização de porta
+    // Permitir reutilização de porta; SO_REUSEPORT: um socket por thread,
+    // o kernel distribui as conexões entre eles
     int opt = 1;
-    setsockopt(server_socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        perror("❌ Erro no SO_REUSEPORT");
+        exit(1);
+    }
     
     // Configurar endereço
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
     server_addr.sin_addr.s_addr = INADDR_ANY;
     server_addr.sin_port = htons(PORT);
     
     // Bind
-    if (bind(server_socket, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+    if (bind(fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
         perror("❌ Erro no bind");
         exit(1);
     }
     
     // Listen
-    if (listen(server_socket, 10) < 0) {
+    if (listen(fd, SOMAXCONN) < 0) {
         perror("❌ Erro no listen");
         exit(1);
     }
+    return fd;
+}
+
+static void executar_loop(LoopEventos *loop) {
+    struct epoll_event eventos[MAX_EVENTOS];
+    uint64_t ultima_varredura = agora_ms();
+    uint64_t ultima_limpeza = ultima_varredura;
+
+    while (1) {
+        int n = epoll_wait(loop->epoll_fd, eventos, MAX_EVENTOS, TICK_MS);
+        if (n < 0 && errno != EINTR) {
+            perror("❌ Erro no epoll_wait");
+            break;
+        }
+        loop->agora_ms = agora_ms();
+
+        bool concluidas = false;
+        for (int i = 0; i < n; i++) {
+            if (eventos[i].data.ptr == &parada_fd) {
+                return;
+            } else if (eventos[i].data.ptr == NULL) {
+                aceitar_conexoes(loop);
+            } else if (eventos[i].data.ptr == loop) {
+                concluidas = true;
+            } else {
+                conexao_evento(loop, eventos[i].data.ptr, eventos[i].events);
+            }
+        }
+        // Depois do lote: uma conclusão pode fechar conexões com eventos nele
+        if (concluidas) {
+            receber_concluidas(loop);
+        }
+
+        uint64_t agora = loop->agora_ms;
+        if (agora - ultima_varredura >= TICK_MS / 4) {
+            expirar_conexoes(loop, agora);
+            ultima_varredura = agora;
+            
+            // Uma thread basta para a roda de sessões (compartilhada)
+            if (loop->id == 0) {
+                expirar_sessoes(time(NULL));
+            }
+            if (loop->id == 0 && assinador != NULL &&
+                agora - ultima_limpeza >= LIMPEZA_REVOGADOS_MS) {
+                AGLE_TokenPurgeRevoked(assinador, (int64_t)time(NULL));
+                ultima_limpeza = agora;
+            }
+        }
+    }
+}
+
+// ═══════════════════════════════════════════════════════════
+//                    SERVIDOR HTTP
+// ═══════════════════════════════════════════════════════════
+
+static void preparar_loop(LoopEventos *loop, int id) {
+    memset(loop, 0, sizeof(*loop));
+    loop->id = id;
+    loop->metricas = novo_bloco_metricas((size_t)id);
+
+    if (!AGLE_Init(&loop->ctx)) {
+        fprintf(stderr, "❌ Erro ao inicializar AGLE!\n");
+        exit(1);
+    }
+
+    loop->listen_fd = criar_socket_escuta();
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epoll_fd < 0) {
+        perror("❌ Erro no epoll_create1");
+        exit(1);
+    }
+
+    // data.ptr == NULL identifica o socket de escuta
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->listen_fd, &ev) < 0) {
+        perror("❌ Erro no epoll_ctl");
+        exit(1);
+    }
+
+    // data.ptr == loop identifica o eventfd das conclusões de KDF
+    loop->evento_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = loop;
+    if (loop->evento_fd < 0 ||
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->evento_fd, &ev) < 0) {
+        perror("❌ Erro no eventfd");
+        exit(1);
+    }
+
+    // data.ptr == &parada_fd identifica o pedido de parada
+    ev.events = EPOLLIN;
+    ev.data.ptr = &parada_fd;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, parada_fd, &ev) < 0) {
+        perror("❌ Erro no epoll_ctl");
+        exit(1);
+    }
+}
+
+// Só write(), que é seguro em handler de sinal; os loops fazem o resto
+static void pedir_parada(int sinal) {
+    (void)sinal;
+    int erro = errno;
+    uint64_t um = 1;
+    ssize_t r = write(parada_fd, &um, sizeof(um));
+    (void)r;
+    errno = erro;
+}
+
+static void *thread_loop(void *arg) {
+    LoopEventos *loop = arg;
+    loop_atual = loop;
+    gerador_atual = &loop->ctx;
+    metricas_atual = loop->metricas;
+    executar_loop(loop);
+    return NULL;
+}
+
+/*
+ * Chave dos tokens assinados: AGLE_CHAVE_TOKEN (hex, 16-64 bytes) para que
+ * vários nós validem os tokens uns dos outros; sem ela, chave aleatória
+ * deste processo (tokens deixam de valer ao reiniciar).
+ */
+static AGLE_TOKEN_SIGNER *criar_assinador(void) {
+    const char *hex = getenv("AGLE_CHAVE_TOKEN");
+    if (hex == NULL) {
+        return AGLE_TokenSignerNew(1, NULL, 0);
+    }
+    uint8_t chave[64];
+    int n = strlen(hex) <= 2 * sizeof(chave) ? AGLE_HexToBytes(hex, chave, sizeof(chave)) : -1;
+    AGLE_TOKEN_SIGNER *a = n > 0 ? AGLE_TokenSignerNew(1, chave, (size_t)n) : NULL;
+    AGLE_SecureZero(chave, sizeof(chave));
+    return a;
+}
+
+void iniciar_servidor(int num_threads, int num_kdf, const char *dados, bool sem_estado) {
+    static LoopEventos loops[MAX_THREADS];
+
+    iniciar_rotas();
+    
+    sessoes = AGLE_SessionStoreNew(SESSOES_ESPERADAS);
+    usuarios = AGLE_UserDirNew(USUARIOS_ESPERADOS);
+    limite_ip = AGLE_RateLimiterNew(BALDES_LIMITE, TAXA_IP_POR_S, RAJADA_IP);
+    limite_subrede = AGLE_RateLimiterNew(BALDES_LIMITE, TAXA_SUBREDE_POR_S, RAJADA_SUBREDE);
+    if (sessoes == NULL || usuarios == NULL || limite_ip == NULL || limite_subrede == NULL) {
+        fprintf(stderr, "❌ Erro ao criar tabelas de sessões/usuários/limites\n");
+        exit(1);
+    }
+    if (sem_estado) {
+        assinador = criar_assinador();
+        if (assinador == NULL) {
+            fprintf(stderr, "❌ AGLE_CHAVE_TOKEN inválida (hex de 16 a 64 bytes)\n");
+            exit(1);
+        }
+    }
+    
+    // Restaura snapshot + log antes de aceitar conexões
+    if (dados != NULL) {
+        struct timespec ini, fim;
+        clock_gettime(CLOCK_MONOTONIC, &ini);
+        persistencia = AGLE_PersistOpen(dados, usuarios, sessoes, (int64_t)time(NULL));
+        if (persistencia == NULL) {
+            fprintf(stderr, "❌ Erro ao abrir dados persistentes em %s\n", dados);
+            exit(1);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &fim);
+        printf("💾 Restaurados %zu usuários e %zu sessões de %s em %.1f ms\n",
+               AGLE_UserDirCount(usuarios), AGLE_SessionStoreCount(sessoes), dados,
+               (double)(fim.tv_sec - ini.tv_sec) * 1e3 + (double)(fim.tv_nsec - ini.tv_nsec) / 1e6);
+    }
+
+    parada_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (parada_fd < 0) {
+        perror("❌ Erro no eventfd");
+        exit(1);
+    }
+
+    // Todos os sockets são criados antes do banner: erro de bind aborta cedo
+    for (int i = 0; i < num_threads; i++) {
+        preparar_loop(&loops[i], i);
+    }
+    iniciar_pool_kdf(num_kdf);
     
     printf("\n");
     printf("╔═══════════════════════════════════════════════════════════╗\n");
     printf("║      🔐 SERVIDOR DE AUTENTICAÇÃO SEGURA ATIVO! 🔐       ║\n");
     printf("╚═══════════════════════════════════════════════════════════╝\n");
     printf("\n");
-    printf("🌐 Servidor rodando em: http://localhost:%d\n", PORT);
+    printf("🌐 Servidor rodando em: http://localhost:%d (%d thread%s, %d de KDF)\n",
+           PORT, num_threads, num_threads > 1 ? "s" : "", num_kdf);
+    if (assinador != NULL) {
+        printf("🔏 Tokens assinados (KMAC256): validação sem consulta à tabela, chave %s\n",
+               getenv("AGLE_CHAVE_TOKEN") != NULL ? "de AGLE_CHAVE_TOKEN" : "aleatória");
+    }
     printf("\n");
     printf("📡 ENDPOINTS DISPONÍVEIS:\n");
     printf("   POST /register  - Registrar novo usuário\n");
     printf("   POST /login     - Fazer login e obter token\n");
     printf("   GET  /validate  - Validar token (header Authorization)\n");
+    printf("   POST /validate/batch - Validar vários tokens de uma vez\n");
     printf("   POST /logout    - Encerrar sessão\n");
     printf("   GET  /stats     - Estatísticas do servidor\n");
+    printf("   GET  /metrics   - Métricas no formato Prometheus\n");
     printf("\n");
     printf("💡 Abra cliente_auth.html no navegador para usar!\n");
     printf("   Ou use: firefox cliente_auth.html\n");
     printf("\n");
     printf("⏹️  Pressione Ctrl+C para parar o servidor\n");
     printf("═══════════════════════════════════════════════════════════\n\n");
+    fflush(stdout);
     
-    // Loop principal
-    while (1) {
-        client_socket = accept(server_socket, (struct sockaddr*)&client_addr, &client_len);
-        if (client_socket < 0) {
-            continue;
+    // Daqui em diante stdout é escrito só pela thread de log
+    iniciar_log();
+    
+    // Ctrl+C ou SIGTERM: os loops saem e a limpeza abaixo esvazia o log em disco
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = pedir_parada;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    
+    // Threads 1..N-1 em paralelo; a thread principal executa o loop 0
+    for (int i = 1; i < num_threads; i++) {
+        if (pthread_create(&loops[i].thread, NULL, thread_loop, &loops[i]) != 0) {
+            perror("❌ Erro ao criar thread");
+            exit(1);
         }
-        
-        // Ler requisição
-        memset(buffer, 0, sizeof(buffer));
-        ssize_t bytes_read = read(client_socket, buffer, sizeof(buffer) - 1);
-        if (bytes_read < 0) continue;
-        
-        // Processar
-        processar_requisicao(client_socket, buffer);
-        
-        // Fechar conexão
-        close(client_socket);
+    }
+    thread_loop(&loops[0]);
+    for (int i = 1; i < num_threads; i++) {
+        pthread_join(loops[i].thread, NULL);
     }
     
-    close(server_socket);
+    // Trabalhadores antes dos eventfds (concluir_tarefa escreve neles) e
+    // antes do log em disco (um registro em curso ainda grava)
+    parar_pool_kdf();
+    for (int i = 0; i < num_threads; i++) {
+        close(loops[i].epoll_fd);
+        close(loops[i].listen_fd);
+        close(loops[i].evento_fd);
+        AGLE_Cleanup(&loops[i].ctx);
+    }
+    AGLE_PersistClose(persistencia);
+    AGLE_RateLimiterFree(limite_ip);
+    AGLE_RateLimiterFree(limite_subrede);
+    AGLE_TokenSignerFree(assinador);
+    close(parada_fd);
+    log_evento(LOG_SERVIDOR_PARADO, NULL, 0, 0);
+    parar_log();
 }
 
 // ═══════════════════════════════════════════════════════════
 //                         MAIN
 // ═══════════════════════════════════════════════════════════
 
-int main(void) {
-    // Inicializar AGLE
-    if (!AGLE_Init(&ctx)) {
-        fprintf(stderr, "❌ Erro ao inicializar AGLE!\n");
-        return 1;
+// Os testes incluem este arquivo para chegar às funções estáticas
+#ifndef SERVIDOR_SEM_MAIN
+
+static void uso(const char *prog) {
+    fprintf(stderr, "Uso: %s [-t N | --threads N] [-k N | --kdf N] [-d PREFIXO | --dados PREFIXO]\n"
+                    "          [-l NIVEL | --log NIVEL] [-s | --sem-estado]\n", prog);
+    fprintf(stderr, "  -t N        Número de threads (0 = um por núcleo, padrão 1)\n");
+    fprintf(stderr, "  -k N        Trabalhadores de hashing de senha (0 = um por núcleo, padrão)\n");
+    fprintf(stderr, "  -d PREFIXO  Persistir usuários e sessões em PREFIXO.wal / PREFIXO.snap\n");
+    fprintf(stderr, "  -l NIVEL    Nível mínimo de log: debug, info (padrão), aviso, erro\n");
+    fprintf(stderr, "  -s          Tokens assinados com KMAC256, validados sem a tabela de sessões\n"
+                    "              (chave em AGLE_CHAVE_TOKEN, hex; aleatória se ausente)\n");
+}
+
+int main(int argc, char **argv) {
+    int num_threads = 1;
+    int num_kdf = 0;
+    const char *dados = NULL;
+    bool sem_estado = false;
+    
+    for (int i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--threads") == 0) &&
+            i + 1 < argc) {
+            num_threads = atoi(argv[++i]);
+        } else if ((strcmp(argv[i], "-k") == 0 || strcmp(argv[i], "--kdf") == 0) &&
+                   i + 1 < argc) {
+            num_kdf = atoi(argv[++i]);
+        } else if ((strcmp(argv[i], "-d") == 0 || strcmp(argv[i], "--dados") == 0) &&
+                   i + 1 < argc) {
+            dados = argv[++i];
+        } else if ((strcmp(argv[i], "-l") == 0 || strcmp(argv[i], "--log") == 0) &&
+                   i + 1 < argc) {
+            static const char *const niveis[] = { "debug", "info", "aviso", "erro" };
+            const char *nome = argv[++i];
+            size_t n = 0;
+            while (n < 4 && strcmp(nome, niveis[n]) != 0) n++;
+            if (n == 4) {
+                uso(argv[0]);
+                return 1;
+            }
+            nivel_log = (NivelLog)n;
+        } else if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--sem-estado") == 0) {
+            sem_estado = true;
+        } else {
+            uso(argv[0]);
+            return 1;
+        }
     }
+    if (num_threads <= 0) {
+        num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (num_threads < 1) num_threads = 1;
+    if (num_threads > MAX_THREADS) num_threads = MAX_THREADS;
+    if (num_kdf <= 0) {
+        num_kdf = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (num_kdf < 1) num_kdf = 1;
+    if (num_kdf > MAX_TRABALHADORES_KDF) num_kdf = MAX_TRABALHADORES_KDF;
     
-    // Inicializar servidor
-    iniciar_servidor();
+    // Escrita em socket fechado pelo cliente não deve derrubar o servidor
+    signal(SIGPIPE, SIG_IGN);
     
-    // Cleanup
-    AGLE_Cleanup(&ctx);
+    // Inicializar servidor (cada thread inicializa seu próprio AGLE)
+    iniciar_servidor(num_threads, num_kdf, dados, sem_estado);
     return 0;
 }
+
+#endif
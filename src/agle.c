@@ -3,7 +3,7 @@
  * @brief AGLE implementation.
  */
 
-#include "agle.h"
+#include "agle_internal.h"
 #include <openssl/evp.h>
 #include <openssl/rand.h>
 #include <stdio.h>
@@ -12,8 +12,10 @@
 #include <fcntl.h>
 #include <time.h>
 
-#define URANDOM_PATH "/dev/urandom"
-#define RAW_ENTROPY_CHUNK 4096
+/* Domain separation tags for split generators */
+#define SPLIT_DOMAIN "AGLE-SPLIT-v1"
+#define SPLIT_TAG_STREAM 'G'
+#define SPLIT_TAG_CHILD 'S'
 
 /* ============================================================================
  * Internal Helper Functions
@@ -37,16 +39,50 @@ static const char *WORDLIST[] = {
 
 #define WORDLIST_SIZE (sizeof(WORDLIST) / sizeof(WORDLIST[0]))
 
-static bool _read_urandom(uint8_t *buf, size_t n) {
-    int fd = open(URANDOM_PATH, O_RDONLY);
-    if (fd < 0) {
-        perror("open /dev/urandom");
+static bool _ctx_seed(AGLE_CTX *ctx) {
+    const agle_backend *be = agle_backend_get(ctx->backend);
+    uint8_t seed[AGLE_STATE_SIZE];
+
+    if (be == NULL || !agle_entropy_read(ctx, seed, be->seed_len)) {
         return false;
     }
 
-    ssize_t rd = read(fd, buf, n);
-    close(fd);
-    return (rd == (ssize_t)n);
+    bool result = (ctx->flags & AGLE_CTX_SEEDED) ?
+                  be->reseed(ctx, seed) : be->instantiate(ctx, seed);
+    AGLE_SecureZero(seed, sizeof(seed));
+    if (!result) return false;
+
+    ctx->flags |= AGLE_CTX_SEEDED;
+    ctx->reseed_counter = 0;
+    ctx->seed_counter++;
+    return true;
+}
+
+static inline bool _ctx_ready(AGLE_CTX *ctx) {
+    if (ctx->flags & AGLE_CTX_HEALTH_FAILED) return false;
+    return (ctx->flags & AGLE_CTX_SEEDED) || _ctx_seed(ctx);
+}
+
+/* out = SHAKE256(SPLIT_DOMAIN || tag || key || le64(counter)) */
+static bool _split_derive(const uint8_t *key, size_t key_len, uint8_t tag,
+                          uint64_t counter, uint8_t *out, size_t out_len) {
+    uint8_t ctr[8];
+    for (int i = 0; i < 8; i++) {
+        ctr[i] = (uint8_t)(counter >> (8 * i));
+    }
+
+    EVP_MD_CTX *mctx = EVP_MD_CTX_new();
+    if (mctx == NULL) return false;
+
+    bool result = EVP_DigestInit_ex(mctx, agle_shake256_md(), NULL) &&
+                  EVP_DigestUpdate(mctx, SPLIT_DOMAIN, sizeof(SPLIT_DOMAIN) - 1) &&
+                  EVP_DigestUpdate(mctx, &tag, 1) &&
+                  EVP_DigestUpdate(mctx, key, key_len) &&
+                  EVP_DigestUpdate(mctx, ctr, sizeof(ctr)) &&
+                  EVP_DigestFinalXOF(mctx, out, out_len);
+
+    EVP_MD_CTX_free(mctx);
+    return result;
 }
 
 /* ============================================================================
@@ -54,50 +90,66 @@ static bool _read_urandom(uint8_t *buf, size_t n) {
  * ============================================================================ */
 
 bool AGLE_Init(AGLE_CTX *ctx) {
+    return AGLE_InitEx(ctx, NULL);
+}
+
+bool AGLE_InitEx(AGLE_CTX *ctx, const AGLE_InitOptions *opts) {
     if (ctx == NULL) return false;
 
     memset(ctx, 0, sizeof(AGLE_CTX));
-    
-    if (!_read_urandom(ctx->state, sizeof(ctx->state))) {
+    ctx->init_flags = (opts != NULL) ? opts->flags : AGLE_INIT_DEFAULT;
+    ctx->backend = (opts != NULL) ? opts->backend : AGLE_BACKEND_SHAKE256;
+
+    if (agle_backend_get(ctx->backend) == NULL) {
         return false;
     }
-    
-    if (!_read_urandom(ctx->entropy_pool, sizeof(ctx->entropy_pool))) {
-        return false;
+
+    if (opts != NULL && opts->seed != NULL) {
+        if (!agle_entropy_set_seed(ctx, opts->seed, opts->seed_len)) {
+            return false;
+        }
     }
 
-    ctx->position = 0;
-    return true;
+    if (ctx->init_flags & AGLE_INIT_LAZY) {
+        return true;
+    }
+    return _ctx_seed(ctx);
+}
+
+bool AGLE_InitSeeded(AGLE_CTX *ctx, const uint8_t *seed, size_t seed_len) {
+    AGLE_InitOptions opts = {0};
+    opts.seed = seed;
+    opts.seed_len = seed_len;
+    return AGLE_InitEx(ctx, &opts);
+}
+
+bool AGLE_IsHealthy(const AGLE_CTX *ctx) {
+    return ctx != NULL && (ctx->flags & AGLE_CTX_HEALTH_FAILED) == 0;
 }
 
 bool AGLE_GetRandomBytes(AGLE_CTX *ctx, uint8_t *out, size_t n) {
     if (ctx == NULL || out == NULL || n == 0) return false;
+    if (!_ctx_ready(ctx)) return false;
 
-    uint8_t raw_buf[RAW_ENTROPY_CHUNK];
-    size_t produced = 0;
+    const agle_backend *be = agle_backend_get(ctx->backend);
+    if (be == NULL) return false;
 
+    size_t produced = 0;
     while (produced < n) {
-        if (!_read_urandom(raw_buf, RAW_ENTROPY_CHUNK)) {
-            return false;
+        if (be->reseed_interval != 0 && ctx->reseed_counter >= be->reseed_interval) {
+            if (!_ctx_seed(ctx)) return false;
         }
 
-        EVP_MD_CTX *mctx = EVP_MD_CTX_new();
-        if (mctx == NULL) return false;
-
-        EVP_DigestInit(mctx, EVP_shake256());
-        EVP_DigestUpdate(mctx, raw_buf, RAW_ENTROPY_CHUNK);
-        EVP_DigestUpdate(mctx, ctx->state, sizeof(ctx->state));
-
-        size_t to_squeeze = (n - produced) > RAW_ENTROPY_CHUNK ? 
-                            RAW_ENTROPY_CHUNK : (n - produced);
-        
-        EVP_DigestFinalXOF(mctx, out + produced, to_squeeze);
-        EVP_MD_CTX_free(mctx);
+        size_t chunk = (n - produced) > be->max_request ?
+                       be->max_request : (n - produced);
+        if (!be->generate(ctx, out + produced, chunk)) {
+            return false;
+        }
 
-        produced += to_squeeze;
+        ctx->reseed_counter++;
+        produced += chunk;
     }
 
-    AGLE_SecureZero(raw_buf, sizeof(raw_buf));
     return true;
 }
 
@@ -123,6 +175,59 @@ void AGLE_Cleanup(AGLE_CTX *ctx) {
     AGLE_SecureZero(ctx, sizeof(AGLE_CTX));
 }
 
+/* ============================================================================
+ * Splittable Generators
+ * ============================================================================ */
+
+bool AGLE_Split(AGLE_CTX *parent, AGLE_SPLIT_CTX *child) {
+    if (parent == NULL || child == NULL) return false;
+    if (!_ctx_ready(parent)) return false;
+
+    if (!_split_derive(parent->state, sizeof(parent->state), SPLIT_TAG_CHILD,
+                       parent->split_counter, child->key, sizeof(child->key))) {
+        return false;
+    }
+
+    parent->split_counter++;
+    child->counter = 0;
+    return true;
+}
+
+bool AGLE_SplitChild(AGLE_SPLIT_CTX *parent, AGLE_SPLIT_CTX *child) {
+    if (parent == NULL || child == NULL || parent == child) return false;
+
+    if (!_split_derive(parent->key, sizeof(parent->key), SPLIT_TAG_CHILD,
+                       parent->counter, child->key, sizeof(child->key))) {
+        return false;
+    }
+
+    parent->counter++;
+    child->counter = 0;
+    return true;
+}
+
+bool AGLE_SplitGetRandomBytes(AGLE_SPLIT_CTX *ctx, uint8_t *out, size_t n) {
+    if (ctx == NULL || out == NULL || n == 0) return false;
+
+    if (!_split_derive(ctx->key, sizeof(ctx->key), SPLIT_TAG_STREAM,
+                       ctx->counter, out, n)) {
+        return false;
+    }
+
+    ctx->counter++;
+    return true;
+}
+
+bool AGLE_SplitGetRandom64(AGLE_SPLIT_CTX *ctx, uint64_t *out) {
+    if (ctx == NULL || out == NULL) return false;
+    return AGLE_SplitGetRandomBytes(ctx, (uint8_t *)out, sizeof(uint64_t));
+}
+
+void AGLE_SplitCleanup(AGLE_SPLIT_CTX *ctx) {
+    if (ctx == NULL) return;
+    AGLE_SecureZero(ctx, sizeof(AGLE_SPLIT_CTX));
+}
+
 /* ============================================================================
  * Password Generation
  * ============================================================================ */
@@ -252,20 +357,20 @@ bool AGLE_DeriveKey(const uint8_t *password, size_t password_len,
     memset(temp, 0, key_len);
     memcpy(temp, password, password_len < key_len ? password_len : key_len);
 
-    for (uint32_t i = 0; i < iterations; i++) {
-        EVP_MD_CTX *mctx = EVP_MD_CTX_new();
-        if (mctx == NULL) return false;
-
-        EVP_DigestInit(mctx, EVP_shake256());
-        EVP_DigestUpdate(mctx, temp, key_len);
-        EVP_DigestUpdate(mctx, salt, salt_len);
-        EVP_DigestFinalXOF(mctx, temp, key_len);
-        EVP_MD_CTX_free(mctx);
+    /* One context and one fetched digest for every iteration */
+    EVP_MD_CTX *mctx = EVP_MD_CTX_new();
+    bool result = mctx != NULL;
+    for (uint32_t i = 0; result && i < iterations; i++) {
+        result = EVP_DigestInit_ex(mctx, agle_shake256_md(), NULL) &&
+                 EVP_DigestUpdate(mctx, temp, key_len) &&
+                 EVP_DigestUpdate(mctx, salt, salt_len) &&
+                 EVP_DigestFinalXOF(mctx, temp, key_len);
     }
+    EVP_MD_CTX_free(mctx);
 
-    memcpy(key, temp, key_len);
+    if (result) memcpy(key, temp, key_len);
     AGLE_SecureZero(temp, key_len);
-    return true;
+    return result;
 }
 
 /* ============================================================================
@@ -292,6 +397,48 @@ bool AGLE_GenerateSessionTokenHex(AGLE_CTX *ctx, char *token_hex, size_t token_b
     return result != NULL;
 }
 
+#define CHECKED_PREFIX_LEN (sizeof(AGLE_CHECKED_TOKEN_PREFIX) - 1)
+#define CHECKED_CRC_LEN 8
+
+bool AGLE_GenerateSessionTokenChecked(AGLE_CTX *ctx, char *token, size_t token_bytes) {
+    if (token == NULL || token_bytes < 16 || token_bytes > 512) return false;
+
+    memcpy(token, AGLE_CHECKED_TOKEN_PREFIX, CHECKED_PREFIX_LEN);
+    if (!AGLE_GenerateSessionTokenHex(ctx, token + CHECKED_PREFIX_LEN, token_bytes)) {
+        return false;
+    }
+
+    size_t body = CHECKED_PREFIX_LEN + 2 * token_bytes;
+    uint8_t crc[4];
+    uint32_t c = agle_crc32c(0, token, body);
+    for (int i = 0; i < 4; i++) {
+        crc[i] = (uint8_t)(c >> (24 - 8 * i));
+    }
+    AGLE_BytesToHex(crc, sizeof(crc), token + body);
+    return true;
+}
+
+bool AGLE_CheckSessionToken(const char *token, size_t token_len) {
+    if (token == NULL || token_len < AGLE_CHECKED_TOKEN_LEN(16) ||
+        token_len > AGLE_CHECKED_TOKEN_LEN(512) ||
+        (token_len - CHECKED_PREFIX_LEN - CHECKED_CRC_LEN) % 2 != 0 ||
+        memcmp(token, AGLE_CHECKED_TOKEN_PREFIX, CHECKED_PREFIX_LEN) != 0) {
+        return false;
+    }
+
+    size_t body = token_len - CHECKED_CRC_LEN;
+    uint32_t expected = 0;
+    for (size_t i = body; i < token_len; i++) {
+        char ch = token[i];
+        uint32_t v;
+        if (ch >= '0' && ch <= '9') v = (uint32_t)(ch - '0');
+        else if (ch >= 'a' && ch <= 'f') v = (uint32_t)(ch - 'a' + 10);
+        else return false;
+        expected = (expected << 4) | v;
+    }
+    return agle_crc32c(0, token, body) == expected;
+}
+
 uint64_t AGLE_GenerateNonce(AGLE_CTX *ctx, uint8_t *nonce) {
     if (ctx == NULL || nonce == NULL) return 0;
 
@@ -362,5 +509,13 @@ const char* AGLE_GetVersion(void) {
 const char* AGLE_GetInfo(void) {
     return "AGLE v" AGLE_VERSION " - Alpha-Gauss-Logistic Entropy Generator\n"
            "Features: RNG, Password Generation, SHAKE256 Hashing, KDF, Session Tokens\n"
+           "Backends: SHAKE256 (default), AES-256-CTR-DRBG, ChaCha20\n"
            "License: ASL-1.0 (study-only)";
 }
+
+const char* AGLE_GetContextInfo(const AGLE_CTX *ctx) {
+    if (ctx == NULL) return AGLE_GetInfo();
+
+    const agle_backend *be = agle_backend_get(ctx->backend);
+    return (be != NULL) ? be->info : AGLE_GetInfo();
+}
@@ -0,0 +1,320 @@
+/**
+ * @file agle_backend.c
+ * @brief Generator backends: SHAKE256, AES-256-CTR-DRBG and ChaCha20.
+ *
+ * Primitives come from OpenSSL EVP, which dispatches to AES-NI and to the
+ * AVX2/AVX-512 ChaCha20 kernels at runtime when the CPU supports them.
+ */
+
+#include "agle_internal.h"
+#include <string.h>
+
+#define RAW_ENTROPY_CHUNK 4096
+
+/* SP 800-90A Table 3: max_number_of_bits_per_request = 2^19 */
+#define CTR_DRBG_MAX_REQUEST 65536
+#define CTR_DRBG_KEY_LEN 32
+#define CTR_DRBG_BLOCK_LEN 16
+#define CTR_DRBG_SEED_LEN (CTR_DRBG_KEY_LEN + CTR_DRBG_BLOCK_LEN)
+
+#define CHACHA_KEY_LEN 32
+#define CHACHA_MAX_REQUEST 65536
+
+/* Far below the SP 800-90A limit of 2^48; reseeding is cheap */
+#define AGLE_RESEED_INTERVAL (1ULL << 24)
+
+#define AGLE_INFO_HEADER \
+    "AGLE v" AGLE_VERSION " - Alpha-Gauss-Logistic Entropy Generator\n" \
+    "Features: RNG, Password Generation, SHAKE256 Hashing, KDF, Session Tokens\n"
+#define AGLE_INFO_LICENSE "License: ASL-1.0 (study-only)"
+
+/* ============================================================================
+ * Cached Algorithm Fetches
+ * ============================================================================ */
+
+/*
+ * EVP_shake256() and friends perform an implicit provider fetch on every
+ * init, which dominates the cost of short operations. Fetch once and keep
+ * the first pointer published.
+ */
+const EVP_MD *agle_shake256_md(void) {
+    static EVP_MD *cached = NULL;
+
+    EVP_MD *md = __atomic_load_n(&cached, __ATOMIC_ACQUIRE);
+    if (md != NULL) return md;
+
+    md = EVP_MD_fetch(NULL, "SHAKE256", NULL);
+    if (md == NULL) return EVP_shake256();
+
+    EVP_MD *expected = NULL;
+    if (!__atomic_compare_exchange_n(&cached, &expected, md, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        EVP_MD_free(md);
+        return expected;
+    }
+    return md;
+}
+
+static const EVP_CIPHER *_cached_cipher(EVP_CIPHER **slot, const char *name,
+                                        const EVP_CIPHER *fallback) {
+    EVP_CIPHER *c = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    if (c != NULL) return c;
+
+    c = EVP_CIPHER_fetch(NULL, name, NULL);
+    if (c == NULL) return fallback;
+
+    EVP_CIPHER *expected = NULL;
+    if (!__atomic_compare_exchange_n(slot, &expected, c, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        EVP_CIPHER_free(c);
+        return expected;
+    }
+    return c;
+}
+
+static const EVP_CIPHER *_aes256ctr(void) {
+    static EVP_CIPHER *cached = NULL;
+    return _cached_cipher(&cached, "AES-256-CTR", EVP_aes_256_ctr());
+}
+
+static const EVP_CIPHER *_chacha20(void) {
+    static EVP_CIPHER *cached = NULL;
+    return _cached_cipher(&cached, "ChaCha20", EVP_chacha20());
+}
+
+/* Run the cipher over n zero bytes (keystream) or over in, into out */
+static bool _cipher_stream(EVP_CIPHER_CTX *c, const uint8_t *in,
+                           uint8_t *out, size_t n) {
+    if (in == NULL) {
+        memset(out, 0, n);
+        in = out;
+    }
+    while (n > 0) {
+        int chunk = n > (1 << 30) ? (1 << 30) : (int)n;
+        int outl = 0;
+        if (!EVP_EncryptUpdate(c, out, &outl, in, chunk) || outl != chunk) {
+            return false;
+        }
+        in += chunk;
+        out += chunk;
+        n -= (size_t)chunk;
+    }
+    return true;
+}
+
+/* ============================================================================
+ * SHAKE256 Backend (original behavior)
+ * ============================================================================ */
+
+/*
+ * Every 4 KiB of output is SHAKE256(fresh entropy || state). The state is
+ * the 64-byte seed and never changes; there is nothing to reseed.
+ */
+
+static bool _shake_instantiate(AGLE_CTX *ctx, const uint8_t *seed) {
+    memcpy(ctx->state, seed, AGLE_STATE_SIZE);
+    return true;
+}
+
+static bool _shake_generate(AGLE_CTX *ctx, uint8_t *out, size_t n) {
+    uint8_t raw_buf[RAW_ENTROPY_CHUNK];
+    size_t produced = 0;
+    bool result = true;
+
+    EVP_MD_CTX *mctx = EVP_MD_CTX_new();
+    if (mctx == NULL) return false;
+
+    while (produced < n) {
+        if (!agle_entropy_read(ctx, raw_buf, RAW_ENTROPY_CHUNK)) {
+            result = false;
+            break;
+        }
+
+        size_t to_squeeze = (n - produced) > RAW_ENTROPY_CHUNK ?
+                            RAW_ENTROPY_CHUNK : (n - produced);
+
+        if (!EVP_DigestInit_ex(mctx, agle_shake256_md(), NULL) ||
+            !EVP_DigestUpdate(mctx, raw_buf, RAW_ENTROPY_CHUNK) ||
+            !EVP_DigestUpdate(mctx, ctx->state, AGLE_STATE_SIZE) ||
+            !EVP_DigestFinalXOF(mctx, out + produced, to_squeeze)) {
+            result = false;
+            break;
+        }
+
+        produced += to_squeeze;
+    }
+
+    EVP_MD_CTX_free(mctx);
+    AGLE_SecureZero(raw_buf, sizeof(raw_buf));
+    return result;
+}
+
+/* ============================================================================
+ * AES-256-CTR-DRBG Backend (SP 800-90A, no derivation function)
+ * ============================================================================ */
+
+/*
+ * State layout: Key (32 bytes) || V (16 bytes). CTR_DRBG increments V over
+ * the full block, exactly like the AES-CTR mode counter, so one AES-CTR
+ * pass with IV = V + 1 yields AES(K, V+1) || AES(K, V+2) || ...
+ */
+
+static void _v_plus_one(const uint8_t *v, uint8_t *iv) {
+    unsigned carry = 1;
+    for (int i = CTR_DRBG_BLOCK_LEN - 1; i >= 0; i--) {
+        unsigned sum = v[i] + carry;
+        iv[i] = (uint8_t)sum;
+        carry = sum >> 8;
+    }
+}
+
+static EVP_CIPHER_CTX *_ctr_drbg_begin(const AGLE_CTX *ctx) {
+    uint8_t iv[CTR_DRBG_BLOCK_LEN];
+    _v_plus_one(ctx->state + CTR_DRBG_KEY_LEN, iv);
+
+    EVP_CIPHER_CTX *c = EVP_CIPHER_CTX_new();
+    if (c == NULL) return NULL;
+
+    if (!EVP_EncryptInit_ex(c, _aes256ctr(), NULL, ctx->state, iv)) {
+        EVP_CIPHER_CTX_free(c);
+        return NULL;
+    }
+    return c;
+}
+
+/* CTR_DRBG_Update: (K, V) = leftmost 384 bits of keystream XOR provided */
+static bool _ctr_drbg_update(AGLE_CTX *ctx, EVP_CIPHER_CTX *c,
+                             const uint8_t *provided) {
+    uint8_t temp[CTR_DRBG_SEED_LEN];
+    bool result = _cipher_stream(c, provided, temp, sizeof(temp));
+    if (result) {
+        memcpy(ctx->state, temp, CTR_DRBG_SEED_LEN);
+    }
+    AGLE_SecureZero(temp, sizeof(temp));
+    return result;
+}
+
+static bool _ctr_drbg_reseed(AGLE_CTX *ctx, const uint8_t *seed) {
+    EVP_CIPHER_CTX *c = _ctr_drbg_begin(ctx);
+    if (c == NULL) return false;
+
+    bool result = _ctr_drbg_update(ctx, c, seed);
+    EVP_CIPHER_CTX_free(c);
+    return result;
+}
+
+static bool _ctr_drbg_instantiate(AGLE_CTX *ctx, const uint8_t *seed) {
+    memset(ctx->state, 0, AGLE_STATE_SIZE);
+    return _ctr_drbg_reseed(ctx, seed);
+}
+
+static bool _ctr_drbg_generate(AGLE_CTX *ctx, uint8_t *out, size_t n) {
+    EVP_CIPHER_CTX *c = _ctr_drbg_begin(ctx);
+    if (c == NULL) return false;
+
+    size_t full = n & ~(size_t)(CTR_DRBG_BLOCK_LEN - 1);
+    size_t rem = n - full;
+    bool result = _cipher_stream(c, NULL, out, full);
+
+    if (result && rem > 0) {
+        /* V advances by a whole block even for a partial one */
+        uint8_t block[CTR_DRBG_BLOCK_LEN];
+        result = _cipher_stream(c, NULL, block, sizeof(block));
+        memcpy(out + full, block, rem);
+        AGLE_SecureZero(block, sizeof(block));
+    }
+
+    if (result) {
+        result = _ctr_drbg_update(ctx, c, NULL);
+    }
+
+    EVP_CIPHER_CTX_free(c);
+    return result;
+}
+
+/* ============================================================================
+ * ChaCha20 Backend (fast key erasure)
+ * ============================================================================ */
+
+/*
+ * State: 32-byte key. Each request runs ChaCha20 with a zero nonce; the
+ * first 32 keystream bytes replace the key before the output is returned,
+ * so a later state compromise cannot reveal earlier output.
+ */
+
+static bool _chacha_instantiate(AGLE_CTX *ctx, const uint8_t *seed) {
+    memset(ctx->state, 0, AGLE_STATE_SIZE);
+    memcpy(ctx->state, seed, CHACHA_KEY_LEN);
+    return true;
+}
+
+static bool _chacha_reseed(AGLE_CTX *ctx, const uint8_t *seed) {
+    for (size_t i = 0; i < CHACHA_KEY_LEN; i++) {
+        ctx->state[i] ^= seed[i];
+    }
+    return true;
+}
+
+static bool _chacha_generate(AGLE_CTX *ctx, uint8_t *out, size_t n) {
+    static const uint8_t zero_iv[16] = {0};
+    uint8_t next_key[CHACHA_KEY_LEN];
+
+    EVP_CIPHER_CTX *c = EVP_CIPHER_CTX_new();
+    if (c == NULL) return false;
+
+    bool result = EVP_EncryptInit_ex(c, _chacha20(), NULL, ctx->state, zero_iv) &&
+                  _cipher_stream(c, NULL, next_key, sizeof(next_key)) &&
+                  _cipher_stream(c, NULL, out, n);
+
+    if (result) {
+        memcpy(ctx->state, next_key, CHACHA_KEY_LEN);
+    }
+
+    EVP_CIPHER_CTX_free(c);
+    AGLE_SecureZero(next_key, sizeof(next_key));
+    return result;
+}
+
+/* ============================================================================
+ * Backend Table
+ * ============================================================================ */
+
+static const agle_backend BACKENDS[] = {
+    [AGLE_BACKEND_SHAKE256] = {
+        .name = "SHAKE256",
+        .info = AGLE_INFO_HEADER "Backend: SHAKE256\n" AGLE_INFO_LICENSE,
+        .seed_len = AGLE_STATE_SIZE,
+        .reseed_interval = 0,
+        .max_request = SIZE_MAX,
+        .instantiate = _shake_instantiate,
+        .reseed = _shake_instantiate,
+        .generate = _shake_generate,
+    },
+    [AGLE_BACKEND_AES256_CTR_DRBG] = {
+        .name = "AES-256-CTR-DRBG",
+        .info = AGLE_INFO_HEADER "Backend: AES-256-CTR-DRBG\n" AGLE_INFO_LICENSE,
+        .seed_len = CTR_DRBG_SEED_LEN,
+        .reseed_interval = AGLE_RESEED_INTERVAL,
+        .max_request = CTR_DRBG_MAX_REQUEST,
+        .instantiate = _ctr_drbg_instantiate,
+        .reseed = _ctr_drbg_reseed,
+        .generate = _ctr_drbg_generate,
+    },
+    [AGLE_BACKEND_CHACHA20] = {
+        .name = "ChaCha20",
+        .info = AGLE_INFO_HEADER "Backend: ChaCha20\n" AGLE_INFO_LICENSE,
+        .seed_len = CHACHA_KEY_LEN,
+        .reseed_interval = AGLE_RESEED_INTERVAL,
+        .max_request = CHACHA_MAX_REQUEST,
+        .instantiate = _chacha_instantiate,
+        .reseed = _chacha_reseed,
+        .generate = _chacha_generate,
+    },
+};
+
+#define BACKEND_COUNT (sizeof(BACKENDS) / sizeof(BACKENDS[0]))
+
+const agle_backend *agle_backend_get(uint32_t id) {
+    if (id >= BACKEND_COUNT) return NULL;
+    return &BACKENDS[id];
+}
@@ -0,0 +1,234 @@
+/**
+ * @file agle_entropy.c
+ * @brief Entropy input for seeding and for the SHAKE256 backend.
+ */
+
+#include "agle_internal.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 25))
+#include <sys/random.h>
+#define AGLE_HAVE_GETRANDOM 1
+#else
+#define AGLE_HAVE_GETRANDOM 0
+#endif
+
+#define URANDOM_PATH "/dev/urandom"
+
+/*
+ * SP 800-90B section 4.4 cutoffs for byte samples with a claimed
+ * min-entropy of H = 8 bits and false-positive rate alpha = 2^-40:
+ *   RCT: C = 1 + ceil(40 / 8) = 6
+ *   APT: W = 512, C = 1 + CRITBINOM(512, 2^-8, 1 - 2^-40) = 19
+ * alpha is per sample, so a healthy source still fails a 4 KiB input with
+ * probability about 2^-28 (RCT) - every few minutes for a SHAKE256 context
+ * streaming at GB/s. A failed input is therefore discarded and replaced;
+ * the context only fails closed when HEALTH_MAX_ATTEMPTS inputs in a row
+ * fail (about 2^-84 for a healthy source), which a stuck or heavily
+ * biased source does on its first read.
+ */
+#define HEALTH_RCT_CUTOFF 6
+#define HEALTH_APT_WINDOW 512
+#define HEALTH_APT_CUTOFF 19
+#define HEALTH_MAX_ATTEMPTS 3
+
+/* Domain separation for deterministic mode */
+#define SEED_DOMAIN "AGLE-SEED-v1"
+#define SEEDED_ENTROPY_DOMAIN "AGLE-SEEDED-ENTROPY-v1"
+
+static bool _read_urandom(uint8_t *buf, size_t n) {
+#if AGLE_HAVE_GETRANDOM
+    /* One syscall, no descriptor: keeps short-lived contexts cheap */
+    size_t got = 0;
+    while (got < n) {
+        ssize_t rd = getrandom(buf + got, n - got, 0);
+        if (rd < 0) {
+            if (errno == EINTR) continue;
+            if (errno == ENOSYS) break;
+            perror("getrandom");
+            return false;
+        }
+        got += (size_t)rd;
+    }
+    if (got == n) return true;
+#endif
+
+    int fd = open(URANDOM_PATH, O_RDONLY);
+    if (fd < 0) {
+        perror("open /dev/urandom");
+        return false;
+    }
+
+    ssize_t rd = read(fd, buf, n);
+    close(fd);
+    return (rd == (ssize_t)n);
+}
+
+static bool _shake_parts(const uint8_t *a, size_t a_len,
+                         const uint8_t *b, size_t b_len,
+                         const uint8_t *c, size_t c_len,
+                         uint8_t *out, size_t out_len) {
+    EVP_MD_CTX *mctx = EVP_MD_CTX_new();
+    if (mctx == NULL) return false;
+
+    bool result = EVP_DigestInit_ex(mctx, agle_shake256_md(), NULL) &&
+                  EVP_DigestUpdate(mctx, a, a_len) &&
+                  EVP_DigestUpdate(mctx, b, b_len) &&
+                  EVP_DigestUpdate(mctx, c, c_len) &&
+                  EVP_DigestFinalXOF(mctx, out, out_len);
+
+    EVP_MD_CTX_free(mctx);
+    return result;
+}
+
+/* Block i of deterministic entropy: SHAKE256(domain || seed_key || le64(i)) */
+static bool _read_seeded(AGLE_CTX *ctx, uint8_t *buf, size_t n) {
+    uint8_t ctr[8];
+    for (int i = 0; i < 8; i++) {
+        ctr[i] = (uint8_t)(ctx->entropy_counter >> (8 * i));
+    }
+
+    if (!_shake_parts((const uint8_t *)SEEDED_ENTROPY_DOMAIN,
+                      sizeof(SEEDED_ENTROPY_DOMAIN) - 1,
+                      ctx->seed_key, sizeof(ctx->seed_key),
+                      ctr, sizeof(ctr), buf, n)) {
+        return false;
+    }
+
+    ctx->entropy_counter++;
+    return true;
+}
+
+bool agle_entropy_set_seed(AGLE_CTX *ctx, const uint8_t *seed, size_t seed_len) {
+    if (seed == NULL || seed_len == 0) return false;
+
+    if (!_shake_parts((const uint8_t *)SEED_DOMAIN, sizeof(SEED_DOMAIN) - 1,
+                      seed, seed_len, NULL, 0,
+                      ctx->seed_key, sizeof(ctx->seed_key))) {
+        return false;
+    }
+
+    ctx->entropy_counter = 0;
+    ctx->flags |= AGLE_CTX_DETERMINISTIC;
+    return true;
+}
+
+/* ============================================================================
+ * SP 800-90B Continuous Health Tests
+ * ============================================================================ */
+
+/*
+ * Each entropy input is tested as its own sample sequence. Both tests run
+ * 16 bytes at a time with SSE2 compares; the scalar loops handle the tail
+ * and the rare vectors that contain a repeated byte.
+ */
+
+/* Repetition count test: fail on HEALTH_RCT_CUTOFF identical bytes in a row */
+static bool _health_rct(const uint8_t *buf, size_t n) {
+    size_t run = 1;
+    size_t i = 1;
+
+#if defined(__SSE2__)
+    while (i + 16 <= n) {
+        __m128i cur = _mm_loadu_si128((const __m128i *)(buf + i));
+        __m128i prev = _mm_loadu_si128((const __m128i *)(buf + i - 1));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(cur, prev)) == 0) {
+            /* Every byte differs from its predecessor: the run restarts */
+            run = 1;
+            i += 16;
+            continue;
+        }
+        for (size_t end = i + 16; i < end; i++) {
+            run = (buf[i] == buf[i - 1]) ? run + 1 : 1;
+            if (run >= HEALTH_RCT_CUTOFF) return false;
+        }
+    }
+#endif
+
+    for (; i < n; i++) {
+        run = (buf[i] == buf[i - 1]) ? run + 1 : 1;
+        if (run >= HEALTH_RCT_CUTOFF) return false;
+    }
+    return true;
+}
+
+/* Adaptive proportion test: count the first byte of each window in the window */
+static bool _health_apt(const uint8_t *buf, size_t n) {
+    for (size_t w = 0; w < n; w += HEALTH_APT_WINDOW) {
+        size_t end = (n - w) > HEALTH_APT_WINDOW ? w + HEALTH_APT_WINDOW : n;
+        const uint8_t a = buf[w];
+        size_t count = 1;
+        size_t i = w + 1;
+
+#if defined(__SSE2__)
+        /* Matches are -1 per lane; a 512-byte window cannot overflow a lane */
+        const __m128i va = _mm_set1_epi8((char)a);
+        __m128i acc = _mm_setzero_si128();
+        while (i + 16 <= end) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(buf + i));
+            acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(v, va));
+            i += 16;
+        }
+        __m128i sums = _mm_sad_epu8(acc, _mm_setzero_si128());
+        count += (size_t)_mm_cvtsi128_si32(sums) +
+                 (size_t)_mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+#endif
+
+        for (; i < end; i++) {
+            count += (buf[i] == a);
+        }
+        if (count >= HEALTH_APT_CUTOFF) return false;
+    }
+    return true;
+}
+
+uint32_t agle_health_test(const uint8_t *buf, size_t n) {
+    uint32_t failed = 0;
+    if (n == 0) return 0;
+
+    if (!_health_rct(buf, n)) failed |= AGLE_CTX_HEALTH_RCT_FAIL;
+    if (!_health_apt(buf, n)) failed |= AGLE_CTX_HEALTH_APT_FAIL;
+    return failed;
+}
+
+static bool _read_default(AGLE_CTX *ctx, uint8_t *buf, size_t n) {
+    return (ctx->flags & AGLE_CTX_DETERMINISTIC) ?
+           _read_seeded(ctx, buf, n) : _read_urandom(buf, n);
+}
+
+bool agle_entropy_read_from(AGLE_CTX *ctx, uint8_t *buf, size_t n,
+                            agle_entropy_source source) {
+    if (ctx->flags & AGLE_CTX_HEALTH_FAILED) return false;
+
+    uint32_t failed = 0;
+    for (int attempt = 0; attempt < HEALTH_MAX_ATTEMPTS; attempt++) {
+        if (!source(ctx, buf, n)) return false;
+
+        failed = agle_health_test(buf, n);
+        if (failed == 0) {
+            ctx->health_inputs++;
+            ctx->health_samples += n;
+            return true;
+        }
+        /* Discard the input; a healthy source rarely fails twice in a row */
+        AGLE_SecureZero(buf, n);
+        ctx->health_discards++;
+    }
+
+    /* Fail closed: nothing derived from this source may be used */
+    AGLE_SecureZero(ctx->state, sizeof(ctx->state));
+    ctx->flags = (ctx->flags & ~AGLE_CTX_SEEDED) | failed;
+    return false;
+}
+
+bool agle_entropy_read(AGLE_CTX *ctx, uint8_t *buf, size_t n) {
+    return agle_entropy_read_from(ctx, buf, n, _read_default);
+}
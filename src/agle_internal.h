@@ -0,0 +1,153 @@
+/**
+ * @file agle_internal.h
+ * @brief Internal interfaces shared between AGLE translation units.
+ *
+ * Not installed. Everything declared here has hidden visibility so the
+ * shared library only exports the public AGLE_* API.
+ */
+
+#ifndef AGLE_INTERNAL_H
+#define AGLE_INTERNAL_H
+
+#include "agle.h"
+#include <openssl/evp.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define AGLE_INTERNAL __attribute__((visibility("hidden")))
+#else
+#define AGLE_INTERNAL
+#endif
+
+/* ============================================================================
+ * Entropy Input (agle_entropy.c)
+ * ============================================================================ */
+
+/**
+ * Fill buf with entropy input for ctx: the kernel CSPRNG, or the seeded
+ * SHAKE256 stream when ctx is in deterministic mode. The input passes the
+ * SP 800-90B health tests before it is returned. A failing input is
+ * discarded and replaced; after three failures in a row ctx fails closed
+ * (state wiped, AGLE_CTX_HEALTH_* set).
+ * @return: true on success, false on failure
+ */
+AGLE_INTERNAL bool agle_entropy_read(AGLE_CTX *ctx, uint8_t *buf, size_t n);
+
+/**
+ * Raw entropy source: fill buf with n bytes, no health testing
+ */
+typedef bool (*agle_entropy_source)(AGLE_CTX *ctx, uint8_t *buf, size_t n);
+
+/**
+ * agle_entropy_read with an explicit source; lets tests feed stuck or
+ * biased input through the health tests and the failure handling
+ */
+AGLE_INTERNAL bool agle_entropy_read_from(AGLE_CTX *ctx, uint8_t *buf, size_t n,
+                                          agle_entropy_source source);
+
+/**
+ * SP 800-90B repetition count and adaptive proportion tests on one input
+ * @return: 0 if both pass, otherwise the AGLE_CTX_HEALTH_*_FAIL bits
+ */
+AGLE_INTERNAL uint32_t agle_health_test(const uint8_t *buf, size_t n);
+
+/**
+ * Switch ctx to deterministic entropy derived from seed
+ * @return: true on success, false on failure
+ */
+AGLE_INTERNAL bool agle_entropy_set_seed(AGLE_CTX *ctx, const uint8_t *seed,
+                                         size_t seed_len);
+
+/* ============================================================================
+ * Generator Backends (agle_backend.c)
+ * ============================================================================ */
+
+/**
+ * @brief Backend vtable. All state lives in AGLE_CTX.state.
+ */
+typedef struct {
+    const char *name;
+    const char *info;              /* Full AGLE_GetContextInfo() string */
+    size_t seed_len;               /* Entropy bytes per (re)seed */
+    uint64_t reseed_interval;      /* Generate requests per seed, 0 = never */
+    size_t max_request;            /* Max bytes per generate call */
+    bool (*instantiate)(AGLE_CTX *ctx, const uint8_t *seed);
+    bool (*reseed)(AGLE_CTX *ctx, const uint8_t *seed);
+    bool (*generate)(AGLE_CTX *ctx, uint8_t *out, size_t n);
+} agle_backend;
+
+/**
+ * Look up a backend by AGLE_Backend id
+ * @return: Backend, or NULL if id is unknown
+ */
+AGLE_INTERNAL const agle_backend *agle_backend_get(uint32_t id);
+
+/**
+ * SHAKE256 digest, fetched once per process
+ */
+AGLE_INTERNAL const EVP_MD *agle_shake256_md(void);
+
+/* ============================================================================
+ * Hashing for In-Memory Tables (agle_hash.c)
+ * ============================================================================ */
+
+#define AGLE_SIPHASH_KEY_LEN 16
+
+/**
+ * SipHash-2-4 of data under a 128-bit key. For hash-table indexing of
+ * attacker-chosen keys (usernames, addresses); not a MAC for stored data.
+ */
+AGLE_INTERNAL uint64_t agle_siphash24(const uint8_t key[AGLE_SIPHASH_KEY_LEN],
+                                      const void *data, size_t len);
+
+/**
+ * Fresh random SipHash key from the kernel CSPRNG
+ * @return: true on success, false on failure
+ */
+AGLE_INTERNAL bool agle_siphash_key(uint8_t key[AGLE_SIPHASH_KEY_LEN]);
+
+/**
+ * CRC32C (Castagnoli) of data, continuing from crc (0 to start), with the
+ * SSE4.2 CRC32 instruction when the CPU has it. Integrity check for
+ * persisted records and token checksums, not a MAC.
+ */
+AGLE_INTERNAL uint32_t agle_crc32c(uint32_t crc, const void *data, size_t len);
+
+/**
+ * Byte-table CRC32C, the fallback agle_crc32c() uses without SSE4.2.
+ * Same results; exposed so tests can check it on any CPU.
+ */
+AGLE_INTERNAL uint32_t agle_crc32c_table(uint32_t crc, const void *data, size_t len);
+
+/* ============================================================================
+ * Session Store Internals (agle_session.c)
+ * ============================================================================ */
+
+#define AGLE_SESSION_DIGEST_LEN 32
+
+/**
+ * Digest a token the way the session store keys it
+ * @return: true on success, false on failure
+ */
+AGLE_INTERNAL bool agle_session_digest(const char *token, size_t token_len,
+                                       uint8_t digest[AGLE_SESSION_DIGEST_LEN]);
+
+/**
+ * AGLE_SessionInsert / AGLE_SessionRemove for an already computed digest
+ */
+AGLE_INTERNAL bool agle_session_insert_digest(AGLE_SESSION_STORE *store,
+                                              const uint8_t digest[AGLE_SESSION_DIGEST_LEN],
+                                              const AGLE_SessionInfo *info);
+AGLE_INTERNAL bool agle_session_remove_digest(AGLE_SESSION_STORE *store,
+                                              const uint8_t digest[AGLE_SESSION_DIGEST_LEN]);
+
+/**
+ * Call fn for every session with expires_at > now, one shard at a time under
+ * its read lock. fn must not call back into the store.
+ * @return: false if fn returned false (iteration stops)
+ */
+AGLE_INTERNAL bool agle_session_foreach(AGLE_SESSION_STORE *store, int64_t now,
+                                        bool (*fn)(void *arg, const uint8_t *digest,
+                                                   const AGLE_SessionInfo *info),
+                                        void *arg);
+
+#endif /* AGLE_INTERNAL_H */
@@ -0,0 +1,691 @@
+/**
+ * @file agle_persist.c
+ * @brief Write-ahead log and snapshot persistence for users and sessions.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "agle_internal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * <prefix>.wal   "AGLEWAL1" then records: u32 len, u32 crc32c(type||payload),
+ *                u8 type, payload[len]. A record that is short or fails its
+ *                CRC ends the log; replay truncates the file there.
+ * <prefix>.snap  snap_header, then 64-byte aligned columns: names, salts,
+ *                hashes, KDF costs (user id order) and snap_session records.
+ *                Version 1 files (no KDF column, shorter header) still load.
+ *
+ * Mutations are applied in memory first and logged second, so everything a
+ * snapshot misses is still in the log after it. Replay is idempotent:
+ * duplicate users and sessions are ignored, expired sessions skipped.
+ * Both files use host byte order; a foreign file fails the magic/version check.
+ */
+#define WAL_MAGIC "AGLEWAL1"
+#define SNAP_MAGIC "AGLESNP1"
+#define MAGIC_LEN 8
+#define SNAP_VERSION 2
+#define SNAP_ALIGN 64
+
+#define WAL_USER_ADD 1            /* Replay only; written before KDF costs were stored */
+#define WAL_SESSION_ADD 2
+#define WAL_SESSION_DEL 3
+#define WAL_USER_ADD_KDF 4
+
+#define WAL_RECORD_HEADER 9
+#define WAL_USER_PAYLOAD (AGLE_USERNAME_MAX + AGLE_USER_SALT_LEN + AGLE_USER_HASH_LEN)
+#define WAL_SESSION_PAYLOAD (AGLE_SESSION_DIGEST_LEN + AGLE_SESSION_USERNAME_MAX + 16)
+#define WAL_USER_KDF_PAYLOAD (WAL_USER_PAYLOAD + 4)
+#define WAL_MAX_PAYLOAD WAL_USER_KDF_PAYLOAD
+
+#define PERSIST_INITIAL_BUFFER (64 * 1024)
+#define PERSIST_MAX_PENDING ((size_t)64 << 20)    /* Refuse writes beyond this backlog */
+#define PERSIST_WAL_LIMIT ((size_t)16 << 20)      /* Snapshot once the log is this long */
+
+typedef struct {
+    char magic[MAGIC_LEN];
+    uint32_t version;
+    uint32_t body_crc;
+    uint64_t user_count;
+    uint64_t session_count;
+    uint64_t names_off;
+    uint64_t salts_off;
+    uint64_t hashes_off;
+    uint64_t sessions_off;
+    uint64_t file_len;
+    uint64_t kdf_off;             /* Version 2 */
+} snap_header;
+
+#define SNAP_HEADER_V1_LEN offsetof(snap_header, kdf_off)
+
+typedef struct {
+    uint8_t digest[AGLE_SESSION_DIGEST_LEN];
+    char username[AGLE_SESSION_USERNAME_MAX];
+    int64_t created_at;
+    int64_t expires_at;
+} snap_session;
+
+struct AGLE_PERSIST {
+    AGLE_USER_DIR *users;
+    AGLE_SESSION_STORE *sessions;
+
+    char *wal_path;
+    char *snap_path;
+    char *tmp_path;
+    char *dir_path;
+    int wal_fd;
+    size_t wal_size;
+    size_t snapshot_at;
+
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t work;        /* Signalled when there is something to write */
+    pthread_cond_t done;        /* Signalled when durable advances */
+
+    /* Group commit: callers append to pending, the writer swaps it out */
+    uint8_t *pending;
+    size_t pending_len;
+    size_t pending_cap;
+    uint8_t *writing;
+    size_t writing_cap;
+    uint64_t enqueued;
+    uint64_t durable;
+    bool snapshot_requested;
+    bool stopping;
+    bool failed;
+};
+
+static void _store_le32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static uint32_t _load_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static char *_path_with(const char *prefix, const char *suffix) {
+    size_t a = strlen(prefix), b = strlen(suffix);
+    char *path = malloc(a + b + 1);
+    if (path == NULL) return NULL;
+    memcpy(path, prefix, a);
+    memcpy(path + a, suffix, b + 1);
+    return path;
+}
+
+static char *_dir_of(const char *prefix) {
+    const char *slash = strrchr(prefix, '/');
+    if (slash == NULL) return _path_with(".", "");
+    if (slash == prefix) return _path_with("/", "");
+
+    size_t len = (size_t)(slash - prefix);
+    char *dir = malloc(len + 1);
+    if (dir == NULL) return NULL;
+    memcpy(dir, prefix, len);
+    dir[len] = '\0';
+    return dir;
+}
+
+static bool _write_all(int fd, const void *data, size_t len) {
+    const uint8_t *p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool _fsync_dir(const char *dir) {
+    int fd = open(dir, O_RDONLY);
+    if (fd < 0) return false;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+static size_t _align_up(size_t n) {
+    return (n + SNAP_ALIGN - 1) & ~(size_t)(SNAP_ALIGN - 1);
+}
+
+/* ============================================================================
+ * Snapshot Load
+ * ============================================================================ */
+
+static size_t _snap_header_len(uint32_t version) {
+    return version == 1 ? SNAP_HEADER_V1_LEN : sizeof(snap_header);
+}
+
+static bool _snap_layout_ok(const snap_header *h, size_t size) {
+    if (memcmp(h->magic, SNAP_MAGIC, MAGIC_LEN) != 0) return false;
+    if (h->version != 1 && h->version != SNAP_VERSION) return false;
+    if (h->file_len != size || h->user_count > UINT32_MAX) return false;
+
+    if (h->names_off > size || h->salts_off > size || h->hashes_off > size ||
+        h->kdf_off > size || h->sessions_off > size) {
+        return false;
+    }
+
+    uint64_t users = h->user_count;
+    uint64_t hashes_end = h->hashes_off + users * AGLE_USER_HASH_LEN;
+    if (h->version != 1) {
+        if (hashes_end > h->kdf_off) return false;
+        hashes_end = h->kdf_off + users * sizeof(uint32_t);
+    }
+    return h->names_off >= _snap_header_len(h->version) &&
+           h->names_off + users * AGLE_USERNAME_MAX <= h->salts_off &&
+           h->salts_off + users * AGLE_USER_SALT_LEN <= h->hashes_off &&
+           hashes_end <= h->sessions_off &&
+           h->session_count <= (size - h->sessions_off) / sizeof(snap_session);
+}
+
+static bool _load_snapshot(AGLE_PERSIST *p, int64_t now) {
+    int fd = open(p->snap_path, O_RDONLY);
+    if (fd < 0) return errno == ENOENT;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < SNAP_HEADER_V1_LEN) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = (size_t)st.st_size;
+    const uint8_t *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+    posix_madvise((void *)map, size, POSIX_MADV_SEQUENTIAL);
+
+    snap_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(&h, map, SNAP_HEADER_V1_LEN);
+    size_t header_len = _snap_header_len(h.version);
+    if (header_len > SNAP_HEADER_V1_LEN && size >= header_len) {
+        memcpy(&h, map, header_len);
+    }
+    bool ok = size >= header_len && _snap_layout_ok(&h, size) &&
+              agle_crc32c(0, map + header_len, size - header_len) == h.body_crc;
+
+    /* The columns are read in place; only the hash indexes are rebuilt */
+    const char (*names)[AGLE_USERNAME_MAX] =
+        (const char (*)[AGLE_USERNAME_MAX])(map + h.names_off);
+    const uint8_t (*salts)[AGLE_USER_SALT_LEN] =
+        (const uint8_t (*)[AGLE_USER_SALT_LEN])(map + h.salts_off);
+    const uint8_t (*hashes)[AGLE_USER_HASH_LEN] =
+        (const uint8_t (*)[AGLE_USER_HASH_LEN])(map + h.hashes_off);
+    const uint8_t *kdf = h.version == 1 ? NULL : map + h.kdf_off;
+    const snap_session *sessions = (const void *)(map + h.sessions_off);
+
+    for (uint64_t i = 0; ok && i < h.user_count; i++) {
+        if (memchr(names[i], '\0', AGLE_USERNAME_MAX) == NULL) {
+            ok = false;
+            break;
+        }
+        uint32_t kdf_iterations = 0;
+        if (kdf != NULL) memcpy(&kdf_iterations, kdf + i * sizeof(uint32_t), sizeof(uint32_t));
+        AGLE_UserDirAdd(p->users, names[i], salts[i], hashes[i], kdf_iterations, NULL);
+    }
+    for (uint64_t i = 0; ok && i < h.session_count; i++) {
+        snap_session s;
+        memcpy(&s, &sessions[i], sizeof(s));
+        if (s.expires_at <= now) continue;
+
+        AGLE_SessionInfo info;
+        memcpy(info.username, s.username, sizeof(info.username));
+        info.created_at = s.created_at;
+        info.expires_at = s.expires_at;
+        agle_session_insert_digest(p->sessions, s.digest, &info);
+    }
+
+    munmap((void *)map, size);
+    return ok;
+}
+
+/* ============================================================================
+ * Log Replay
+ * ============================================================================ */
+
+static void _apply_record(AGLE_PERSIST *p, uint8_t type, const uint8_t *payload,
+                          uint32_t len, int64_t now) {
+    if ((type == WAL_USER_ADD && len == WAL_USER_PAYLOAD) ||
+        (type == WAL_USER_ADD_KDF && len == WAL_USER_KDF_PAYLOAD)) {
+        char name[AGLE_USERNAME_MAX];
+        uint32_t kdf_iterations = 0;
+        memcpy(name, payload, AGLE_USERNAME_MAX);
+        name[AGLE_USERNAME_MAX - 1] = '\0';
+        if (type == WAL_USER_ADD_KDF) kdf_iterations = _load_le32(payload + WAL_USER_PAYLOAD);
+        AGLE_UserDirAdd(p->users, name, payload + AGLE_USERNAME_MAX,
+                        payload + AGLE_USERNAME_MAX + AGLE_USER_SALT_LEN, kdf_iterations, NULL);
+    } else if (type == WAL_SESSION_ADD && len == WAL_SESSION_PAYLOAD) {
+        AGLE_SessionInfo info;
+        const uint8_t *q = payload + AGLE_SESSION_DIGEST_LEN;
+        memcpy(info.username, q, AGLE_SESSION_USERNAME_MAX);
+        memcpy(&info.created_at, q + AGLE_SESSION_USERNAME_MAX, 8);
+        memcpy(&info.expires_at, q + AGLE_SESSION_USERNAME_MAX + 8, 8);
+        if (info.expires_at > now) {
+            agle_session_insert_digest(p->sessions, payload, &info);
+        }
+    } else if (type == WAL_SESSION_DEL && len == AGLE_SESSION_DIGEST_LEN) {
+        agle_session_remove_digest(p->sessions, payload);
+    }
+}
+
+/* Replay the log and cut off a torn tail. Leaves wal_size at the valid end. */
+static bool _replay_wal(AGLE_PERSIST *p, int64_t now) {
+    struct stat st;
+    if (fstat(p->wal_fd, &st) != 0) return false;
+
+    size_t size = (size_t)st.st_size;
+    if (size < MAGIC_LEN) {
+        /* New (or torn before the header was written) */
+        if (ftruncate(p->wal_fd, 0) != 0 || !_write_all(p->wal_fd, WAL_MAGIC, MAGIC_LEN) ||
+            fdatasync(p->wal_fd) != 0) {
+            return false;
+        }
+        p->wal_size = MAGIC_LEN;
+        return true;
+    }
+
+    const uint8_t *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, p->wal_fd, 0);
+    if (map == MAP_FAILED) return false;
+    if (memcmp(map, WAL_MAGIC, MAGIC_LEN) != 0) {
+        munmap((void *)map, size);
+        return false;
+    }
+    posix_madvise((void *)map, size, POSIX_MADV_SEQUENTIAL);
+
+    size_t off = MAGIC_LEN;
+    while (size - off >= WAL_RECORD_HEADER) {
+        uint32_t len = _load_le32(map + off);
+        uint32_t crc = _load_le32(map + off + 4);
+        if (len > WAL_MAX_PAYLOAD || size - off - WAL_RECORD_HEADER < len) break;
+        if (agle_crc32c(0, map + off + 8, (size_t)len + 1) != crc) break;
+
+        _apply_record(p, map[off + 8], map + off + WAL_RECORD_HEADER, len, now);
+        off += WAL_RECORD_HEADER + len;
+    }
+    munmap((void *)map, size);
+
+    if (off != size && (ftruncate(p->wal_fd, (off_t)off) != 0 || fdatasync(p->wal_fd) != 0)) {
+        return false;
+    }
+    p->wal_size = off;
+    return true;
+}
+
+/* ============================================================================
+ * Snapshot Write (writer thread)
+ * ============================================================================ */
+
+typedef struct {
+    FILE *f;
+    uint32_t crc;
+    uint64_t count;
+} snap_writer;
+
+static bool _snap_put(snap_writer *w, const void *data, size_t len) {
+    w->crc = agle_crc32c(w->crc, data, len);
+    return fwrite(data, 1, len, w->f) == len;
+}
+
+static bool _snap_pad(snap_writer *w, size_t *pos) {
+    static const uint8_t zeros[SNAP_ALIGN];
+    size_t pad = _align_up(*pos) - *pos;
+    *pos += pad;
+    return _snap_put(w, zeros, pad);
+}
+
+static bool _snap_put_session(void *arg, const uint8_t *digest, const AGLE_SessionInfo *info) {
+    snap_writer *w = arg;
+    snap_session s;
+    memset(&s, 0, sizeof(s));
+    memcpy(s.digest, digest, sizeof(s.digest));
+    memcpy(s.username, info->username, sizeof(s.username));
+    s.created_at = info->created_at;
+    s.expires_at = info->expires_at;
+    w->count++;
+    return _snap_put(w, &s, sizeof(s));
+}
+
+/* Column pass over the user directory: field 0 names, 1 salts, 2 hashes, 3 KDF costs */
+static bool _snap_put_users(snap_writer *w, AGLE_USER_DIR *users, uint64_t count, int field) {
+    AGLE_UserRecord rec;
+    bool ok = true;
+    for (uint64_t id = 0; ok && id < count; id++) {
+        ok = AGLE_UserDirGet(users, (uint32_t)id, &rec);
+        if (!ok) break;
+        if (field == 0) ok = _snap_put(w, rec.username, sizeof(rec.username));
+        if (field == 1) ok = _snap_put(w, rec.salt, sizeof(rec.salt));
+        if (field == 2) ok = _snap_put(w, rec.hash, sizeof(rec.hash));
+        if (field == 3) ok = _snap_put(w, &rec.kdf_iterations, sizeof(rec.kdf_iterations));
+    }
+    AGLE_SecureZero(&rec, sizeof(rec));
+    return ok;
+}
+
+static bool _write_snapshot(AGLE_PERSIST *p) {
+    snap_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SNAP_MAGIC, MAGIC_LEN);
+    h.version = SNAP_VERSION;
+    h.user_count = AGLE_UserDirCount(p->users);
+
+    size_t pos = _align_up(sizeof(h));
+    h.names_off = pos;
+    pos += h.user_count * AGLE_USERNAME_MAX;
+    h.salts_off = pos = _align_up(pos);
+    pos += h.user_count * AGLE_USER_SALT_LEN;
+    h.hashes_off = pos = _align_up(pos);
+    pos += h.user_count * AGLE_USER_HASH_LEN;
+    h.kdf_off = pos = _align_up(pos);
+    pos += h.user_count * sizeof(uint32_t);
+    h.sessions_off = _align_up(pos);
+
+    /* Owner-only like the log: it holds every salt and password hash. A
+     * leftover temp file from a crash may carry a wider mode; start fresh. */
+    unlink(p->tmp_path);
+    int fd = open(p->tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_EXCL, 0600);
+    if (fd < 0) return false;
+    FILE *f = fdopen(fd, "wb");
+    if (f == NULL) {
+        close(fd);
+        unlink(p->tmp_path);
+        return false;
+    }
+
+    snap_writer w = {f, 0, 0};
+    pos = sizeof(h);
+    bool ok = fseek(f, (long)sizeof(h), SEEK_SET) == 0;
+    static const size_t column_width[4] = {
+        AGLE_USERNAME_MAX, AGLE_USER_SALT_LEN, AGLE_USER_HASH_LEN, sizeof(uint32_t)
+    };
+    for (int field = 0; ok && field < 4; field++) {
+        ok = _snap_pad(&w, &pos) && _snap_put_users(&w, p->users, h.user_count, field);
+        pos += h.user_count * column_width[field];
+    }
+    ok = ok && _snap_pad(&w, &pos) &&
+         agle_session_foreach(p->sessions, (int64_t)time(NULL), _snap_put_session, &w);
+
+    h.session_count = w.count;
+    h.file_len = pos + w.count * sizeof(snap_session);
+    h.body_crc = w.crc;
+    ok = ok && fseek(f, 0, SEEK_SET) == 0 && fwrite(&h, sizeof(h), 1, f) == 1 &&
+         fflush(f) == 0 && fsync(fileno(f)) == 0;
+    ok = (fclose(f) == 0) && ok;
+
+    /* The snapshot is durable before the log it replaces is cut */
+    if (!ok || rename(p->tmp_path, p->snap_path) != 0 || !_fsync_dir(p->dir_path)) {
+        unlink(p->tmp_path);
+        return false;
+    }
+    if (ftruncate(p->wal_fd, MAGIC_LEN) != 0 || fdatasync(p->wal_fd) != 0) return false;
+    p->wal_size = MAGIC_LEN;
+    return true;
+}
+
+/* ============================================================================
+ * Writer Thread
+ * ============================================================================ */
+
+static void *_writer_main(void *arg) {
+    AGLE_PERSIST *p = arg;
+
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        while (p->pending_len == 0 && !p->snapshot_requested && !p->stopping) {
+            pthread_cond_wait(&p->work, &p->lock);
+        }
+        if (p->pending_len == 0 && !p->snapshot_requested) break;
+
+        /* Everything appended so far goes out in one write + fdatasync */
+        uint8_t *batch = p->pending;
+        size_t len = p->pending_len;
+        size_t cap = p->pending_cap;
+        p->pending = p->writing;
+        p->pending_cap = p->writing_cap;
+        p->pending_len = 0;
+        p->writing = batch;
+        p->writing_cap = cap;
+
+        uint64_t seq = p->enqueued;
+        bool snapshot = p->snapshot_requested;
+        p->snapshot_requested = false;
+        pthread_mutex_unlock(&p->lock);
+
+        bool ok = true;
+        if (len > 0) {
+            ok = _write_all(p->wal_fd, batch, len) && fdatasync(p->wal_fd) == 0;
+            p->wal_size += len;
+        }
+        if (ok && (snapshot || p->wal_size >= p->snapshot_at)) {
+            /* A failed snapshot leaves the log intact; retry after it grows */
+            p->snapshot_at = _write_snapshot(p) ? PERSIST_WAL_LIMIT
+                                                : p->wal_size + PERSIST_WAL_LIMIT;
+        }
+
+        pthread_mutex_lock(&p->lock);
+        if (ok) {
+            p->durable = seq;
+        } else {
+            p->failed = true;
+        }
+        pthread_cond_broadcast(&p->done);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+static bool _enqueue(AGLE_PERSIST *p, uint8_t type, const uint8_t *payload, uint32_t len) {
+    size_t need = WAL_RECORD_HEADER + len;
+    uint8_t header[WAL_RECORD_HEADER];
+    _store_le32(header, len);
+    header[8] = type;
+    uint32_t crc = agle_crc32c(agle_crc32c(0, &type, 1), payload, len);
+    _store_le32(header + 4, crc);
+
+    bool ok = false;
+    pthread_mutex_lock(&p->lock);
+    if (p->stopping || p->failed) goto done;
+
+    if (p->pending_len + need > p->pending_cap) {
+        size_t cap = p->pending_cap;
+        while (cap < p->pending_len + need) {
+            cap *= 2;
+        }
+        if (cap > PERSIST_MAX_PENDING) goto done;
+        uint8_t *grown = realloc(p->pending, cap);
+        if (grown == NULL) goto done;
+        p->pending = grown;
+        p->pending_cap = cap;
+    }
+
+    memcpy(p->pending + p->pending_len, header, WAL_RECORD_HEADER);
+    memcpy(p->pending + p->pending_len + WAL_RECORD_HEADER, payload, len);
+    p->pending_len += need;
+    p->enqueued++;
+    pthread_cond_signal(&p->work);
+    ok = true;
+
+done:
+    pthread_mutex_unlock(&p->lock);
+    return ok;
+}
+
+/* ============================================================================
+ * Public Interface
+ * ============================================================================ */
+
+AGLE_PERSIST* AGLE_PersistOpen(const char *path_prefix, AGLE_USER_DIR *users,
+                               AGLE_SESSION_STORE *sessions, int64_t now) {
+    if (path_prefix == NULL || users == NULL || sessions == NULL) return NULL;
+
+    AGLE_PERSIST *p = calloc(1, sizeof(*p));
+    if (p == NULL) return NULL;
+    p->users = users;
+    p->sessions = sessions;
+    p->wal_fd = -1;
+    p->snapshot_at = PERSIST_WAL_LIMIT;
+
+    p->wal_path = _path_with(path_prefix, ".wal");
+    p->snap_path = _path_with(path_prefix, ".snap");
+    p->tmp_path = _path_with(path_prefix, ".snap.tmp");
+    p->dir_path = _dir_of(path_prefix);
+    p->pending = malloc(PERSIST_INITIAL_BUFFER);
+    p->writing = malloc(PERSIST_INITIAL_BUFFER);
+    p->pending_cap = p->writing_cap = PERSIST_INITIAL_BUFFER;
+    if (p->wal_path == NULL || p->snap_path == NULL || p->tmp_path == NULL ||
+        p->dir_path == NULL || p->pending == NULL || p->writing == NULL) {
+        goto fail;
+    }
+
+    /* Start the expiry wheel at now so restored sessions are not stepped past */
+    AGLE_SessionStoreTick(sessions, now);
+
+    if (!_load_snapshot(p, now)) goto fail;
+
+    p->wal_fd = open(p->wal_path, O_RDWR | O_CREAT | O_APPEND, 0600);
+    if (p->wal_fd < 0 || !_replay_wal(p, now)) goto fail;
+
+    if (pthread_mutex_init(&p->lock, NULL) != 0) goto fail;
+    if (pthread_cond_init(&p->work, NULL) != 0) {
+        pthread_mutex_destroy(&p->lock);
+        goto fail;
+    }
+    if (pthread_cond_init(&p->done, NULL) != 0) {
+        pthread_cond_destroy(&p->work);
+        pthread_mutex_destroy(&p->lock);
+        goto fail;
+    }
+    if (pthread_create(&p->writer, NULL, _writer_main, p) != 0) {
+        pthread_cond_destroy(&p->done);
+        pthread_cond_destroy(&p->work);
+        pthread_mutex_destroy(&p->lock);
+        goto fail;
+    }
+    return p;
+
+fail:
+    if (p->wal_fd >= 0) close(p->wal_fd);
+    free(p->wal_path);
+    free(p->snap_path);
+    free(p->tmp_path);
+    free(p->dir_path);
+    free(p->pending);
+    free(p->writing);
+    free(p);
+    return NULL;
+}
+
+void AGLE_PersistClose(AGLE_PERSIST *p) {
+    if (p == NULL) return;
+
+    pthread_mutex_lock(&p->lock);
+    p->stopping = true;
+    pthread_cond_signal(&p->work);
+    pthread_mutex_unlock(&p->lock);
+    pthread_join(p->writer, NULL);
+
+    close(p->wal_fd);
+    pthread_cond_destroy(&p->done);
+    pthread_cond_destroy(&p->work);
+    pthread_mutex_destroy(&p->lock);
+
+    AGLE_SecureZero(p->pending, p->pending_cap);
+    AGLE_SecureZero(p->writing, p->writing_cap);
+    free(p->pending);
+    free(p->writing);
+    free(p->wal_path);
+    free(p->snap_path);
+    free(p->tmp_path);
+    free(p->dir_path);
+    free(p);
+}
+
+bool AGLE_PersistUserAdd(AGLE_PERSIST *p, const char *username,
+                         const uint8_t *salt, const uint8_t *hash,
+                         uint32_t kdf_iterations) {
+    if (p == NULL || username == NULL || salt == NULL || hash == NULL) return false;
+
+    size_t len = strlen(username);
+    if (len == 0 || len >= AGLE_USERNAME_MAX) return false;
+
+    uint8_t payload[WAL_USER_KDF_PAYLOAD] = {0};
+    memcpy(payload, username, len);
+    memcpy(payload + AGLE_USERNAME_MAX, salt, AGLE_USER_SALT_LEN);
+    memcpy(payload + AGLE_USERNAME_MAX + AGLE_USER_SALT_LEN, hash, AGLE_USER_HASH_LEN);
+    _store_le32(payload + WAL_USER_PAYLOAD, kdf_iterations);
+
+    bool ok = _enqueue(p, WAL_USER_ADD_KDF, payload, sizeof(payload));
+    AGLE_SecureZero(payload, sizeof(payload));
+    return ok;
+}
+
+bool AGLE_PersistSessionAdd(AGLE_PERSIST *p, const char *token, size_t token_len,
+                            const AGLE_SessionInfo *info) {
+    if (p == NULL || token == NULL || token_len == 0 || info == NULL) return false;
+
+    uint8_t payload[WAL_SESSION_PAYLOAD] = {0};
+    if (!agle_session_digest(token, token_len, payload)) return false;
+
+    uint8_t *q = payload + AGLE_SESSION_DIGEST_LEN;
+    memcpy(q, info->username, strnlen(info->username, AGLE_SESSION_USERNAME_MAX - 1));
+    memcpy(q + AGLE_SESSION_USERNAME_MAX, &info->created_at, 8);
+    memcpy(q + AGLE_SESSION_USERNAME_MAX + 8, &info->expires_at, 8);
+
+    bool ok = _enqueue(p, WAL_SESSION_ADD, payload, sizeof(payload));
+    AGLE_SecureZero(payload, sizeof(payload));
+    return ok;
+}
+
+bool AGLE_PersistSessionRemove(AGLE_PERSIST *p, const char *token, size_t token_len) {
+    if (p == NULL || token == NULL || token_len == 0) return false;
+
+    uint8_t digest[AGLE_SESSION_DIGEST_LEN];
+    if (!agle_session_digest(token, token_len, digest)) return false;
+
+    bool ok = _enqueue(p, WAL_SESSION_DEL, digest, sizeof(digest));
+    AGLE_SecureZero(digest, sizeof(digest));
+    return ok;
+}
+
+bool AGLE_PersistSnapshot(AGLE_PERSIST *p) {
+    if (p == NULL) return false;
+
+    pthread_mutex_lock(&p->lock);
+    bool ok = !p->stopping && !p->failed;
+    if (ok) {
+        /* Counts as a queued write so that AGLE_PersistFlush waits for it */
+        p->snapshot_requested = true;
+        p->enqueued++;
+        pthread_cond_signal(&p->work);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return ok;
+}
+
+bool AGLE_PersistFlush(AGLE_PERSIST *p) {
+    if (p == NULL) return false;
+
+    pthread_mutex_lock(&p->lock);
+    uint64_t target = p->enqueued;
+    while (p->durable < target && !p->failed) {
+        pthread_cond_wait(&p->done, &p->lock);
+    }
+    bool ok = !p->failed;
+    pthread_mutex_unlock(&p->lock);
+    return ok;
+}
@@ -0,0 +1,109 @@
+/**
+ * @file agle_ratelimit.c
+ * @brief Fixed-memory, lock-free token-bucket rate limiter.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "agle_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Each bucket is one 64-bit word: last refill time (low 32 bits of the
+ * millisecond clock) | milli-tokens. A refill of rate tokens/s over d ms is
+ * then exactly d * rate milli-tokens, with no division. 0 marks a bucket
+ * never used, which starts full.
+ *
+ * Buckets are grouped in cache lines of 8; a key picks one line and two
+ * distinct buckets inside it, so a check costs one SipHash and one miss.
+ */
+#define RL_LINE 8
+#define RL_MILLI 1000u
+#define RL_MAX_BURST 4000000u
+#define RL_MAX_SKEW_MS 60000      /* Clock lag tolerated between callers */
+
+struct AGLE_RATE_LIMITER {
+    uint64_t *buckets;        /* 64-byte aligned, line_mask + 1 lines */
+    size_t line_mask;
+    uint32_t rate;            /* Milli-tokens per millisecond */
+    uint32_t capacity;        /* Milli-tokens */
+    uint8_t sip_key[AGLE_SIPHASH_KEY_LEN];
+};
+
+AGLE_RATE_LIMITER* AGLE_RateLimiterNew(size_t buckets, uint32_t rate_per_sec, uint32_t burst) {
+    if (burst == 0 || burst > RL_MAX_BURST) return NULL;
+
+    AGLE_RATE_LIMITER *rl = calloc(1, sizeof(*rl));
+    if (rl == NULL) return NULL;
+
+    size_t lines = 1;
+    while (lines * RL_LINE < buckets) {
+        lines <<= 1;
+    }
+    rl->line_mask = lines - 1;
+    rl->rate = rate_per_sec;
+    rl->capacity = burst * RL_MILLI;
+
+    if (posix_memalign((void **)&rl->buckets, 64, lines * RL_LINE * sizeof(uint64_t)) != 0) {
+        free(rl);
+        return NULL;
+    }
+    memset(rl->buckets, 0, lines * RL_LINE * sizeof(uint64_t));
+
+    if (!agle_siphash_key(rl->sip_key)) {
+        AGLE_RateLimiterFree(rl);
+        return NULL;
+    }
+    return rl;
+}
+
+void AGLE_RateLimiterFree(AGLE_RATE_LIMITER *rl) {
+    if (rl == NULL) return;
+    free(rl->buckets);
+    free(rl);
+}
+
+/* Refill, then take one token if there is one */
+static bool _bucket_take(const AGLE_RATE_LIMITER *rl, uint64_t *bucket, uint32_t now) {
+    uint64_t old = __atomic_load_n(bucket, __ATOMIC_RELAXED);
+    for (;;) {
+        uint32_t stamp = now;
+        uint64_t tokens = rl->capacity;
+        if (old != 0) {
+            uint32_t last = (uint32_t)(old >> 32);
+            int32_t elapsed = (int32_t)(now - last);
+            if (elapsed >= 0) {
+                tokens = (uint32_t)old + (uint64_t)(uint32_t)elapsed * rl->rate;
+            } else if (elapsed > -RL_MAX_SKEW_MS) {
+                /* A caller with a slightly stale clock neither refills nor rewinds */
+                tokens = (uint32_t)old;
+                stamp = last;
+            }
+            /* else: idle for ~25 days, the 32-bit stamp wrapped; start full */
+            if (tokens > rl->capacity) tokens = rl->capacity;
+        }
+        if (tokens < RL_MILLI) return false;
+
+        uint64_t val = ((uint64_t)stamp << 32) | (tokens - RL_MILLI);
+        if (val == 0) val = (uint64_t)1 << 32;  /* Keep "empty" distinct from "never used" */
+        if (__atomic_compare_exchange_n(bucket, &old, val, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            return true;
+        }
+    }
+}
+
+bool AGLE_RateLimitTake(AGLE_RATE_LIMITER *rl, const void *key, size_t key_len,
+                        uint64_t now_ms) {
+    uint64_t h = agle_siphash24(rl->sip_key, key, key_len);
+    uint64_t *line = rl->buckets + ((size_t)h & rl->line_mask) * RL_LINE;
+    unsigned a = (unsigned)(h >> 58) & (RL_LINE - 1);
+    unsigned b = (unsigned)(h >> 61);
+    if (a == b) b ^= 1;
+
+    /* Both buckets pay, so a key alone is held to one bucket's rate */
+    bool ok_a = _bucket_take(rl, &line[a], (uint32_t)now_ms);
+    bool ok_b = _bucket_take(rl, &line[b], (uint32_t)now_ms);
+    return ok_a || ok_b;
+}
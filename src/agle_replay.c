@@ -0,0 +1,206 @@
+/**
+ * @file agle_replay.c
+ * @brief Nonce replay cache: per-epoch bucket sets that expire by stamp.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "agle_internal.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * A (client, nonce) pair hashes (keyed SipHash) to a shard (top 6 bits), a
+ * 32-bit fingerprint (low bits) and two candidate buckets. Pairs are filed
+ * by the epoch of the request timestamp, not of arrival: a replay carries
+ * the same signed timestamp, so it lands in the same epoch set as the
+ * original. Each shard keeps a ring of REPLAY_GENERATIONS sets, one per
+ * epoch modulo the ring size.
+ *
+ * A bucket is one cache line of sixteen 32-bit words: the stamp of the
+ * epoch it holds (epoch + 1, 0 = never used) and up to 15 fingerprints,
+ * filled in order. A bucket whose stamp is not the request's epoch is empty
+ * for that request and is cleared when a fingerprint is written to it, so
+ * moving to a new epoch touches nothing.
+ *
+ * Timestamps within window_ms of now span at most 9 epochs of window_ms / 4.
+ * A ring of 10 keeps those apart even when callers' clocks disagree by up
+ * to one epoch, and an epoch's buckets are only reused once its requests
+ * can no longer pass the timestamp check.
+ */
+#define REPLAY_SHARD_BITS 6
+#define REPLAY_SHARDS (1u << REPLAY_SHARD_BITS)
+
+#define REPLAY_EPOCHS_PER_WINDOW 4
+#define REPLAY_GENERATIONS 10
+#define REPLAY_BUCKET_WORDS 16      /* 16 x 4 bytes = one cache line */
+#define REPLAY_BUCKET_SLOTS (REPLAY_BUCKET_WORDS - 1)
+#define REPLAY_INDEX_BITS 26        /* Hash bits between fingerprint and shard */
+#define REPLAY_MIN_BUCKETS 2        /* Per shard and generation */
+
+typedef struct {
+    pthread_mutex_t lock AGLE_CACHE_ALIGNED;   /* One line per shard */
+    uint32_t *buckets;        /* 64-byte aligned, REPLAY_GENERATIONS x bucket_count */
+} replay_shard;
+
+struct AGLE_REPLAY_CACHE {
+    replay_shard shards[REPLAY_SHARDS];
+    size_t bucket_count;      /* Per shard and generation */
+    uint64_t window_ms;
+    uint64_t epoch_ms;
+    uint8_t client_key[AGLE_SIPHASH_KEY_LEN];
+    uint8_t nonce_key[AGLE_SIPHASH_KEY_LEN];
+};
+
+/* The client hash keys the nonce hash, so (client, nonce) splits are unambiguous */
+static uint64_t _pair_hash(const AGLE_REPLAY_CACHE *cache, const void *client,
+                           size_t client_len, const void *nonce, size_t nonce_len) {
+    uint64_t hc = agle_siphash24(cache->client_key, client, client_len);
+    uint8_t key[AGLE_SIPHASH_KEY_LEN];
+    memcpy(key, cache->nonce_key, sizeof(key));
+    for (int i = 0; i < 8; i++) {
+        key[i] ^= (uint8_t)(hc >> (8 * i));
+    }
+    return agle_siphash24(key, nonce, nonce_len);
+}
+
+/* Fingerprints in order from slot 1; the first 0 ends them */
+static bool _bucket_has(const uint32_t *bucket, uint32_t fp, unsigned *used) {
+    unsigned i = 1;
+    for (; i <= REPLAY_BUCKET_SLOTS && bucket[i] != 0; i++) {
+        if (bucket[i] == fp) return true;
+    }
+    *used = i - 1;
+    return false;
+}
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+AGLE_REPLAY_CACHE* AGLE_ReplayCacheNew(uint64_t window_ms, size_t expected_per_window) {
+    if (window_ms < REPLAY_EPOCHS_PER_WINDOW) return NULL;
+
+    /* Half-full buckets when an epoch receives its share of the window */
+    size_t per_epoch = expected_per_window / REPLAY_EPOCHS_PER_WINDOW + 1;
+    size_t bucket_count = per_epoch / (REPLAY_BUCKET_SLOTS / 2) / REPLAY_SHARDS + REPLAY_MIN_BUCKETS;
+    if (bucket_count > ((size_t)1 << REPLAY_INDEX_BITS)) return NULL;
+    size_t bytes = REPLAY_GENERATIONS * bucket_count * REPLAY_BUCKET_WORDS * sizeof(uint32_t);
+
+    AGLE_REPLAY_CACHE *cache = NULL;
+    if (posix_memalign((void **)&cache, 64, sizeof(*cache)) != 0) {
+        return NULL;
+    }
+    memset(cache, 0, sizeof(*cache));
+    cache->bucket_count = bucket_count;
+    cache->window_ms = window_ms;
+    cache->epoch_ms = window_ms / REPLAY_EPOCHS_PER_WINDOW;
+    if (!agle_siphash_key(cache->client_key) || !agle_siphash_key(cache->nonce_key)) {
+        free(cache);
+        return NULL;
+    }
+
+    for (size_t s = 0; s < REPLAY_SHARDS; s++) {
+        replay_shard *shard = &cache->shards[s];
+        if (posix_memalign((void **)&shard->buckets, 64, bytes) != 0) {
+            shard->buckets = NULL;
+            AGLE_ReplayCacheFree(cache);
+            return NULL;
+        }
+        memset(shard->buckets, 0, bytes);
+        if (pthread_mutex_init(&shard->lock, NULL) != 0) {
+            free(shard->buckets);
+            shard->buckets = NULL;
+            AGLE_ReplayCacheFree(cache);
+            return NULL;
+        }
+    }
+    return cache;
+}
+
+void AGLE_ReplayCacheFree(AGLE_REPLAY_CACHE *cache) {
+    if (cache == NULL) return;
+    for (size_t s = 0; s < REPLAY_SHARDS; s++) {
+        /* Shards are set up in order; the first without buckets ends them */
+        if (cache->shards[s].buckets == NULL) break;
+        pthread_mutex_destroy(&cache->shards[s].lock);
+        free(cache->shards[s].buckets);
+    }
+    free(cache);
+}
+
+AGLE_ReplayResult AGLE_ReplayCheck(AGLE_REPLAY_CACHE *cache, const void *client,
+                                   size_t client_len, const void *nonce, size_t nonce_len,
+                                   uint64_t timestamp_ms, uint64_t now_ms) {
+    if (cache == NULL || client == NULL || nonce == NULL || nonce_len == 0) {
+        return AGLE_REPLAY_STALE;
+    }
+    uint64_t skew = timestamp_ms > now_ms ? timestamp_ms - now_ms : now_ms - timestamp_ms;
+    if (skew > cache->window_ms) return AGLE_REPLAY_STALE;
+
+    uint64_t h = _pair_hash(cache, client, client_len, nonce, nonce_len);
+    uint32_t fp = (uint32_t)h;
+    if (fp == 0) fp = 1;
+
+    uint64_t epoch = timestamp_ms / cache->epoch_ms;
+    uint32_t stamp = (uint32_t)epoch + 1;
+    if (stamp == 0) stamp = 1;
+
+    /* First bucket from the index bits, a distinct second one from the fingerprint */
+    size_t n = cache->bucket_count;
+    uint64_t index = (h >> 32) & (((uint64_t)1 << REPLAY_INDEX_BITS) - 1);
+    size_t b1 = (size_t)((index * n) >> REPLAY_INDEX_BITS);
+    size_t b2 = (b1 + 1 + (size_t)(((uint64_t)(fp * 0x9e3779b1u) * (n - 1)) >> 32)) % n;
+
+    replay_shard *shard = &cache->shards[h >> (64 - REPLAY_SHARD_BITS)];
+    uint32_t *set = shard->buckets + (size_t)(epoch % REPLAY_GENERATIONS) * n * REPLAY_BUCKET_WORDS;
+    uint32_t *candidates[2] = { set + b1 * REPLAY_BUCKET_WORDS, set + b2 * REPLAY_BUCKET_WORDS };
+
+    pthread_mutex_lock(&shard->lock);
+    unsigned used[2];
+    bool usable[2];
+    for (int c = 0; c < 2; c++) {
+        uint32_t *bucket = candidates[c];
+        used[c] = 0;
+        if (bucket[0] == stamp) {
+            if (_bucket_has(bucket, fp, &used[c])) {
+                pthread_mutex_unlock(&shard->lock);
+                return AGLE_REPLAY_SEEN;
+            }
+            usable[c] = true;
+        } else {
+            /* Older epoch: free to clear. Newer: a caller's clock ran a
+             * full ring ahead; leave it alone. */
+            usable[c] = bucket[0] == 0 || (int32_t)(bucket[0] - stamp) < 0;
+        }
+    }
+
+    /* The emptier usable bucket takes the fingerprint */
+    int pick = -1;
+    for (int c = 0; c < 2; c++) {
+        if (usable[c] && used[c] < REPLAY_BUCKET_SLOTS &&
+            (pick < 0 || used[c] < used[pick])) {
+            pick = c;
+        }
+    }
+    AGLE_ReplayResult result = AGLE_REPLAY_FRESH;
+    if (pick < 0) {
+        result = usable[0] || usable[1] ? AGLE_REPLAY_FULL : AGLE_REPLAY_STALE;
+    } else {
+        uint32_t *bucket = candidates[pick];
+        if (bucket[0] != stamp) {
+            memset(bucket, 0, REPLAY_BUCKET_WORDS * sizeof(uint32_t));
+            bucket[0] = stamp;
+        }
+        bucket[1 + used[pick]] = fp;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return result;
+}
+
+size_t AGLE_ReplayCacheBytes(const AGLE_REPLAY_CACHE *cache) {
+    if (cache == NULL) return 0;
+    return sizeof(*cache) + REPLAY_SHARDS * REPLAY_GENERATIONS * cache->bucket_count *
+                            REPLAY_BUCKET_WORDS * sizeof(uint32_t);
+}
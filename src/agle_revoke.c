@@ -0,0 +1,432 @@
+/**
+ * @file agle_revoke.c
+ * @brief Revocation set: a line-local cuckoo filter in front of an exact table.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "agle_internal.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Ids hash (keyed SipHash) to a shard (top bits), a cache line of the
+ * shard's filter and a 16-bit fingerprint. A line holds 8 buckets of four
+ * fingerprints, one 64-bit word per bucket, and both candidate buckets of a
+ * fingerprint lie in the same line: a lookup reads one line and compares
+ * four fingerprints per word at once. Only when a fingerprint matches
+ * (about 8 in 65536 lookups at full load, or a revoked id) is the exact
+ * table consulted.
+ *
+ * The exact table holds a 128-bit keyed digest of every id (the filter hash
+ * plus a second SipHash under another key) with its expiry, 24 bytes per
+ * id. It is the source of truth: the filter is rebuilt from it when it
+ * grows, shrinks after a purge, or a line overflows during insertion.
+ */
+#define REVOKE_SHARD_BITS 4
+#define REVOKE_SHARDS (1u << REVOKE_SHARD_BITS)
+
+#define CF_LINE_BUCKETS 8         /* 8 x 8 bytes = one cache line */
+#define CF_TARGET_PER_LINE 8      /* Fingerprints per line after a rebuild */
+#define CF_MAX_PER_LINE 16        /* Grow past half full */
+#define CF_MAX_KICKS 32
+#define CF_LANES UINT64_C(0x0001000100010001)
+#define CF_HIGHS UINT64_C(0x8000800080008000)
+
+#define EXACT_MIN_SLOTS 16
+
+typedef struct {
+    uint64_t hash;            /* 0 = empty */
+    uint64_t check;
+    int64_t expires_at;
+} exact_entry;
+
+typedef struct {
+    pthread_rwlock_t lock AGLE_CACHE_ALIGNED;   /* One line per shard */
+    uint64_t *buckets;        /* 64-byte aligned, line_mask + 1 lines */
+    size_t line_mask;
+    exact_entry *entries;
+    size_t entry_mask;
+    size_t used;
+    int64_t next_expiry;      /* No entry expires before this */
+    bool stale;               /* Filter rebuild failed: lookups use the table */
+} revoke_shard;
+
+struct AGLE_REVOCATION_SET {
+    revoke_shard shards[REVOKE_SHARDS];
+    size_t count;             /* All shards; read without locks */
+    uint8_t sip_key[AGLE_SIPHASH_KEY_LEN];
+    uint8_t check_key[AGLE_SIPHASH_KEY_LEN];
+};
+
+typedef struct {
+    uint64_t hash;
+    uint64_t check;
+    size_t line;
+    unsigned bucket;
+    uint16_t fp;
+} revoke_key;
+
+static revoke_key _key_from_hash(uint64_t hash) {
+    revoke_key k;
+    k.hash = hash != 0 ? hash : 1;
+    k.fp = (uint16_t)k.hash;
+    if (k.fp == 0) k.fp = 1;               /* 0 marks an empty slot */
+    k.bucket = (unsigned)(k.hash >> 16) & (CF_LINE_BUCKETS - 1);
+    k.line = (size_t)(k.hash >> 19);       /* Masked per shard */
+    return k;
+}
+
+static revoke_key _key(const AGLE_REVOCATION_SET *set, const void *id, size_t id_len) {
+    revoke_key k = _key_from_hash(agle_siphash24(set->sip_key, id, id_len));
+    k.check = agle_siphash24(set->check_key, id, id_len);
+    return k;
+}
+
+static revoke_shard *_shard_for(AGLE_REVOCATION_SET *set, const revoke_key *k) {
+    return &set->shards[k->hash >> (64 - REVOKE_SHARD_BITS)];
+}
+
+/* ============================================================================
+ * Filter
+ * ============================================================================ */
+
+/* The other bucket of fp: an involution within the line, never the same bucket */
+static unsigned _cf_alt(unsigned bucket, uint16_t fp) {
+    return bucket ^ (1u + (((uint32_t)fp * 7u) >> 16));
+}
+
+static bool _cf_has(uint64_t word, uint16_t fp) {
+    uint64_t x = word ^ (fp * CF_LANES);
+    return ((x - CF_LANES) & ~x & CF_HIGHS) != 0;
+}
+
+static bool _cf_put(uint64_t *line, unsigned b, uint16_t fp) {
+    for (unsigned lane = 0; lane < 4; lane++) {
+        if (((line[b] >> (16 * lane)) & 0xffff) == 0) {
+            line[b] |= (uint64_t)fp << (16 * lane);
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool _cf_take(uint64_t *line, unsigned b, uint16_t fp) {
+    for (unsigned lane = 0; lane < 4; lane++) {
+        if (((line[b] >> (16 * lane)) & 0xffff) == fp) {
+            line[b] &= ~((uint64_t)0xffff << (16 * lane));
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Insert with cuckoo kicks confined to the line. On failure one fingerprint
+ * is left out, so the caller must rebuild the filter.
+ */
+static bool _cf_insert(revoke_shard *shard, const revoke_key *k) {
+    uint64_t *line = &shard->buckets[(k->line & shard->line_mask) * CF_LINE_BUCKETS];
+    uint16_t fp = k->fp;
+    unsigned b = k->bucket;
+    if (_cf_put(line, b, fp)) return true;
+    b = _cf_alt(b, fp);
+    if (_cf_put(line, b, fp)) return true;
+
+    for (unsigned kick = 0; kick < CF_MAX_KICKS; kick++) {
+        unsigned lane = (kick + fp) & 3;
+        uint16_t victim = (uint16_t)(line[b] >> (16 * lane));
+        line[b] = (line[b] & ~((uint64_t)0xffff << (16 * lane))) | ((uint64_t)fp << (16 * lane));
+        fp = victim;
+        b = _cf_alt(b, fp);
+        if (_cf_put(line, b, fp)) return true;
+    }
+    return false;
+}
+
+static bool _cf_maybe(const revoke_shard *shard, const revoke_key *k) {
+    const uint64_t *line = &shard->buckets[(k->line & shard->line_mask) * CF_LINE_BUCKETS];
+    return _cf_has(line[k->bucket], k->fp) || _cf_has(line[_cf_alt(k->bucket, k->fp)], k->fp);
+}
+
+/* ============================================================================
+ * Exact Table
+ * ============================================================================ */
+
+/* Slot index of the key, or -1. Caller holds the shard lock. */
+static ptrdiff_t _exact_find(const revoke_shard *shard, const revoke_key *k) {
+    size_t i = (size_t)k->hash & shard->entry_mask;
+    for (;;) {
+        const exact_entry *e = &shard->entries[i];
+        if (e->hash == 0) return -1;
+        if (e->hash == k->hash && e->check == k->check) {
+            return (ptrdiff_t)i;
+        }
+        i = (i + 1) & shard->entry_mask;
+    }
+}
+
+static void _exact_place(exact_entry *entries, size_t mask, const exact_entry *e) {
+    size_t i = (size_t)e->hash & mask;
+    while (entries[i].hash != 0) {
+        i = (i + 1) & mask;
+    }
+    entries[i] = *e;
+}
+
+/* Backward-shift deletion keeps linear probing free of tombstones */
+static void _exact_delete(revoke_shard *shard, size_t i) {
+    size_t mask = shard->entry_mask;
+    size_t j = i;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (shard->entries[j].hash == 0) break;
+        size_t home = (size_t)shard->entries[j].hash & mask;
+        /* Move j into the hole unless its home lies cyclically in (i, j] */
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            shard->entries[i] = shard->entries[j];
+            i = j;
+        }
+    }
+    memset(&shard->entries[i], 0, sizeof(shard->entries[i]));
+}
+
+/* ============================================================================
+ * Rebuild
+ * ============================================================================ */
+
+static size_t _lines_for(size_t items) {
+    size_t lines = 1;
+    while (lines * CF_TARGET_PER_LINE < items) {
+        lines <<= 1;
+    }
+    return lines;
+}
+
+/*
+ * Rebuild the shard keeping entries that expire after now, sized for at
+ * least room entries and min_lines filter lines. Caller holds the write lock.
+ * @return: Entries dropped, or (size_t)-1 on allocation failure (unchanged)
+ */
+static size_t _shard_rebuild(AGLE_REVOCATION_SET *set, revoke_shard *shard, int64_t now,
+                             size_t room, size_t min_lines) {
+    size_t old_slots = shard->entries != NULL ? shard->entry_mask + 1 : 0;
+    size_t live = 0;
+    for (size_t i = 0; i < old_slots; i++) {
+        live += shard->entries[i].hash != 0 && shard->entries[i].expires_at > now;
+    }
+    if (room < live) room = live;
+
+    size_t slots = EXACT_MIN_SLOTS;
+    while (slots < 2 * room) {
+        slots <<= 1;
+    }
+    size_t lines = _lines_for(room);
+    if (lines < min_lines) lines = min_lines;
+
+    exact_entry *entries = calloc(slots, sizeof(*entries));
+    if (entries == NULL) return (size_t)-1;
+
+    int64_t next_expiry = INT64_MAX;
+    for (size_t i = 0; i < old_slots; i++) {
+        const exact_entry *e = &shard->entries[i];
+        if (e->hash == 0 || e->expires_at <= now) continue;
+        _exact_place(entries, slots - 1, e);
+        if (e->expires_at < next_expiry) next_expiry = e->expires_at;
+    }
+
+    /* A line that still overflows doubles the filter again */
+    for (;;) {
+        uint64_t *buckets = NULL;
+        size_t bytes = lines * CF_LINE_BUCKETS * sizeof(uint64_t);
+        if (posix_memalign((void **)&buckets, 64, bytes) != 0) {
+            free(entries);
+            return (size_t)-1;
+        }
+        memset(buckets, 0, bytes);
+
+        revoke_shard probe = *shard;
+        probe.buckets = buckets;
+        probe.line_mask = lines - 1;
+        bool fits = true;
+        for (size_t i = 0; i < slots && fits; i++) {
+            if (entries[i].hash == 0) continue;
+            revoke_key k = _key_from_hash(entries[i].hash);
+            fits = _cf_insert(&probe, &k);
+        }
+        if (fits) {
+            size_t dropped = shard->used - live;
+            free(shard->buckets);
+            free(shard->entries);
+            shard->buckets = buckets;
+            shard->line_mask = lines - 1;
+            shard->entries = entries;
+            shard->entry_mask = slots - 1;
+            shard->used = live;
+            shard->next_expiry = next_expiry;
+            shard->stale = false;
+            __atomic_sub_fetch(&set->count, dropped, __ATOMIC_RELAXED);
+            return dropped;
+        }
+        free(buckets);
+        lines <<= 1;
+    }
+}
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+AGLE_REVOCATION_SET* AGLE_RevocationSetNew(void) {
+    AGLE_REVOCATION_SET *set = NULL;
+    if (posix_memalign((void **)&set, 64, sizeof(*set)) != 0) {
+        return NULL;
+    }
+    memset(set, 0, sizeof(*set));
+    if (!agle_siphash_key(set->sip_key) || !agle_siphash_key(set->check_key)) {
+        free(set);
+        return NULL;
+    }
+
+    for (size_t s = 0; s < REVOKE_SHARDS; s++) {
+        revoke_shard *shard = &set->shards[s];
+        shard->next_expiry = INT64_MAX;
+        if (pthread_rwlock_init(&shard->lock, NULL) != 0) {
+            while (s-- > 0) {
+                pthread_rwlock_destroy(&set->shards[s].lock);
+            }
+            free(set);
+            return NULL;
+        }
+    }
+    return set;
+}
+
+void AGLE_RevocationSetFree(AGLE_REVOCATION_SET *set) {
+    if (set == NULL) return;
+    for (size_t s = 0; s < REVOKE_SHARDS; s++) {
+        pthread_rwlock_destroy(&set->shards[s].lock);
+        free(set->shards[s].buckets);
+        free(set->shards[s].entries);
+    }
+    free(set);
+}
+
+bool AGLE_RevocationAdd(AGLE_REVOCATION_SET *set, const void *id, size_t id_len,
+                        int64_t expires_at) {
+    if (set == NULL || id == NULL || id_len == 0) return false;
+    revoke_key k = _key(set, id, id_len);
+    revoke_shard *shard = _shard_for(set, &k);
+    bool ok = true;
+
+    pthread_rwlock_wrlock(&shard->lock);
+    ptrdiff_t i = shard->entries != NULL ? _exact_find(shard, &k) : -1;
+    if (i >= 0) {
+        if (expires_at > shard->entries[i].expires_at) shard->entries[i].expires_at = expires_at;
+        pthread_rwlock_unlock(&shard->lock);
+        return true;
+    }
+
+    /* Keep the exact table under 3/4 full and the filter lines at most half */
+    size_t lines = shard->buckets != NULL ? shard->line_mask + 1 : 0;
+    if (shard->entries == NULL || 4 * (shard->used + 1) > 3 * (shard->entry_mask + 1) ||
+        shard->used + 1 > lines * CF_MAX_PER_LINE) {
+        ok = _shard_rebuild(set, shard, INT64_MIN, shard->used + 1, lines) != (size_t)-1;
+    }
+    if (ok) {
+        exact_entry e = { k.hash, k.check, expires_at };
+        _exact_place(shard->entries, shard->entry_mask, &e);
+        shard->used++;
+        if (expires_at < shard->next_expiry) shard->next_expiry = expires_at;
+        __atomic_add_fetch(&set->count, 1, __ATOMIC_RELEASE);
+
+        /*
+         * A failed insert leaves some fingerprint out: rebuild a larger
+         * filter from the table, or answer from the table until one fits.
+         */
+        if (shard->stale || !_cf_insert(shard, &k)) {
+            size_t more = 2 * (shard->line_mask + 1);
+            shard->stale = _shard_rebuild(set, shard, INT64_MIN, 0, more) == (size_t)-1;
+        }
+    }
+    pthread_rwlock_unlock(&shard->lock);
+    return ok;
+}
+
+bool AGLE_RevocationRemove(AGLE_REVOCATION_SET *set, const void *id, size_t id_len) {
+    if (set == NULL || id == NULL || id_len == 0) return false;
+    revoke_key k = _key(set, id, id_len);
+    revoke_shard *shard = _shard_for(set, &k);
+    bool removed = false;
+
+    pthread_rwlock_wrlock(&shard->lock);
+    ptrdiff_t i = shard->entries != NULL ? _exact_find(shard, &k) : -1;
+    if (i >= 0) {
+        uint64_t *line = &shard->buckets[(k.line & shard->line_mask) * CF_LINE_BUCKETS];
+        if (!_cf_take(line, k.bucket, k.fp)) {
+            _cf_take(line, _cf_alt(k.bucket, k.fp), k.fp);
+        }
+        _exact_delete(shard, (size_t)i);
+        shard->used--;
+        __atomic_sub_fetch(&set->count, 1, __ATOMIC_RELAXED);
+        removed = true;
+    }
+    pthread_rwlock_unlock(&shard->lock);
+    return removed;
+}
+
+bool AGLE_RevocationContains(AGLE_REVOCATION_SET *set, const void *id, size_t id_len) {
+    if (set == NULL || id == NULL || id_len == 0) return false;
+    if (__atomic_load_n(&set->count, __ATOMIC_ACQUIRE) == 0) return false;
+
+    revoke_key k = _key_from_hash(agle_siphash24(set->sip_key, id, id_len));
+    revoke_shard *shard = _shard_for(set, &k);
+    bool found = false;
+
+    pthread_rwlock_rdlock(&shard->lock);
+    if (shard->buckets != NULL && (shard->stale || _cf_maybe(shard, &k))) {
+        /* The second hash is only paid for on a fingerprint match */
+        k.check = agle_siphash24(set->check_key, id, id_len);
+        found = _exact_find(shard, &k) >= 0;
+    }
+    pthread_rwlock_unlock(&shard->lock);
+    return found;
+}
+
+size_t AGLE_RevocationPurge(AGLE_REVOCATION_SET *set, int64_t now) {
+    if (set == NULL) return 0;
+
+    size_t removed = 0;
+    for (size_t s = 0; s < REVOKE_SHARDS; s++) {
+        revoke_shard *shard = &set->shards[s];
+        pthread_rwlock_wrlock(&shard->lock);
+        if (shard->entries != NULL && shard->next_expiry <= now) {
+            size_t dropped = _shard_rebuild(set, shard, now, 0, 1);
+            if (dropped != (size_t)-1) removed += dropped;
+        }
+        pthread_rwlock_unlock(&shard->lock);
+    }
+    return removed;
+}
+
+size_t AGLE_RevocationCount(const AGLE_REVOCATION_SET *set) {
+    if (set == NULL) return 0;
+    return __atomic_load_n(&set->count, __ATOMIC_RELAXED);
+}
+
+size_t AGLE_RevocationSetBytes(AGLE_REVOCATION_SET *set) {
+    if (set == NULL) return 0;
+
+    size_t bytes = sizeof(*set);
+    for (size_t s = 0; s < REVOKE_SHARDS; s++) {
+        revoke_shard *shard = &set->shards[s];
+        pthread_rwlock_rdlock(&shard->lock);
+        if (shard->entries != NULL) {
+            bytes += (shard->line_mask + 1) * CF_LINE_BUCKETS * sizeof(uint64_t) +
+                     (shard->entry_mask + 1) * sizeof(exact_entry);
+        }
+        pthread_rwlock_unlock(&shard->lock);
+    }
+    return bytes;
+}
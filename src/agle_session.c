@@ -0,0 +1,717 @@
+/**
+ * @file agle_session.c
+ * @brief Lock-striped session table keyed by SHAKE256(token).
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "agle_internal.h"
+#include <openssl/crypto.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Each token is reduced to a 32-byte SHAKE256 digest. Its first 8 bytes
+ * select the shard (top bits) and the home slot (low bits); the next 8 are
+ * the probe tag. Probing reads only the dense tag array, so a lookup
+ * normally touches one tag line plus the single candidate slot, whose full
+ * digest is then compared in constant time.
+ */
+#define SESSION_DIGEST_LEN AGLE_SESSION_DIGEST_LEN
+#define SESSION_SHARD_BITS 6
+#define SESSION_SHARDS (1u << SESSION_SHARD_BITS)
+#define SESSION_MIN_SLOTS 16
+
+#define TAG_EMPTY 0
+#define TAG_DELETED 1
+
+/*
+ * Batch lookups hash a window of tokens, group them by shard and probe each
+ * group under one read lock. Within a group the home tag and slot of the
+ * key PREFETCH_AHEAD positions later are prefetched while the current key
+ * is probed, so the cache misses of consecutive lookups overlap instead of
+ * being paid one after another.
+ */
+#define SESSION_BATCH_WINDOW 256
+#define SESSION_PREFETCH_AHEAD 4
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SESSION_PREFETCH(p) __builtin_prefetch((p), 0, 1)
+#else
+#define SESSION_PREFETCH(p) ((void)(p))
+#endif
+
+/*
+ * Expiry runs on a hierarchical timing wheel with 1 s ticks: 4 levels of
+ * 64 buckets cover 64 s, ~68 min, ~3 days and ~194 days (later deadlines
+ * wait in the last level). Each entry is cascaded at most once per level,
+ * so a tick costs time proportional to what expires, not to the table size.
+ * Entries carry a digest copy rather than a slot index because rehashing
+ * moves slots; sessions removed early are simply skipped when their entry
+ * comes due.
+ */
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1u << WHEEL_BITS)
+#define WHEEL_LEVELS 4
+#define WHEEL_SPAN (INT64_C(1) << (WHEEL_BITS * WHEEL_LEVELS))
+
+typedef struct {
+    uint8_t digest[SESSION_DIGEST_LEN];
+    AGLE_SessionInfo info;
+} session_slot;
+
+typedef struct {
+    pthread_rwlock_t lock AGLE_CACHE_ALIGNED;   /* One line per shard */
+    uint64_t *tags;
+    session_slot *slots;
+    size_t mask;              /* Capacity - 1 (capacity is a power of two) */
+    size_t used;              /* Live sessions */
+    size_t deleted;           /* Tombstones, cleared on rehash */
+} session_shard;
+
+typedef struct {
+    uint8_t digest[SESSION_DIGEST_LEN];
+    int64_t created_at;       /* Only used to start the wheel */
+    int64_t expires_at;
+} wheel_entry;
+
+typedef struct {
+    wheel_entry *entries;
+    size_t len;
+    size_t cap;
+} wheel_bucket;
+
+typedef struct {
+    pthread_mutex_t lock;
+    bool started;
+    int64_t current;          /* Last tick processed */
+    wheel_bucket buckets[WHEEL_LEVELS][WHEEL_SLOTS];
+} timing_wheel;
+
+struct AGLE_SESSION_STORE {
+    session_shard shards[SESSION_SHARDS];
+    timing_wheel wheel;
+};
+
+typedef struct {
+    uint8_t digest[SESSION_DIGEST_LEN];
+    uint64_t hash;
+    uint64_t tag;
+} session_key;
+
+static uint64_t _le64(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+static void _key_from_digest(session_key *key) {
+    key->hash = _le64(key->digest);
+    key->tag = _le64(key->digest + 8);
+    if (key->tag < 2) key->tag += 2;   /* 0 and 1 mark empty/deleted slots */
+}
+
+/* Digest with a caller-owned context, reused across a batch */
+static bool _session_key_with(EVP_MD_CTX *mctx, const char *token, size_t token_len,
+                              session_key *key) {
+    if (!EVP_DigestInit_ex(mctx, agle_shake256_md(), NULL) ||
+        !EVP_DigestUpdate(mctx, token, token_len) ||
+        !EVP_DigestFinalXOF(mctx, key->digest, sizeof(key->digest))) {
+        return false;
+    }
+    _key_from_digest(key);
+    return true;
+}
+
+static bool _session_key(const char *token, size_t token_len, session_key *key) {
+    EVP_MD_CTX *mctx = EVP_MD_CTX_new();
+    if (mctx == NULL) return false;
+
+    bool result = _session_key_with(mctx, token, token_len, key);
+    EVP_MD_CTX_free(mctx);
+    return result;
+}
+
+static session_shard *_shard_for(AGLE_SESSION_STORE *store, const session_key *key) {
+    return &store->shards[key->hash >> (64 - SESSION_SHARD_BITS)];
+}
+
+/* Slot index of key, or -1. Caller holds the shard lock. */
+static ptrdiff_t _shard_find(const session_shard *shard, const session_key *key) {
+    size_t i = (size_t)key->hash & shard->mask;
+    for (;;) {
+        uint64_t tag = shard->tags[i];
+        if (tag == TAG_EMPTY) return -1;
+        if (tag == key->tag &&
+            CRYPTO_memcmp(shard->slots[i].digest, key->digest, SESSION_DIGEST_LEN) == 0) {
+            return (ptrdiff_t)i;
+        }
+        i = (i + 1) & shard->mask;
+    }
+}
+
+/* Pull the home tag and slot of key into cache. Caller holds the shard lock. */
+static void _shard_prefetch(const session_shard *shard, const session_key *key) {
+    size_t i = (size_t)key->hash & shard->mask;
+    SESSION_PREFETCH(&shard->tags[i]);
+    SESSION_PREFETCH(&shard->slots[i]);
+    SESSION_PREFETCH((const char *)&shard->slots[i] + sizeof(session_slot) - 1);
+}
+
+static bool _shard_alloc(session_shard *shard, size_t capacity) {
+    shard->tags = calloc(capacity, sizeof(*shard->tags));
+    shard->slots = calloc(capacity, sizeof(*shard->slots));
+    if (shard->tags == NULL || shard->slots == NULL) {
+        free(shard->tags);
+        free(shard->slots);
+        shard->tags = NULL;
+        shard->slots = NULL;
+        return false;
+    }
+    shard->mask = capacity - 1;
+    shard->deleted = 0;
+    return true;
+}
+
+static void _shard_release(uint64_t *tags, session_slot *slots, size_t capacity) {
+    if (slots != NULL) {
+        AGLE_SecureZero(slots, capacity * sizeof(*slots));
+    }
+    free(tags);
+    free(slots);
+}
+
+/* Rebuild into capacity slots, dropping tombstones. Caller holds the write lock. */
+static bool _shard_rehash(session_shard *shard, size_t capacity) {
+    session_shard old = *shard;
+
+    if (!_shard_alloc(shard, capacity)) {
+        *shard = old;
+        return false;
+    }
+
+    size_t live = 0;
+    for (size_t i = 0; i <= old.mask; i++) {
+        if (old.tags[i] < 2) continue;
+        size_t j = (size_t)_le64(old.slots[i].digest) & shard->mask;
+        while (shard->tags[j] != TAG_EMPTY) {
+            j = (j + 1) & shard->mask;
+        }
+        shard->tags[j] = old.tags[i];
+        shard->slots[j] = old.slots[i];
+        live++;
+    }
+    __atomic_store_n(&shard->used, live, __ATOMIC_RELAXED);
+
+    _shard_release(old.tags, old.slots, old.mask + 1);
+    return true;
+}
+
+/* Slot i becomes a tombstone. Caller holds the write lock. */
+static void _shard_erase(session_shard *shard, size_t i) {
+    AGLE_SecureZero(&shard->slots[i], sizeof(shard->slots[i]));
+    shard->tags[i] = TAG_DELETED;
+    __atomic_store_n(&shard->used, shard->used - 1, __ATOMIC_RELAXED);
+    shard->deleted++;
+}
+
+/* ============================================================================
+ * Timing Wheel
+ * ============================================================================ */
+
+static bool _bucket_push(wheel_bucket *bucket, const wheel_entry *entry) {
+    if (bucket->len == bucket->cap) {
+        size_t cap = bucket->cap ? bucket->cap * 2 : 16;
+        wheel_entry *grown = realloc(bucket->entries, cap * sizeof(*grown));
+        if (grown == NULL) return false;
+        bucket->entries = grown;
+        bucket->cap = cap;
+    }
+    bucket->entries[bucket->len++] = *entry;
+    return true;
+}
+
+static void _bucket_free(wheel_bucket *bucket) {
+    if (bucket->entries != NULL) {
+        AGLE_SecureZero(bucket->entries, bucket->cap * sizeof(*bucket->entries));
+    }
+    free(bucket->entries);
+    memset(bucket, 0, sizeof(*bucket));
+}
+
+/* Bucket for a deadline relative to wheel->current. Caller holds the lock. */
+static wheel_bucket *_wheel_bucket_for(timing_wheel *wheel, int64_t expires_at) {
+    int64_t at = expires_at > wheel->current ? expires_at : wheel->current + 1;
+    uint64_t delta = (uint64_t)(at - wheel->current);
+
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        if (delta < (UINT64_C(1) << (WHEEL_BITS * (level + 1))) || level == WHEEL_LEVELS - 1) {
+            if (level == WHEEL_LEVELS - 1 && delta >> (WHEEL_BITS * WHEEL_LEVELS)) {
+                /* Beyond the wheel: park in the furthest bucket, re-placed on cascade */
+                at = wheel->current + WHEEL_SPAN - 1;
+            }
+            size_t slot = (size_t)((uint64_t)at >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1);
+            return &wheel->buckets[level][slot];
+        }
+    }
+    return NULL;
+}
+
+static bool _wheel_add(timing_wheel *wheel, const wheel_entry *entry) {
+    pthread_mutex_lock(&wheel->lock);
+    if (!wheel->started) {
+        /* No clock yet: start at the creation time; AGLE_SessionStoreTick rebases */
+        wheel->current = entry->created_at < entry->expires_at ?
+                         entry->created_at : entry->expires_at - 1;
+        wheel->started = true;
+    }
+    bool ok = _bucket_push(_wheel_bucket_for(wheel, entry->expires_at), entry);
+    pthread_mutex_unlock(&wheel->lock);
+    return ok;
+}
+
+/*
+ * Advance to tick t: cascade the higher-level buckets that start at t, then
+ * move the level-0 bucket for t into due. Caller holds the lock.
+ */
+static bool _wheel_step(timing_wheel *wheel, int64_t t, wheel_bucket *due) {
+    wheel->current = t;
+
+    for (int level = WHEEL_LEVELS - 1; level > 0; level--) {
+        if (((uint64_t)t & ((UINT64_C(1) << (WHEEL_BITS * level)) - 1)) != 0) continue;
+
+        size_t slot = (size_t)((uint64_t)t >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1);
+        wheel_bucket moving = wheel->buckets[level][slot];
+        memset(&wheel->buckets[level][slot], 0, sizeof(moving));
+
+        for (size_t i = 0; i < moving.len; i++) {
+            wheel_bucket *to = moving.entries[i].expires_at <= t ? due :
+                               _wheel_bucket_for(wheel, moving.entries[i].expires_at);
+            if (!_bucket_push(to, &moving.entries[i])) {
+                /* Keep the rest in place and retry this tick next time */
+                for (; i < moving.len; i++) {
+                    _bucket_push(&wheel->buckets[level][slot], &moving.entries[i]);
+                }
+                _bucket_free(&moving);
+                wheel->current = t - 1;
+                return false;
+            }
+        }
+        _bucket_free(&moving);
+    }
+
+    wheel_bucket *expiring = &wheel->buckets[0][(size_t)t & (WHEEL_SLOTS - 1)];
+    for (size_t i = 0; i < expiring->len; i++) {
+        if (!_bucket_push(due, &expiring->entries[i])) return false;
+    }
+    expiring->len = 0;
+    return true;
+}
+
+/*
+ * Re-place every entry relative to now. Used when the clock jumps further
+ * than the wheel span (first tick, suspend), where stepping would be slow.
+ * Caller holds the lock.
+ */
+static void _wheel_rebase(timing_wheel *wheel, int64_t now, wheel_bucket *due) {
+    wheel_bucket all = {0};
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        for (size_t slot = 0; slot < WHEEL_SLOTS; slot++) {
+            wheel_bucket *bucket = &wheel->buckets[level][slot];
+            for (size_t i = 0; i < bucket->len; i++) {
+                _bucket_push(&all, &bucket->entries[i]);
+            }
+            _bucket_free(bucket);
+        }
+    }
+
+    wheel->current = now;
+    for (size_t i = 0; i < all.len; i++) {
+        wheel_bucket *to = all.entries[i].expires_at <= now ? due :
+                           _wheel_bucket_for(wheel, all.entries[i].expires_at);
+        _bucket_push(to, &all.entries[i]);
+    }
+    _bucket_free(&all);
+}
+
+static void _wheel_free(timing_wheel *wheel) {
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        for (size_t slot = 0; slot < WHEEL_SLOTS; slot++) {
+            _bucket_free(&wheel->buckets[level][slot]);
+        }
+    }
+    pthread_mutex_destroy(&wheel->lock);
+}
+
+/* ============================================================================
+ * Session Store API
+ * ============================================================================ */
+
+AGLE_SESSION_STORE* AGLE_SessionStoreNew(size_t expected_sessions) {
+    AGLE_SESSION_STORE *store = NULL;
+    if (posix_memalign((void **)&store, 64, sizeof(*store)) != 0) {
+        return NULL;
+    }
+    memset(store, 0, sizeof(*store));
+    if (pthread_mutex_init(&store->wheel.lock, NULL) != 0) {
+        free(store);
+        return NULL;
+    }
+
+    /* Keep the initial load under 3/4 */
+    size_t per_shard = expected_sessions / SESSION_SHARDS + 1;
+    size_t capacity = SESSION_MIN_SLOTS;
+    while (capacity * 3 < per_shard * 4) {
+        capacity <<= 1;
+    }
+
+    for (size_t s = 0; s < SESSION_SHARDS; s++) {
+        session_shard *shard = &store->shards[s];
+        bool locked = pthread_rwlock_init(&shard->lock, NULL) == 0;
+        if (!locked || !_shard_alloc(shard, capacity)) {
+            if (locked) pthread_rwlock_destroy(&shard->lock);
+            while (s-- > 0) {
+                pthread_rwlock_destroy(&store->shards[s].lock);
+                _shard_release(store->shards[s].tags, store->shards[s].slots,
+                               store->shards[s].mask + 1);
+            }
+            pthread_mutex_destroy(&store->wheel.lock);
+            free(store);
+            return NULL;
+        }
+    }
+    return store;
+}
+
+void AGLE_SessionStoreFree(AGLE_SESSION_STORE *store) {
+    if (store == NULL) return;
+
+    for (size_t s = 0; s < SESSION_SHARDS; s++) {
+        session_shard *shard = &store->shards[s];
+        pthread_rwlock_destroy(&shard->lock);
+        _shard_release(shard->tags, shard->slots, shard->mask + 1);
+    }
+    _wheel_free(&store->wheel);
+    free(store);
+}
+
+static bool _remove_key(AGLE_SESSION_STORE *store, const session_key *key,
+                        AGLE_SessionInfo *out) {
+    session_shard *shard = _shard_for(store, key);
+    bool removed = false;
+    pthread_rwlock_wrlock(&shard->lock);
+
+    ptrdiff_t i = _shard_find(shard, key);
+    if (i >= 0) {
+        if (out != NULL) *out = shard->slots[i].info;
+        _shard_erase(shard, (size_t)i);
+        removed = true;
+    }
+
+    pthread_rwlock_unlock(&shard->lock);
+    return removed;
+}
+
+static bool _insert_key(AGLE_SESSION_STORE *store, const session_key *key,
+                        const AGLE_SessionInfo *info) {
+    session_shard *shard = _shard_for(store, key);
+    bool result = false;
+    pthread_rwlock_wrlock(&shard->lock);
+
+    /* Grow at 3/4 load; if most of the load is tombstones, rebuild in place */
+    size_t capacity = shard->mask + 1;
+    if ((shard->used + shard->deleted + 1) * 4 > capacity * 3) {
+        size_t target = (shard->used + 1) * 2 > capacity ? capacity * 2 : capacity;
+        if (!_shard_rehash(shard, target)) goto done;
+    }
+
+    if (_shard_find(shard, key) >= 0) goto done;
+
+    size_t i = (size_t)key->hash & shard->mask;
+    while (shard->tags[i] >= 2) {
+        i = (i + 1) & shard->mask;
+    }
+    if (shard->tags[i] == TAG_DELETED) shard->deleted--;
+
+    memcpy(shard->slots[i].digest, key->digest, SESSION_DIGEST_LEN);
+    shard->slots[i].info = *info;
+    shard->slots[i].info.username[AGLE_SESSION_USERNAME_MAX - 1] = '\0';
+    shard->tags[i] = key->tag;
+    __atomic_store_n(&shard->used, shard->used + 1, __ATOMIC_RELAXED);
+    result = true;
+
+done:
+    pthread_rwlock_unlock(&shard->lock);
+
+    /* Scheduled outside the shard lock; the two locks are never nested */
+    if (result) {
+        wheel_entry entry;
+        memcpy(entry.digest, key->digest, SESSION_DIGEST_LEN);
+        entry.created_at = info->created_at;
+        entry.expires_at = info->expires_at;
+        if (!_wheel_add(&store->wheel, &entry)) {
+            _remove_key(store, key, NULL);
+            result = false;
+        }
+        AGLE_SecureZero(&entry, sizeof(entry));
+    }
+    return result;
+}
+
+bool AGLE_SessionInsert(AGLE_SESSION_STORE *store, const char *token, size_t token_len,
+                        const AGLE_SessionInfo *info) {
+    if (store == NULL || token == NULL || token_len == 0 || info == NULL) return false;
+
+    session_key key;
+    if (!_session_key(token, token_len, &key)) return false;
+
+    bool result = _insert_key(store, &key, info);
+    AGLE_SecureZero(&key, sizeof(key));
+    return result;
+}
+
+bool AGLE_SessionLookup(AGLE_SESSION_STORE *store, const char *token, size_t token_len,
+                        int64_t now, AGLE_SessionInfo *out) {
+    if (store == NULL || token == NULL || token_len == 0) return false;
+
+    session_key key;
+    if (!_session_key(token, token_len, &key)) return false;
+
+    session_shard *shard = _shard_for(store, &key);
+    bool found = false;
+    pthread_rwlock_rdlock(&shard->lock);
+
+    ptrdiff_t i = _shard_find(shard, &key);
+    if (i >= 0 && shard->slots[i].info.expires_at > now) {
+        if (out != NULL) *out = shard->slots[i].info;
+        found = true;
+    }
+
+    pthread_rwlock_unlock(&shard->lock);
+    AGLE_SecureZero(&key, sizeof(key));
+    return found;
+}
+
+/* Probe one shard's group of keys under a single read lock */
+static size_t _lookup_group(session_shard *shard, const session_key *keys,
+                            const uint16_t *group, size_t n, int64_t now,
+                            AGLE_SessionInfo *out, bool *found, size_t base) {
+    size_t hits = 0;
+    pthread_rwlock_rdlock(&shard->lock);
+
+    for (size_t j = 0; j < n && j < SESSION_PREFETCH_AHEAD; j++) {
+        _shard_prefetch(shard, &keys[group[j]]);
+    }
+    for (size_t j = 0; j < n; j++) {
+        if (j + SESSION_PREFETCH_AHEAD < n) {
+            _shard_prefetch(shard, &keys[group[j + SESSION_PREFETCH_AHEAD]]);
+        }
+        size_t k = group[j];
+        ptrdiff_t i = _shard_find(shard, &keys[k]);
+        if (i >= 0 && shard->slots[i].info.expires_at > now) {
+            if (out != NULL) out[base + k] = shard->slots[i].info;
+            found[base + k] = true;
+            hits++;
+        }
+    }
+
+    pthread_rwlock_unlock(&shard->lock);
+    return hits;
+}
+
+size_t AGLE_SessionLookupBatch(AGLE_SESSION_STORE *store, const char *const *tokens,
+                               const size_t *token_lens, size_t count, int64_t now,
+                               AGLE_SessionInfo *out, bool *found) {
+    if (found == NULL) return 0;
+    memset(found, 0, count * sizeof(*found));
+    if (out != NULL) memset(out, 0, count * sizeof(*out));
+    if (store == NULL || tokens == NULL || token_lens == NULL || count == 0) return 0;
+
+    session_key *keys = malloc(SESSION_BATCH_WINDOW * sizeof(*keys));
+    uint16_t *order = malloc(SESSION_BATCH_WINDOW * sizeof(*order));
+    EVP_MD_CTX *mctx = EVP_MD_CTX_new();
+    size_t hits = 0;
+    if (keys == NULL || order == NULL || mctx == NULL) goto done;
+
+    for (size_t base = 0; base < count; base += SESSION_BATCH_WINDOW) {
+        size_t n = count - base < SESSION_BATCH_WINDOW ? count - base : SESSION_BATCH_WINDOW;
+
+        /* Hash the window, then counting-sort the valid keys by shard */
+        uint16_t start[SESSION_SHARDS + 1] = {0};
+        uint8_t shard_of[SESSION_BATCH_WINDOW];
+        bool valid[SESSION_BATCH_WINDOW];
+        for (size_t k = 0; k < n; k++) {
+            const char *token = tokens[base + k];
+            size_t len = token_lens[base + k];
+            valid[k] = token != NULL && len > 0 &&
+                       _session_key_with(mctx, token, len, &keys[k]);
+            if (!valid[k]) continue;
+            shard_of[k] = (uint8_t)(keys[k].hash >> (64 - SESSION_SHARD_BITS));
+            start[shard_of[k] + 1]++;
+        }
+        for (size_t s = 0; s < SESSION_SHARDS; s++) {
+            start[s + 1] = (uint16_t)(start[s + 1] + start[s]);
+        }
+        uint16_t next[SESSION_SHARDS];
+        memcpy(next, start, sizeof(next));
+        for (size_t k = 0; k < n; k++) {
+            if (valid[k]) order[next[shard_of[k]]++] = (uint16_t)k;
+        }
+
+        for (size_t s = 0; s < SESSION_SHARDS; s++) {
+            size_t group_len = (size_t)(start[s + 1] - start[s]);
+            if (group_len == 0) continue;
+            hits += _lookup_group(&store->shards[s], keys, order + start[s], group_len,
+                                  now, out, found, base);
+        }
+    }
+
+done:
+    if (keys != NULL) AGLE_SecureZero(keys, SESSION_BATCH_WINDOW * sizeof(*keys));
+    free(keys);
+    free(order);
+    EVP_MD_CTX_free(mctx);
+    return hits;
+}
+
+bool AGLE_SessionRemove(AGLE_SESSION_STORE *store, const char *token, size_t token_len,
+                        AGLE_SessionInfo *out) {
+    if (store == NULL || token == NULL || token_len == 0) return false;
+
+    session_key key;
+    if (!_session_key(token, token_len, &key)) return false;
+
+    bool removed = _remove_key(store, &key, out);
+    AGLE_SecureZero(&key, sizeof(key));
+    return removed;
+}
+
+size_t AGLE_SessionStorePurge(AGLE_SESSION_STORE *store, int64_t now) {
+    if (store == NULL) return 0;
+
+    size_t removed = 0;
+    for (size_t s = 0; s < SESSION_SHARDS; s++) {
+        session_shard *shard = &store->shards[s];
+        pthread_rwlock_wrlock(&shard->lock);
+        for (size_t i = 0; i <= shard->mask; i++) {
+            if (shard->tags[i] >= 2 && shard->slots[i].info.expires_at <= now) {
+                _shard_erase(shard, i);
+                removed++;
+            }
+        }
+        pthread_rwlock_unlock(&shard->lock);
+    }
+    return removed;
+}
+
+size_t AGLE_SessionStoreTick(AGLE_SESSION_STORE *store, int64_t now) {
+    if (store == NULL) return 0;
+
+    timing_wheel *wheel = &store->wheel;
+    wheel_bucket due = {0};
+
+    pthread_mutex_lock(&wheel->lock);
+    if (!wheel->started) {
+        wheel->current = now;
+        wheel->started = true;
+    }
+    if (now - wheel->current > WHEEL_SPAN) {
+        _wheel_rebase(wheel, now, &due);
+    }
+    while (wheel->current < now) {
+        if (!_wheel_step(wheel, wheel->current + 1, &due)) break;
+    }
+    pthread_mutex_unlock(&wheel->lock);
+
+    /* Remove outside the wheel lock, one shard lock at a time */
+    size_t removed = 0;
+    for (size_t e = 0; e < due.len; e++) {
+        session_key key;
+        memcpy(key.digest, due.entries[e].digest, SESSION_DIGEST_LEN);
+        _key_from_digest(&key);
+
+        session_shard *shard = _shard_for(store, &key);
+        pthread_rwlock_wrlock(&shard->lock);
+        ptrdiff_t i = _shard_find(shard, &key);
+        if (i >= 0 && shard->slots[i].info.expires_at <= now) {
+            _shard_erase(shard, (size_t)i);
+            removed++;
+        }
+        pthread_rwlock_unlock(&shard->lock);
+    }
+
+    _bucket_free(&due);
+    return removed;
+}
+
+size_t AGLE_SessionStoreCount(const AGLE_SESSION_STORE *store) {
+    if (store == NULL) return 0;
+
+    size_t count = 0;
+    for (size_t s = 0; s < SESSION_SHARDS; s++) {
+        count += __atomic_load_n(&store->shards[s].used, __ATOMIC_RELAXED);
+    }
+    return count;
+}
+
+size_t AGLE_SessionStoreCapacity(const AGLE_SESSION_STORE *store) {
+    if (store == NULL) return 0;
+
+    size_t slots = 0;
+    for (size_t s = 0; s < SESSION_SHARDS; s++) {
+        slots += __atomic_load_n(&store->shards[s].mask, __ATOMIC_RELAXED) + 1;
+    }
+    return slots;
+}
+
+/* ============================================================================
+ * Internal Interface (persistence)
+ * ============================================================================ */
+
+bool agle_session_digest(const char *token, size_t token_len,
+                         uint8_t digest[AGLE_SESSION_DIGEST_LEN]) {
+    session_key key;
+    if (!_session_key(token, token_len, &key)) return false;
+    memcpy(digest, key.digest, SESSION_DIGEST_LEN);
+    AGLE_SecureZero(&key, sizeof(key));
+    return true;
+}
+
+bool agle_session_insert_digest(AGLE_SESSION_STORE *store,
+                                const uint8_t digest[AGLE_SESSION_DIGEST_LEN],
+                                const AGLE_SessionInfo *info) {
+    session_key key;
+    memcpy(key.digest, digest, SESSION_DIGEST_LEN);
+    _key_from_digest(&key);
+    return _insert_key(store, &key, info);
+}
+
+bool agle_session_remove_digest(AGLE_SESSION_STORE *store,
+                                const uint8_t digest[AGLE_SESSION_DIGEST_LEN]) {
+    session_key key;
+    memcpy(key.digest, digest, SESSION_DIGEST_LEN);
+    _key_from_digest(&key);
+    return _remove_key(store, &key, NULL);
+}
+
+bool agle_session_foreach(AGLE_SESSION_STORE *store, int64_t now,
+                          bool (*fn)(void *arg, const uint8_t *digest,
+                                     const AGLE_SessionInfo *info),
+                          void *arg) {
+    for (size_t s = 0; s < SESSION_SHARDS; s++) {
+        session_shard *shard = &store->shards[s];
+        bool ok = true;
+        pthread_rwlock_rdlock(&shard->lock);
+        for (size_t i = 0; i <= shard->mask && ok; i++) {
+            if (shard->tags[i] >= 2 && shard->slots[i].info.expires_at > now) {
+                ok = fn(arg, shard->slots[i].digest, &shard->slots[i].info);
+            }
+        }
+        pthread_rwlock_unlock(&shard->lock);
+        if (!ok) return false;
+    }
+    return true;
+}
@@ -0,0 +1,307 @@
+/**
+ * @file agle_token.c
+ * @brief Stateless session tokens authenticated with KMAC256.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "agle_internal.h"
+#include <openssl/core_names.h>
+#include <openssl/crypto.h>
+#include <openssl/params.h>
+#include <openssl/rand.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Payload (little-endian): key_id u32 | user_id u32 | expires_at i64 |
+ * token_id u64, followed by a 16-byte KMAC256 tag. The customization string
+ * binds the tag to this format, so a key shared with another KMAC use
+ * cannot produce valid tokens.
+ */
+#define TOKEN_PAYLOAD_LEN 24
+#define TOKEN_TAG_LEN 16
+#define TOKEN_RAW_LEN (TOKEN_PAYLOAD_LEN + TOKEN_TAG_LEN)
+#define TOKEN_PREFIX_LEN (sizeof(AGLE_SIGNED_TOKEN_PREFIX) - 1)
+#define TOKEN_B64_LEN (AGLE_SIGNED_TOKEN_LEN - TOKEN_PREFIX_LEN)
+#define TOKEN_CUSTOM "AGLE signed token v1"
+#define TOKEN_MIN_KEY 16
+#define TOKEN_MAX_KEY 64
+
+typedef struct {
+    uint32_t key_id;
+    EVP_MAC_CTX *schedule;    /* Initialized with the key; duplicated per call */
+} token_key;
+
+struct AGLE_TOKEN_SIGNER {
+    EVP_MAC *mac;
+    token_key keys[AGLE_SIGNED_TOKEN_MAX_KEYS];
+    size_t key_count;
+    size_t active;            /* Index of the signing key */
+    AGLE_REVOCATION_SET *revoked;
+};
+
+/* ============================================================================
+ * Encoding
+ * ============================================================================ */
+
+static const char B64URL[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+static void _put_le(uint8_t *p, uint64_t v, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static uint64_t _get_le(const uint8_t *p, size_t n) {
+    uint64_t v = 0;
+    for (size_t i = n; i > 0; i--) {
+        v = (v << 8) | p[i - 1];
+    }
+    return v;
+}
+
+/* Unpadded base64url; out must hold 4 * ceil(len / 3) characters */
+static size_t _b64_encode(const uint8_t *in, size_t len, char *out) {
+    size_t o = 0;
+    size_t i = 0;
+    for (; i + 3 <= len; i += 3) {
+        uint32_t v = ((uint32_t)in[i] << 16) | ((uint32_t)in[i + 1] << 8) | in[i + 2];
+        out[o++] = B64URL[v >> 18];
+        out[o++] = B64URL[(v >> 12) & 63];
+        out[o++] = B64URL[(v >> 6) & 63];
+        out[o++] = B64URL[v & 63];
+    }
+    if (len - i == 1) {
+        uint32_t v = (uint32_t)in[i] << 16;
+        out[o++] = B64URL[v >> 18];
+        out[o++] = B64URL[(v >> 12) & 63];
+    } else if (len - i == 2) {
+        uint32_t v = ((uint32_t)in[i] << 16) | ((uint32_t)in[i + 1] << 8);
+        out[o++] = B64URL[v >> 18];
+        out[o++] = B64URL[(v >> 12) & 63];
+        out[o++] = B64URL[(v >> 6) & 63];
+    }
+    return o;
+}
+
+static int _b64_value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '-') return 62;
+    if (c == '_') return 63;
+    return -1;
+}
+
+/*
+ * Decode exactly out_len bytes from the canonical encoding: unused low bits
+ * of the last character must be zero, so each token has one spelling.
+ */
+static bool _b64_decode(const char *in, size_t in_len, uint8_t *out, size_t out_len) {
+    uint32_t acc = 0;
+    int bits = 0;
+    size_t o = 0;
+    for (size_t i = 0; i < in_len; i++) {
+        int v = _b64_value(in[i]);
+        if (v < 0) return false;
+        acc = (acc << 6) | (uint32_t)v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            if (o == out_len) return false;
+            out[o++] = (uint8_t)(acc >> bits);
+        }
+        acc &= (1u << bits) - 1;
+    }
+    return o == out_len && acc == 0;
+}
+
+/* ============================================================================
+ * KMAC
+ * ============================================================================ */
+
+static EVP_MAC_CTX *_schedule_new(EVP_MAC *mac, const uint8_t *key, size_t key_len) {
+    EVP_MAC_CTX *schedule = EVP_MAC_CTX_new(mac);
+    if (schedule == NULL) return NULL;
+
+    size_t tag_len = TOKEN_TAG_LEN;
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_CUSTOM, (void *)TOKEN_CUSTOM,
+                                          sizeof(TOKEN_CUSTOM) - 1),
+        OSSL_PARAM_construct_size_t(OSSL_MAC_PARAM_SIZE, &tag_len),
+        OSSL_PARAM_construct_end()
+    };
+    /* Absorbs the customization and the padded key: the part worth reusing */
+    if (!EVP_MAC_init(schedule, key, key_len, params)) {
+        EVP_MAC_CTX_free(schedule);
+        return NULL;
+    }
+    return schedule;
+}
+
+static bool _tag(const token_key *k, const uint8_t payload[TOKEN_PAYLOAD_LEN],
+                 uint8_t tag[TOKEN_TAG_LEN]) {
+    EVP_MAC_CTX *mctx = EVP_MAC_CTX_dup(k->schedule);
+    if (mctx == NULL) return false;
+
+    size_t out_len = 0;
+    bool ok = EVP_MAC_update(mctx, payload, TOKEN_PAYLOAD_LEN) &&
+              EVP_MAC_final(mctx, tag, &out_len, TOKEN_TAG_LEN) &&
+              out_len == TOKEN_TAG_LEN;
+    EVP_MAC_CTX_free(mctx);
+    return ok;
+}
+
+static const token_key *_find_key(const AGLE_TOKEN_SIGNER *signer, uint32_t key_id) {
+    for (size_t i = 0; i < signer->key_count; i++) {
+        if (signer->keys[i].key_id == key_id) return &signer->keys[i];
+    }
+    return NULL;
+}
+
+static bool _revoked(AGLE_TOKEN_SIGNER *signer, uint64_t token_id) {
+    uint8_t id[8];
+    _put_le(id, token_id, sizeof(id));
+    return AGLE_RevocationContains(signer->revoked, id, sizeof(id));
+}
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+AGLE_TOKEN_SIGNER* AGLE_TokenSignerNew(uint32_t key_id, const uint8_t *key, size_t key_len) {
+    AGLE_TOKEN_SIGNER *signer = calloc(1, sizeof(*signer));
+    if (signer == NULL) return NULL;
+
+    signer->mac = EVP_MAC_fetch(NULL, "KMAC256", NULL);
+    signer->revoked = AGLE_RevocationSetNew();
+    if (signer->mac == NULL || signer->revoked == NULL) {
+        AGLE_TokenSignerFree(signer);
+        return NULL;
+    }
+
+    uint8_t random_key[AGLE_SIGNED_TOKEN_KEY_LEN];
+    if (key == NULL) {
+        if (RAND_bytes(random_key, sizeof(random_key)) != 1) {
+            AGLE_TokenSignerFree(signer);
+            return NULL;
+        }
+        key = random_key;
+        key_len = sizeof(random_key);
+    }
+    bool ok = AGLE_TokenSignerAddKey(signer, key_id, key, key_len);
+    AGLE_SecureZero(random_key, sizeof(random_key));
+    if (!ok) {
+        AGLE_TokenSignerFree(signer);
+        return NULL;
+    }
+    return signer;
+}
+
+void AGLE_TokenSignerFree(AGLE_TOKEN_SIGNER *signer) {
+    if (signer == NULL) return;
+    /* EVP_MAC_CTX_free cleanses the absorbed key state */
+    for (size_t i = 0; i < signer->key_count; i++) {
+        EVP_MAC_CTX_free(signer->keys[i].schedule);
+    }
+    EVP_MAC_free(signer->mac);
+    AGLE_RevocationSetFree(signer->revoked);
+    free(signer);
+}
+
+bool AGLE_TokenSignerAddKey(AGLE_TOKEN_SIGNER *signer, uint32_t key_id,
+                            const uint8_t *key, size_t key_len) {
+    if (signer == NULL || key == NULL) return false;
+    if (key_len < TOKEN_MIN_KEY || key_len > TOKEN_MAX_KEY) return false;
+    if (signer->key_count == AGLE_SIGNED_TOKEN_MAX_KEYS) return false;
+    if (_find_key(signer, key_id) != NULL) return false;
+
+    EVP_MAC_CTX *schedule = _schedule_new(signer->mac, key, key_len);
+    if (schedule == NULL) return false;
+
+    signer->keys[signer->key_count].key_id = key_id;
+    signer->keys[signer->key_count].schedule = schedule;
+    signer->active = signer->key_count++;
+    return true;
+}
+
+bool AGLE_TokenIssue(AGLE_TOKEN_SIGNER *signer, AGLE_CTX *ctx, uint32_t user_id,
+                     int64_t expires_at, char *token, AGLE_TokenClaims *claims) {
+    if (signer == NULL || ctx == NULL || token == NULL) return false;
+
+    AGLE_TokenClaims c;
+    c.key_id = signer->keys[signer->active].key_id;
+    c.user_id = user_id;
+    c.expires_at = expires_at;
+    do {
+        if (!AGLE_GetRandom64(ctx, &c.token_id)) return false;
+    } while (c.token_id == 0);
+
+    uint8_t raw[TOKEN_RAW_LEN];
+    _put_le(raw, c.key_id, 4);
+    _put_le(raw + 4, c.user_id, 4);
+    _put_le(raw + 8, (uint64_t)c.expires_at, 8);
+    _put_le(raw + 16, c.token_id, 8);
+    if (!_tag(&signer->keys[signer->active], raw, raw + TOKEN_PAYLOAD_LEN)) {
+        return false;
+    }
+
+    memcpy(token, AGLE_SIGNED_TOKEN_PREFIX, TOKEN_PREFIX_LEN);
+    _b64_encode(raw, sizeof(raw), token + TOKEN_PREFIX_LEN);
+    token[AGLE_SIGNED_TOKEN_LEN] = '\0';
+
+    if (claims != NULL) *claims = c;
+    return true;
+}
+
+bool AGLE_TokenVerify(AGLE_TOKEN_SIGNER *signer, const char *token, size_t token_len,
+                      int64_t now, AGLE_TokenClaims *claims) {
+    if (signer == NULL || token == NULL) return false;
+    if (token_len != AGLE_SIGNED_TOKEN_LEN ||
+        memcmp(token, AGLE_SIGNED_TOKEN_PREFIX, TOKEN_PREFIX_LEN) != 0) {
+        return false;
+    }
+
+    uint8_t raw[TOKEN_RAW_LEN];
+    if (!_b64_decode(token + TOKEN_PREFIX_LEN, TOKEN_B64_LEN, raw, sizeof(raw))) {
+        return false;
+    }
+
+    AGLE_TokenClaims c;
+    c.key_id = (uint32_t)_get_le(raw, 4);
+    c.user_id = (uint32_t)_get_le(raw + 4, 4);
+    c.expires_at = (int64_t)_get_le(raw + 8, 8);
+    c.token_id = _get_le(raw + 16, 8);
+
+    const token_key *k = _find_key(signer, c.key_id);
+    uint8_t tag[TOKEN_TAG_LEN];
+    if (k == NULL || !_tag(k, raw, tag)) return false;
+    bool ok = CRYPTO_memcmp(tag, raw + TOKEN_PAYLOAD_LEN, TOKEN_TAG_LEN) == 0;
+
+    /* Claims are only trusted once the tag matched */
+    if (!ok || c.expires_at <= now || _revoked(signer, c.token_id)) {
+        return false;
+    }
+    if (claims != NULL) *claims = c;
+    return true;
+}
+
+bool AGLE_TokenRevoke(AGLE_TOKEN_SIGNER *signer, const AGLE_TokenClaims *claims) {
+    if (signer == NULL || claims == NULL || claims->token_id == 0) return false;
+
+    uint8_t id[8];
+    _put_le(id, claims->token_id, sizeof(id));
+    return AGLE_RevocationAdd(signer->revoked, id, sizeof(id), claims->expires_at);
+}
+
+size_t AGLE_TokenPurgeRevoked(AGLE_TOKEN_SIGNER *signer, int64_t now) {
+    if (signer == NULL) return 0;
+    return AGLE_RevocationPurge(signer->revoked, now);
+}
+
+size_t AGLE_TokenRevokedCount(const AGLE_TOKEN_SIGNER *signer) {
+    if (signer == NULL) return 0;
+    return AGLE_RevocationCount(signer->revoked);
+}
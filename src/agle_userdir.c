@@ -0,0 +1,281 @@
+/**
+ * @file agle_userdir.c
+ * @brief Hash-indexed, growable account directory.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "agle_internal.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The index is an open-addressing table of 64-bit words:
+ * high 32 bits of SipHash(username) | record id + 1 (0 marks an empty slot).
+ * A probe compares tags without touching the records, so the name column is
+ * read only for the candidate. Records live in parallel arrays indexed by
+ * id: scanning lockout state or bulk-loading salts touches only that column.
+ */
+#define USERDIR_MIN_RECORDS 64
+#define USERDIR_MIN_INDEX 128
+
+struct AGLE_USER_DIR {
+    pthread_rwlock_t lock;
+    uint8_t sip_key[AGLE_SIPHASH_KEY_LEN];
+
+    uint64_t *index;
+    size_t index_mask;
+
+    char (*names)[AGLE_USERNAME_MAX];
+    uint8_t (*salts)[AGLE_USER_SALT_LEN];
+    uint8_t (*hashes)[AGLE_USER_HASH_LEN];
+    uint32_t *kdf_iterations;
+    uint32_t *failed;         /* Updated atomically under the shared lock */
+    int64_t *locked_until;    /* Updated atomically under the shared lock */
+    size_t count;
+    size_t capacity;
+};
+
+static uint64_t _name_hash(const AGLE_USER_DIR *dir, const char *username, size_t len) {
+    return agle_siphash24(dir->sip_key, username, len);
+}
+
+/* Id of username, or -1. Caller holds the lock. */
+static int64_t _index_find(const AGLE_USER_DIR *dir, const char *username, uint64_t hash) {
+    uint32_t tag = (uint32_t)(hash >> 32);
+    size_t i = (size_t)hash & dir->index_mask;
+
+    for (;;) {
+        uint64_t slot = dir->index[i];
+        if (slot == 0) return -1;
+        if ((uint32_t)(slot >> 32) == tag) {
+            uint32_t id = (uint32_t)slot - 1;
+            if (strcmp(dir->names[id], username) == 0) return id;
+        }
+        i = (i + 1) & dir->index_mask;
+    }
+}
+
+static void _index_put(uint64_t *index, size_t mask, uint64_t hash, uint32_t id) {
+    size_t i = (size_t)hash & mask;
+    while (index[i] != 0) {
+        i = (i + 1) & mask;
+    }
+    index[i] = ((hash >> 32) << 32) | ((uint64_t)id + 1);
+}
+
+/* Double the index and re-place every record. Caller holds the write lock. */
+static bool _index_grow(AGLE_USER_DIR *dir) {
+    size_t size = (dir->index_mask + 1) * 2;
+    uint64_t *index = calloc(size, sizeof(*index));
+    if (index == NULL) return false;
+
+    for (size_t id = 0; id < dir->count; id++) {
+        uint64_t hash = _name_hash(dir, dir->names[id], strlen(dir->names[id]));
+        _index_put(index, size - 1, hash, (uint32_t)id);
+    }
+
+    free(dir->index);
+    dir->index = index;
+    dir->index_mask = size - 1;
+    return true;
+}
+
+static bool _grow_column(void **column, size_t elem, size_t old_cap, size_t new_cap) {
+    void *grown = realloc(*column, new_cap * elem);
+    if (grown == NULL) return false;
+    memset((uint8_t *)grown + old_cap * elem, 0, (new_cap - old_cap) * elem);
+    *column = grown;
+    return true;
+}
+
+/* Grow every column to new_cap records. Caller holds the write lock. */
+static bool _records_grow(AGLE_USER_DIR *dir, size_t new_cap) {
+    size_t old_cap = dir->capacity;
+
+    if (!_grow_column((void **)&dir->names, sizeof(*dir->names), old_cap, new_cap) ||
+        !_grow_column((void **)&dir->salts, sizeof(*dir->salts), old_cap, new_cap) ||
+        !_grow_column((void **)&dir->hashes, sizeof(*dir->hashes), old_cap, new_cap) ||
+        !_grow_column((void **)&dir->kdf_iterations, sizeof(*dir->kdf_iterations),
+                      old_cap, new_cap) ||
+        !_grow_column((void **)&dir->failed, sizeof(*dir->failed), old_cap, new_cap) ||
+        !_grow_column((void **)&dir->locked_until, sizeof(*dir->locked_until),
+                      old_cap, new_cap)) {
+        /* Columns that did grow keep their larger size; capacity stays put */
+        return false;
+    }
+    dir->capacity = new_cap;
+    return true;
+}
+
+AGLE_USER_DIR* AGLE_UserDirNew(size_t expected_users) {
+    AGLE_USER_DIR *dir = calloc(1, sizeof(*dir));
+    if (dir == NULL) return NULL;
+
+    if (pthread_rwlock_init(&dir->lock, NULL) != 0) {
+        free(dir);
+        return NULL;
+    }
+
+    size_t records = USERDIR_MIN_RECORDS;
+    while (records < expected_users) {
+        records <<= 1;
+    }
+    size_t index_size = USERDIR_MIN_INDEX;
+    while (index_size * 3 < records * 4) {
+        index_size <<= 1;
+    }
+
+    dir->index = calloc(index_size, sizeof(*dir->index));
+    dir->index_mask = index_size - 1;
+
+    if (!agle_siphash_key(dir->sip_key) || dir->index == NULL ||
+        !_records_grow(dir, records)) {
+        AGLE_UserDirFree(dir);
+        return NULL;
+    }
+    return dir;
+}
+
+void AGLE_UserDirFree(AGLE_USER_DIR *dir) {
+    if (dir == NULL) return;
+
+    if (dir->salts != NULL) {
+        AGLE_SecureZero(dir->salts, dir->capacity * sizeof(*dir->salts));
+    }
+    if (dir->hashes != NULL) {
+        AGLE_SecureZero(dir->hashes, dir->capacity * sizeof(*dir->hashes));
+    }
+    AGLE_SecureZero(dir->sip_key, sizeof(dir->sip_key));
+
+    free(dir->index);
+    free(dir->names);
+    free(dir->salts);
+    free(dir->hashes);
+    free(dir->kdf_iterations);
+    free(dir->failed);
+    free(dir->locked_until);
+    pthread_rwlock_destroy(&dir->lock);
+    free(dir);
+}
+
+bool AGLE_UserDirAdd(AGLE_USER_DIR *dir, const char *username,
+                     const uint8_t *salt, const uint8_t *hash,
+                     uint32_t kdf_iterations, uint32_t *id_out) {
+    if (dir == NULL || username == NULL || salt == NULL || hash == NULL) return false;
+
+    size_t len = strlen(username);
+    if (len == 0 || len >= AGLE_USERNAME_MAX) return false;
+
+    uint64_t h = _name_hash(dir, username, len);
+    bool result = false;
+    pthread_rwlock_wrlock(&dir->lock);
+
+    if (_index_find(dir, username, h) >= 0) goto done;
+    if (dir->count >= UINT32_MAX - 1) goto done;
+
+    if (dir->count == dir->capacity && !_records_grow(dir, dir->capacity * 2)) goto done;
+    if ((dir->count + 1) * 4 > (dir->index_mask + 1) * 3 && !_index_grow(dir)) goto done;
+
+    size_t id = dir->count;
+    memcpy(dir->names[id], username, len + 1);
+    memcpy(dir->salts[id], salt, AGLE_USER_SALT_LEN);
+    memcpy(dir->hashes[id], hash, AGLE_USER_HASH_LEN);
+    dir->kdf_iterations[id] = kdf_iterations;
+    dir->failed[id] = 0;
+    dir->locked_until[id] = 0;
+    _index_put(dir->index, dir->index_mask, h, (uint32_t)id);
+    __atomic_store_n(&dir->count, id + 1, __ATOMIC_RELEASE);
+
+    if (id_out != NULL) *id_out = (uint32_t)id;
+    result = true;
+
+done:
+    pthread_rwlock_unlock(&dir->lock);
+    return result;
+}
+
+bool AGLE_UserDirFind(AGLE_USER_DIR *dir, const char *username, uint32_t *id_out) {
+    if (dir == NULL || username == NULL) return false;
+
+    size_t len = strlen(username);
+    if (len == 0 || len >= AGLE_USERNAME_MAX) return false;
+
+    uint64_t h = _name_hash(dir, username, len);
+    pthread_rwlock_rdlock(&dir->lock);
+    int64_t id = _index_find(dir, username, h);
+    pthread_rwlock_unlock(&dir->lock);
+
+    if (id < 0) return false;
+    if (id_out != NULL) *id_out = (uint32_t)id;
+    return true;
+}
+
+bool AGLE_UserDirGet(AGLE_USER_DIR *dir, uint32_t id, AGLE_UserRecord *out) {
+    if (dir == NULL || out == NULL) return false;
+
+    bool found = false;
+    pthread_rwlock_rdlock(&dir->lock);
+    if (id < dir->count) {
+        memcpy(out->username, dir->names[id], AGLE_USERNAME_MAX);
+        memcpy(out->salt, dir->salts[id], AGLE_USER_SALT_LEN);
+        memcpy(out->hash, dir->hashes[id], AGLE_USER_HASH_LEN);
+        out->kdf_iterations = dir->kdf_iterations[id];
+        out->failed_attempts = __atomic_load_n(&dir->failed[id], __ATOMIC_RELAXED);
+        out->locked_until = __atomic_load_n(&dir->locked_until[id], __ATOMIC_RELAXED);
+        found = true;
+    }
+    pthread_rwlock_unlock(&dir->lock);
+    return found;
+}
+
+uint32_t AGLE_UserDirNoteFailure(AGLE_USER_DIR *dir, uint32_t id) {
+    if (dir == NULL) return 0;
+
+    uint32_t attempts = 0;
+    pthread_rwlock_rdlock(&dir->lock);
+    if (id < dir->count) {
+        attempts = __atomic_add_fetch(&dir->failed[id], 1, __ATOMIC_RELAXED);
+    }
+    pthread_rwlock_unlock(&dir->lock);
+    return attempts;
+}
+
+void AGLE_UserDirNoteSuccess(AGLE_USER_DIR *dir, uint32_t id) {
+    if (dir == NULL) return;
+
+    pthread_rwlock_rdlock(&dir->lock);
+    if (id < dir->count) {
+        __atomic_store_n(&dir->failed[id], 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&dir->locked_until[id], 0, __ATOMIC_RELAXED);
+    }
+    pthread_rwlock_unlock(&dir->lock);
+}
+
+void AGLE_UserDirLock(AGLE_USER_DIR *dir, uint32_t id, int64_t until) {
+    if (dir == NULL) return;
+
+    pthread_rwlock_rdlock(&dir->lock);
+    if (id < dir->count) {
+        __atomic_store_n(&dir->locked_until[id], until, __ATOMIC_RELAXED);
+    }
+    pthread_rwlock_unlock(&dir->lock);
+}
+
+int64_t AGLE_UserDirLockedUntil(AGLE_USER_DIR *dir, uint32_t id) {
+    if (dir == NULL) return 0;
+
+    int64_t until = 0;
+    pthread_rwlock_rdlock(&dir->lock);
+    if (id < dir->count) {
+        until = __atomic_load_n(&dir->locked_until[id], __ATOMIC_RELAXED);
+    }
+    pthread_rwlock_unlock(&dir->lock);
+    return until;
+}
+
+size_t AGLE_UserDirCount(AGLE_USER_DIR *dir) {
+    if (dir == NULL) return 0;
+    return __atomic_load_n(&dir->count, __ATOMIC_ACQUIRE);
+}
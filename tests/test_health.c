@@ -0,0 +1,162 @@
+/*
+ * AGLE entropy health test tests
+ * SP 800-90B repetition count and adaptive proportion cutoffs on crafted
+ * input, with failures placed both in the SSE2 blocks and in the scalar
+ * tails, and the discard/retry/fail-closed handling of a bad source.
+ */
+
+#include "agle_internal.h"
+#include "test_util.h"
+
+#define INPUT 4096
+#define MARK 0xf0                 /* Never produced by base() */
+
+static uint8_t buf[INPUT + 64];
+
+/* No two neighbours equal, no value more than 3 times in a window */
+static void base(size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        buf[i] = (uint8_t)(i % 200);
+    }
+}
+
+static void run_rct(void) {
+    base(INPUT);
+    expect(agle_health_test(buf, INPUT) == 0, "healthy input passes");
+
+    memset(buf + 100, 7, 5);
+    expect(agle_health_test(buf, INPUT) == 0, "run of 5 passes");
+    memset(buf + 100, 7, 6);
+    expect(agle_health_test(buf, INPUT) == AGLE_CTX_HEALTH_RCT_FAIL, "run of 6 fails");
+
+    /* Runs that straddle two 16-byte blocks */
+    base(INPUT);
+    memset(buf + 14, 9, 6);
+    expect(agle_health_test(buf, INPUT) == AGLE_CTX_HEALTH_RCT_FAIL, "run across blocks fails");
+
+    /* 4103 bytes: the vector loop stops at 4097, the last 6 are scalar */
+    base(INPUT + 7);
+    memset(buf + INPUT + 1, 9, 5);
+    expect(agle_health_test(buf, INPUT + 7) == 0, "run of 5 in scalar tail passes");
+    memset(buf + INPUT + 1, 9, 6);
+    expect(agle_health_test(buf, INPUT + 7) == AGLE_CTX_HEALTH_RCT_FAIL,
+           "run of 6 in scalar tail fails");
+
+    base(10);
+    memset(buf + 2, 3, 6);
+    expect(agle_health_test(buf, 10) == AGLE_CTX_HEALTH_RCT_FAIL, "short input is tested");
+}
+
+/* Put MARK at start and at count - 1 spaced positions from first */
+static void plant(size_t start, size_t first, size_t count) {
+    buf[start] = MARK;
+    for (size_t k = 0; k + 1 < count; k++) {
+        buf[first + 2 * k] = MARK;
+    }
+}
+
+static void run_apt(void) {
+    base(INPUT);
+    plant(0, 2, 18);
+    expect(agle_health_test(buf, INPUT) == 0, "18 in a window passes");
+    plant(0, 2, 19);
+    expect(agle_health_test(buf, INPUT) == AGLE_CTX_HEALTH_APT_FAIL, "19 in a window fails");
+
+    base(INPUT);
+    plant(3 * 512, 3 * 512 + 300, 19);
+    expect(agle_health_test(buf, INPUT) == AGLE_CTX_HEALTH_APT_FAIL, "later window fails");
+
+    /*
+     * 4136 bytes: the last window is 40 bytes, 4096..4135. Vectors cover
+     * 4097..4128, the scalar tail 4129..4135. 15 marks in the vector part
+     * and 2 or 3 in the tail, plus the window's first byte.
+     */
+    size_t n = INPUT + 40;
+    base(n);
+    plant(INPUT, INPUT + 4, 16);
+    buf[INPUT + 34] = MARK;
+    buf[INPUT + 36] = MARK;
+    expect(agle_health_test(buf, n) == 0, "18 with scalar tail passes");
+    buf[INPUT + 38] = MARK;
+    expect(agle_health_test(buf, n) == AGLE_CTX_HEALTH_APT_FAIL, "19 with scalar tail fails");
+
+    /* A stuck source fails both */
+    memset(buf, 0x55, INPUT);
+    expect(agle_health_test(buf, INPUT) ==
+           (AGLE_CTX_HEALTH_RCT_FAIL | AGLE_CTX_HEALTH_APT_FAIL), "stuck input fails both");
+}
+
+/* Sources: bad inputs first, then good ones */
+static unsigned bad_left;
+
+static bool stuck_source(AGLE_CTX *ctx, uint8_t *out, size_t n) {
+    (void)ctx;
+    memset(out, 0, n);
+    return true;
+}
+
+/* Two alternating values: never a run, but each is half of every window */
+static bool biased_source(AGLE_CTX *ctx, uint8_t *out, size_t n) {
+    (void)ctx;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = (i % 2) ? 0x11 : 0x22;
+    }
+    return true;
+}
+
+static bool flaky_source(AGLE_CTX *ctx, uint8_t *out, size_t n) {
+    if (bad_left > 0) {
+        bad_left--;
+        return stuck_source(ctx, out, n);
+    }
+    for (size_t i = 0; i < n; i++) {
+        out[i] = (uint8_t)(i % 200);
+    }
+    return true;
+}
+
+static void run_source(void) {
+    AGLE_CTX ctx;
+    uint8_t out[32];
+
+    AGLE_Init(&ctx);
+    bad_left = 2;
+    uint64_t inputs = ctx.health_inputs;
+    expect(agle_entropy_read_from(&ctx, buf, INPUT, flaky_source) &&
+           ctx.health_discards == 2 && ctx.health_inputs == inputs + 1 &&
+           AGLE_IsHealthy(&ctx), "two bad inputs are discarded");
+
+    expect(!agle_entropy_read_from(&ctx, buf, INPUT, stuck_source) &&
+           ctx.health_discards == 5 && !AGLE_IsHealthy(&ctx) &&
+           (ctx.flags & AGLE_CTX_HEALTH_FAILED) ==
+           (AGLE_CTX_HEALTH_RCT_FAIL | AGLE_CTX_HEALTH_APT_FAIL) &&
+           (ctx.flags & AGLE_CTX_SEEDED) == 0, "stuck source fails closed");
+    expect(!AGLE_GetRandomBytes(&ctx, out, sizeof(out)), "failed context refuses output");
+    bad_left = 0;
+    expect(!agle_entropy_read_from(&ctx, buf, INPUT, flaky_source), "failure is latched");
+
+    expect(AGLE_Init(&ctx) && AGLE_IsHealthy(&ctx) && AGLE_GetRandomBytes(&ctx, out, sizeof(out)),
+           "re-initialized context recovers");
+
+    expect(!agle_entropy_read_from(&ctx, buf, INPUT, biased_source) &&
+           (ctx.flags & AGLE_CTX_HEALTH_FAILED) == AGLE_CTX_HEALTH_APT_FAIL,
+           "biased source fails proportion test");
+    AGLE_Cleanup(&ctx);
+
+    /* Real kernel input over many reads: no discards expected */
+    AGLE_Init(&ctx);
+    bool ok = true;
+    for (int i = 0; i < 256; i++) {
+        ok &= agle_entropy_read(&ctx, buf, INPUT);
+    }
+    expect(ok && AGLE_IsHealthy(&ctx), "kernel entropy passes");
+    AGLE_Cleanup(&ctx);
+}
+
+int main(void) {
+    run_rct();
+    run_apt();
+    run_source();
+
+    return test_finish("entropy health");
+}
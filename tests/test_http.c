@@ -0,0 +1,59 @@
+/*
+ * servidor_auth HTTP parser tests
+ * Pipelined requests split on their declared length, and framing that a
+ * proxy could read differently (repeated or empty Content-Length,
+ * Transfer-Encoding) is rejected instead of guessed.
+ */
+
+#define SERVIDOR_SEM_MAIN
+#include "../servidor_auth.c"
+#include "test_util.h"
+
+static Conexao conn;
+
+static ResultadoParse parse(const char *raw, Requisicao *req) {
+    memset(&conn, 0, sizeof(conn));
+    size_t len = strlen(raw);
+    memcpy(conn.entrada, raw, len);
+    conn.entrada_fim = len;
+    return http_analisar(&conn, req);
+}
+
+static void run_framing(void) {
+    Requisicao req;
+
+    expect(parse("POST /login HTTP/1.1\r\nContent-Length: 2\r\n\r\n{}", &req) == PARSE_OK &&
+           req.corpo.len == 2 && req.manter_conexao, "body by Content-Length");
+    expect(parse("POST /login HTTP/1.1\r\nContent-Length: 5\r\n\r\n{}", &req) == PARSE_INCOMPLETO,
+           "short body waits");
+    expect(parse("GET /stats HTTP/1.1\r\n\r\n", &req) == PARSE_OK && req.corpo.len == 0,
+           "no Content-Length, no body");
+
+    /* Two pipelined requests: the first ends exactly where its length says */
+    static const char first[] = "POST /a HTTP/1.1\r\nContent-Length: 3\r\n\r\nabc";
+    char two[128];
+    snprintf(two, sizeof(two), "%sGET /b HTTP/1.1\r\n\r\n", first);
+    expect(parse(two, &req) == PARSE_OK && req.tamanho == sizeof(first) - 1,
+           "pipelined request split");
+
+    expect(parse("POST /a HTTP/1.1\r\nContent-Length: 3\r\nContent-Length: 0\r\n\r\nabc",
+                 &req) == PARSE_ERRO, "repeated Content-Length rejected");
+    expect(parse("POST /a HTTP/1.1\r\nContent-Length: 3\r\ncontent-length: 3\r\n\r\nabc",
+                 &req) == PARSE_ERRO, "repeated Content-Length rejected, even if equal");
+    expect(parse("POST /a HTTP/1.1\r\nContent-Length:\r\n\r\n", &req) == PARSE_ERRO &&
+           parse("POST /a HTTP/1.1\r\nContent-Length:  \r\n\r\n", &req) == PARSE_ERRO,
+           "empty Content-Length rejected");
+    expect(parse("POST /a HTTP/1.1\r\nContent-Length: 1x\r\n\r\n", &req) == PARSE_ERRO,
+           "non-numeric Content-Length rejected");
+
+    expect(parse("POST /a HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+                 "3\r\nabc\r\n0\r\n\r\n", &req) == PARSE_ERRO, "chunked body rejected");
+    expect(parse("POST /a HTTP/1.1\r\nContent-Length: 3\r\ntransfer-encoding: chunked\r\n\r\nabc",
+                 &req) == PARSE_ERRO, "Transfer-Encoding with Content-Length rejected");
+}
+
+int main(void) {
+    run_framing();
+
+    return test_finish("HTTP parser");
+}
@@ -0,0 +1,296 @@
+/*
+ * AGLE known-answer tests
+ * Deterministic mode (AGLE_InitSeeded / AGLE_InitOptions.seed) must produce
+ * the same bytes on every build, backend implementation and SIMD path. The
+ * CTR_DRBG and ChaCha20 backends are also instantiated directly from
+ * published vectors (NIST CAVP, RFC 8439), bypassing the entropy source.
+ */
+
+#include "agle.h"
+#include "agle_internal.h"
+#include "test_util.h"
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+    AGLE_Backend backend;
+    const char *first;      /* GetRandomBytes(64) */
+    const char *second;     /* GetRandomBytes(37), partial block */
+    const char *big;        /* SHAKE256-256 of GetRandomBytes(70000) */
+    const char *split;      /* Split child, SplitGetRandomBytes(32) */
+} KatVector;
+
+/* Seed for every vector: bytes 0x00..0x1f */
+static const KatVector VECTORS[] = {
+    {
+        AGLE_BACKEND_SHAKE256,
+        "14776e91f6aafaf8ab7129b435378d4f14a76a8796ce62f8d6958725bbd36a42"
+        "de4b6af722cc0f39c97ed702370ecc111984915478f847c0e696e003ad86fe97",
+        "7843e804f6f1f0240ed1d1067ef22052207e1188f02cb349091ac6ed3ba8edba"
+        "58611cf8e7",
+        "003f38eb46d6c0c14345ec0a8be20c42e18f3a82609ca56a885d71d37ada794e",
+        "99d1d478ddfb42e7d51e318f6cb2de60e1ec676531474bb4ceaa6ed0ab75e586",
+    },
+    {
+        AGLE_BACKEND_AES256_CTR_DRBG,
+        "4d02a0eeb8e7f67ac2bdc297bb8f726ae499ed00935fcb751e500dddda836f9b"
+        "e859b5dce490fc3e0824b1106332424e139d8f754206744d8e9a3ba6a2856d04",
+        "1969f50e65263a90ba1f68251ee85408fa1e5831de399107326e515fae8fb496"
+        "e0a5da686c",
+        "2a73cb9165ce4352efd0a70d07f564118de5a120aa0baf248b6602b0724f747d",
+        "43c55bfe704df2c66a591e0b1a7ae94eed6b8a0d038b8543daadfee673aa923b",
+    },
+    {
+        AGLE_BACKEND_CHACHA20,
+        "349194baf7860f22a5fce6cc1b730266a6b082503faa21d5e14aff57c3b89013"
+        "a4b55bb6554eee8b5d6e675acd10529636ddeba7ba805514eda725734d178d4c",
+        "75f293305cc6c848aceaf029703cd8cd6ce2190eed2d64768b22c56f31363d07"
+        "416b2f3a25",
+        "f52e3832339b980de49041b2f90cd40c1540aee11d4c9b83f4f874c1589754c7",
+        "56f77a9286b16232f5a91c1e711719118ea3017bf5f131a60d8c28617fdda147",
+    },
+};
+
+#define VECTOR_COUNT (sizeof(VECTORS) / sizeof(VECTORS[0]))
+#define BIG_LEN 70000
+
+static void check(const char *name, const char *backend,
+                  const uint8_t *got, size_t len, const char *expected) {
+    char hex[2 * 64 + 1];
+    AGLE_BytesToHex(got, len, hex);
+    if (strcmp(hex, expected) != 0) {
+        printf("FAIL %s/%s\n  got      %s\n  expected %s\n", backend, name, hex, expected);
+        failures++;
+    } else {
+        printf("ok   %s/%s\n", backend, name);
+    }
+}
+
+static void run_vector(const KatVector *v) {
+    static uint8_t big[BIG_LEN];
+    uint8_t seed[32];
+    for (size_t i = 0; i < sizeof(seed); i++) {
+        seed[i] = (uint8_t)i;
+    }
+
+    AGLE_InitOptions opts = {0};
+    opts.backend = v->backend;
+    opts.seed = seed;
+    opts.seed_len = sizeof(seed);
+
+    AGLE_CTX ctx;
+    if (!AGLE_InitEx(&ctx, &opts)) {
+        printf("FAIL backend %d: init\n", (int)v->backend);
+        failures++;
+        return;
+    }
+
+    const char *name = strstr(AGLE_GetContextInfo(&ctx), "Backend: ");
+    char backend[32] = "?";
+    if (name != NULL) {
+        sscanf(name + 9, "%31[^\n]", backend);
+    }
+
+    uint8_t buf[64];
+    uint8_t digest[32];
+
+    if (!AGLE_GetRandomBytes(&ctx, buf, 64)) failures++;
+    check("first", backend, buf, 64, v->first);
+
+    if (!AGLE_GetRandomBytes(&ctx, buf, 37)) failures++;
+    check("second", backend, buf, 37, v->second);
+
+    if (!AGLE_GetRandomBytes(&ctx, big, BIG_LEN)) failures++;
+    AGLE_HashSHAKE256(big, BIG_LEN, digest, sizeof(digest));
+    check("big", backend, digest, sizeof(digest), v->big);
+
+    AGLE_SPLIT_CTX child;
+    if (!AGLE_Split(&ctx, &child) ||
+        !AGLE_SplitGetRandomBytes(&child, buf, 32)) {
+        failures++;
+    }
+    check("split", backend, buf, 32, v->split);
+
+    if (!AGLE_IsHealthy(&ctx) || ctx.health_inputs == 0) {
+        printf("FAIL %s/health: flags 0x%x, %llu inputs tested\n", backend,
+               (unsigned)ctx.flags, (unsigned long long)ctx.health_inputs);
+        failures++;
+    } else {
+        printf("ok   %s/health\n", backend);
+    }
+
+    AGLE_SplitCleanup(&child);
+    AGLE_Cleanup(&ctx);
+}
+
+static void run_seeded_matches_options(void) {
+    const uint8_t seed[] = "AGLE_InitSeeded";
+    AGLE_CTX a, b;
+    uint8_t out_a[48], out_b[48];
+
+    AGLE_InitOptions opts = {0};
+    opts.seed = seed;
+    opts.seed_len = sizeof(seed) - 1;
+
+    if (!AGLE_InitSeeded(&a, seed, sizeof(seed) - 1) ||
+        !AGLE_InitEx(&b, &opts) ||
+        !AGLE_GetRandomBytes(&a, out_a, sizeof(out_a)) ||
+        !AGLE_GetRandomBytes(&b, out_b, sizeof(out_b)) ||
+        memcmp(out_a, out_b, sizeof(out_a)) != 0) {
+        printf("FAIL AGLE_InitSeeded differs from AGLE_InitEx seed option\n");
+        failures++;
+    } else {
+        printf("ok   AGLE_InitSeeded/reproducible\n");
+    }
+}
+
+/* Backend state straight from seed, as the DRBG specifications define it */
+static bool backend_instantiate(AGLE_CTX *ctx, AGLE_Backend id, const uint8_t *seed) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->backend = id;
+    return agle_backend_get(id)->instantiate(ctx, seed);
+}
+
+static void hex_to_bytes(const char *hex, uint8_t *out, size_t len) {
+    if (AGLE_HexToBytes(hex, out, len) != (int)len) {
+        printf("FAIL bad test vector %s\n", hex);
+        failures++;
+    }
+}
+
+/*
+ * NIST CAVP CTR_DRBG.rsp, [AES-256 no df], no prediction resistance, no
+ * reseed: instantiate with EntropyInput XOR PersonalizationString, generate
+ * 512 bits twice, and the second output is ReturnedBits.
+ */
+static void run_ctr_drbg_cavp(const char *name, const char *entropy,
+                              const char *personalization, const char *returned) {
+    const agle_backend *be = agle_backend_get(AGLE_BACKEND_AES256_CTR_DRBG);
+    uint8_t seed[48], pers[48] = {0}, out[64];
+    hex_to_bytes(entropy, seed, sizeof(seed));
+    if (personalization != NULL) {
+        hex_to_bytes(personalization, pers, sizeof(pers));
+    }
+    for (size_t i = 0; i < sizeof(seed); i++) {
+        seed[i] ^= pers[i];
+    }
+
+    AGLE_CTX ctx;
+    bool ok = backend_instantiate(&ctx, AGLE_BACKEND_AES256_CTR_DRBG, seed) &&
+              be->generate(&ctx, out, sizeof(out)) &&
+              be->generate(&ctx, out, sizeof(out));
+    if (!ok) failures++;
+    check(name, "CTR_DRBG", out, sizeof(out), returned);
+    AGLE_SecureZero(&ctx, sizeof(ctx));
+}
+
+/*
+ * RFC 8439 appendix A.1: ChaCha20 block function, all-zero nonce. The
+ * backend keys ChaCha20 with its state and a zero nonce and IV, keeps
+ * keystream bytes 0..31 as the next key, and returns the bytes from 32
+ * onwards. So block b >= 1 of the RFC is output bytes 64 * b - 32 onwards.
+ */
+static void run_chacha20_rfc8439(const char *name, const char *key, unsigned block,
+                                 const char *keystream) {
+    const agle_backend *be = agle_backend_get(AGLE_BACKEND_CHACHA20);
+    uint8_t seed[32], out[160];
+    hex_to_bytes(key, seed, sizeof(seed));
+
+    AGLE_CTX ctx;
+    size_t len = 64 * (size_t)block + 32;
+    bool ok = block >= 1 && len <= sizeof(out) &&
+              backend_instantiate(&ctx, AGLE_BACKEND_CHACHA20, seed) &&
+              be->generate(&ctx, out, len);
+    if (!ok) {
+        failures++;
+        return;
+    }
+    check(name, "ChaCha20", out + len - 64, 64, keystream);
+    AGLE_SecureZero(&ctx, sizeof(ctx));
+}
+
+static void run_backend_references(void) {
+    run_ctr_drbg_cavp("cavp-count-0",
+        "df5d73faa468649edda33b5cca79b0b05600419ccb7a879d"
+        "dfec9db32ee494e5531b51de16a30f769262474c73bec010",
+        NULL,
+        "d1c07cd95af8a7f11012c84ce48bb8cb87189e99d40fccb1771c619bdf82ab22"
+        "80b1dc2f2581f39164f7ac0c510494b3a43c41b7db17514c87b107ae793e01c5");
+    /* Same EntropyInput with a personalization string; expected output
+     * from OpenSSL's CTR-DRBG (use_df = 0), an independent implementation */
+    run_ctr_drbg_cavp("personalization",
+        "df5d73faa468649edda33b5cca79b0b05600419ccb7a879d"
+        "dfec9db32ee494e5531b51de16a30f769262474c73bec010",
+        "404142434445464748494a4b4c4d4e4f505152535455565758595a5b5c5d5e5f"
+        "606162636465666768696a6b6c6d6e6f",
+        "e9527c17369c46b74f5ddf2ad962b23c15fbce752167ca32afa413a12d3850a6"
+        "9b02f59276af0537f01c829decdea1e5662450d166b0c49a2ff47c244664f1ff");
+
+    /* Block 0's first half is the rekey; its second half is the output */
+    static const char ZERO_KEY[] =
+        "0000000000000000000000000000000000000000000000000000000000000000";
+    uint8_t seed[32] = {0}, out[32];
+    AGLE_CTX ctx;
+    bool ok = backend_instantiate(&ctx, AGLE_BACKEND_CHACHA20, seed) &&
+              agle_backend_get(AGLE_BACKEND_CHACHA20)->generate(&ctx, out, sizeof(out));
+    if (!ok) failures++;
+    check("rfc8439-tv1", "ChaCha20", out, sizeof(out),
+          "da41597c5157488d7724e03fb8d84a376a43b8f41518a11cc387b669b2ee6586");
+    check("rfc8439-tv1-rekey", "ChaCha20", ctx.state, 32,
+          "76b8e0ada0f13d90405d6ae55386bd28bdd219b8a08ded1aa836efcc8b770dc7");
+    AGLE_SecureZero(&ctx, sizeof(ctx));
+
+    run_chacha20_rfc8439("rfc8439-tv2", ZERO_KEY, 1,
+        "9f07e7be5551387a98ba977c732d080dcb0f29a048e3656912c6533e32ee7aed"
+        "29b721769ce64e43d57133b074d839d531ed1f28510afb45ace10a1f4b794d6f");
+    run_chacha20_rfc8439("rfc8439-tv3",
+        "0000000000000000000000000000000000000000000000000000000000000001", 1,
+        "3aeb5224ecf849929b9d828db1ced4dd832025e8018b8160b82284f3c949aa5a"
+        "8eca00bbb4a73bdad192b5c42f73f2fd4e273644c8b36125a64addeb006c13a0");
+    run_chacha20_rfc8439("rfc8439-tv4",
+        "00ff000000000000000000000000000000000000000000000000000000000000", 2,
+        "72d54dfbf12ec44b362692df94137f328fea8da73990265ec1bbbea1ae9af0ca"
+        "13b25aa26cb4a648cb9b9d1be65b2c0924a66c54d545ec1b7374f4872e99f096");
+}
+
+static void run_crc32c_reference(void) {
+    /* RFC 3720 B.4 check value: CRC32C("123456789") */
+    const char *digits = "123456789";
+    expect(agle_crc32c(0, digits, 9) == 0xe3069283u, "CRC32C/check-value");
+    expect(agle_crc32c_table(0, digits, 9) == 0xe3069283u, "CRC32C/table/check-value");
+
+    /* Odd lengths at every alignment, whole and continued in two parts */
+    static uint8_t buf[1031 + 8];
+    fill(buf, sizeof(buf), 7);
+    bool same = true;
+    for (size_t off = 0; off < 8; off++) {
+        for (size_t len = 0; len <= 1031; len += 1 + 2 * (len % 5)) {
+            uint32_t a = agle_crc32c(0, buf + off, len);
+            uint32_t b = agle_crc32c_table(0, buf + off, len);
+            uint32_t c = agle_crc32c(agle_crc32c_table(0, buf + off, len / 3),
+                                     buf + off + len / 3, len - len / 3);
+            same &= a == b && a == c;
+        }
+    }
+    expect(same, "CRC32C/table matches at every alignment");
+}
+
+static void run_shake256_reference(void) {
+    /* FIPS 202: SHAKE256(""), first 256 bits */
+    uint8_t digest[32];
+    AGLE_HashSHAKE256((const uint8_t *)"", 0, digest, sizeof(digest));
+    check("empty", "SHAKE256", digest, sizeof(digest),
+          "46b9dd2b0ba88d13233b3feb743eeb243fcd52ea62b81b82b50c27646ed5762f");
+}
+
+int main(void) {
+    run_shake256_reference();
+    run_crc32c_reference();
+    run_backend_references();
+    for (size_t i = 0; i < VECTOR_COUNT; i++) {
+        run_vector(&VECTORS[i]);
+    }
+    run_seeded_matches_options();
+
+    return test_finish("known-answer");
+}
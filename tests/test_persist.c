@@ -0,0 +1,216 @@
+/*
+ * AGLE persistence tests
+ * Log replay into fresh stores, torn-tail recovery, snapshot + log
+ * compaction and restart from a snapshot followed by more log records.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "agle.h"
+#include "test_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NOW 1700000000
+#define SNAPSHOT_USERS 50000
+#define SNAPSHOT_SESSIONS 20000
+
+static char prefix[64];
+static char wal_path[80];
+static char snap_path[80];
+
+static long file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (long)st.st_size : -1;
+}
+
+static unsigned file_mode(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (unsigned)(st.st_mode & 0777) : 0;
+}
+
+/* Both the in-memory add and the log record, as servidor_auth does it */
+static bool add_user(AGLE_USER_DIR *dir, AGLE_PERSIST *p, const char *name, unsigned seed) {
+    uint8_t salt[AGLE_USER_SALT_LEN], hash[AGLE_USER_HASH_LEN];
+    fill(salt, sizeof(salt), seed);
+    fill(hash, sizeof(hash), ~seed);
+    return AGLE_UserDirAdd(dir, name, salt, hash, seed, NULL) &&
+           AGLE_PersistUserAdd(p, name, salt, hash, seed);
+}
+
+static bool add_session(AGLE_SESSION_STORE *store, AGLE_PERSIST *p, const char *token,
+                        const AGLE_SessionInfo *info) {
+    return AGLE_SessionInsert(store, token, 64, info) &&
+           AGLE_PersistSessionAdd(p, token, 64, info);
+}
+
+static bool user_ok(AGLE_USER_DIR *dir, const char *name, unsigned seed) {
+    uint8_t salt[AGLE_USER_SALT_LEN];
+    AGLE_UserRecord rec;
+    uint32_t id;
+    fill(salt, sizeof(salt), seed);
+    return AGLE_UserDirFind(dir, name, &id) && AGLE_UserDirGet(dir, id, &rec) &&
+           memcmp(rec.salt, salt, sizeof(salt)) == 0 && rec.kdf_iterations == seed;
+}
+
+static void run_log_replay(void) {
+    AGLE_USER_DIR *dir = AGLE_UserDirNew(0);
+    AGLE_SESSION_STORE *store = AGLE_SessionStoreNew(0);
+    AGLE_PERSIST *p = AGLE_PersistOpen(prefix, dir, store, NOW);
+    char token[65];
+    bool ok = p != NULL;
+
+    expect(ok && file_size(wal_path) == 8, "new log has only its header");
+
+    AGLE_SessionInfo live = make_info("alice", NOW, NOW + 3600);
+    AGLE_SessionInfo short_lived = make_info("bob", NOW, NOW + 10);
+    ok &= add_user(dir, p, "alice", 1) && add_user(dir, p, "bob", 2);
+    make_token(token, 1, 1);
+    ok &= add_session(store, p, token, &live);
+    make_token(token, 1, 2);
+    ok &= add_session(store, p, token, &short_lived);
+    make_token(token, 1, 3);
+    ok &= add_session(store, p, token, &live);
+    ok &= AGLE_SessionRemove(store, token, 64, NULL) && AGLE_PersistSessionRemove(p, token, 64);
+    expect(ok && AGLE_PersistFlush(p), "log and flush");
+    AGLE_PersistClose(p);
+    AGLE_SessionStoreFree(store);
+    AGLE_UserDirFree(dir);
+
+    /* Restart 60 s later: bob's session has expired in the meantime */
+    dir = AGLE_UserDirNew(0);
+    store = AGLE_SessionStoreNew(0);
+    p = AGLE_PersistOpen(prefix, dir, store, NOW + 60);
+    AGLE_SessionInfo out;
+    expect(p != NULL && AGLE_UserDirCount(dir) == 2 && user_ok(dir, "alice", 1) &&
+           user_ok(dir, "bob", 2), "users replayed");
+    make_token(token, 1, 1);
+    expect(AGLE_SessionLookup(store, token, 64, NOW + 60, &out) &&
+           strcmp(out.username, "alice") == 0 && out.expires_at == NOW + 3600,
+           "session replayed");
+    expect(AGLE_SessionStoreCount(store) == 1, "expired and removed sessions skipped");
+
+    AGLE_PersistClose(p);
+    AGLE_SessionStoreFree(store);
+    AGLE_UserDirFree(dir);
+}
+
+static void run_torn_tail(void) {
+    long valid = file_size(wal_path);
+
+    /* A crash in the middle of a write leaves a partial record */
+    FILE *f = fopen(wal_path, "ab");
+    static const uint8_t partial[] = {0x70, 0, 0, 0, 0xde, 0xad, 0xbe, 0xef, 1, 'e', 'v'};
+    fwrite(partial, 1, sizeof(partial), f);
+    fclose(f);
+
+    AGLE_USER_DIR *dir = AGLE_UserDirNew(0);
+    AGLE_SESSION_STORE *store = AGLE_SessionStoreNew(0);
+    AGLE_PERSIST *p = AGLE_PersistOpen(prefix, dir, store, NOW + 60);
+    expect(p != NULL && AGLE_UserDirCount(dir) == 2 && file_size(wal_path) == valid,
+           "torn tail dropped");
+
+    expect(add_user(dir, p, "carol", 3) && AGLE_PersistFlush(p), "append after recovery");
+    AGLE_PersistClose(p);
+    AGLE_SessionStoreFree(store);
+    AGLE_UserDirFree(dir);
+
+    /* A corrupted record ends the log as well */
+    f = fopen(wal_path, "r+b");
+    fseek(f, -1, SEEK_END);
+    fputc(0x5a, f);
+    fclose(f);
+
+    dir = AGLE_UserDirNew(0);
+    store = AGLE_SessionStoreNew(0);
+    p = AGLE_PersistOpen(prefix, dir, store, NOW + 60);
+    expect(p != NULL && AGLE_UserDirCount(dir) == 2 && !AGLE_UserDirFind(dir, "carol", NULL) &&
+           file_size(wal_path) == valid, "bad checksum ends the log");
+    AGLE_PersistClose(p);
+    AGLE_SessionStoreFree(store);
+    AGLE_UserDirFree(dir);
+}
+
+static void run_snapshot(void) {
+    AGLE_USER_DIR *dir = AGLE_UserDirNew(SNAPSHOT_USERS);
+    AGLE_SESSION_STORE *store = AGLE_SessionStoreNew(SNAPSHOT_SESSIONS);
+    AGLE_PERSIST *p = AGLE_PersistOpen(prefix, dir, store, NOW + 60);
+    char name[32], token[65];
+    bool ok = p != NULL;
+
+    for (unsigned i = 0; i < SNAPSHOT_USERS && ok; i++) {
+        snprintf(name, sizeof(name), "user%u", i);
+        ok = add_user(dir, p, name, 1000 + i);
+    }
+    for (unsigned i = 0; i < SNAPSHOT_SESSIONS && ok; i++) {
+        AGLE_SessionInfo info = make_info("user0", NOW, (int64_t)time(NULL) + 3600 + i);
+        make_token(token, 2, i);
+        ok = add_session(store, p, token, &info);
+    }
+    expect(ok && AGLE_PersistSnapshot(p) && AGLE_PersistFlush(p), "snapshot");
+    expect(file_size(wal_path) == 8 && file_size(snap_path) > 0, "log compacted");
+    expect(file_mode(wal_path) == 0600 && file_mode(snap_path) == 0600,
+           "log and snapshot readable by owner only");
+
+    /* Records after the snapshot go to the fresh log */
+    ok = add_user(dir, p, "late", 7);
+    make_token(token, 2, 0);
+    ok &= AGLE_SessionRemove(store, token, 64, NULL) && AGLE_PersistSessionRemove(p, token, 64);
+    expect(ok && AGLE_PersistFlush(p) && file_size(wal_path) > 8, "log after snapshot");
+    AGLE_PersistClose(p);
+    size_t users = AGLE_UserDirCount(dir);
+    AGLE_SessionStoreFree(store);
+    AGLE_UserDirFree(dir);
+
+    dir = AGLE_UserDirNew(SNAPSHOT_USERS);
+    store = AGLE_SessionStoreNew(SNAPSHOT_SESSIONS);
+    p = AGLE_PersistOpen(prefix, dir, store, NOW + 60);
+    ok = p != NULL && AGLE_UserDirCount(dir) == users && user_ok(dir, "late", 7) &&
+         user_ok(dir, "alice", 1);
+    for (unsigned i = 0; i < SNAPSHOT_USERS && ok; i += 97) {
+        snprintf(name, sizeof(name), "user%u", i);
+        ok = user_ok(dir, name, 1000 + i);
+    }
+    expect(ok, "users restored from snapshot + log");
+
+    make_token(token, 2, 0);
+    ok = !AGLE_SessionLookup(store, token, 64, NOW + 60, NULL);
+    for (unsigned i = 1; i < SNAPSHOT_SESSIONS && ok; i++) {
+        make_token(token, 2, i);
+        ok = AGLE_SessionLookup(store, token, 64, NOW + 60, NULL);
+    }
+    /* alice's session from the first run is already expired in wall-clock time */
+    expect(ok && AGLE_SessionStoreCount(store) == SNAPSHOT_SESSIONS - 1,
+           "sessions restored from snapshot + log");
+
+    AGLE_PersistClose(p);
+    AGLE_SessionStoreFree(store);
+    AGLE_UserDirFree(dir);
+}
+
+int main(void) {
+    char dir_template[] = "/tmp/agle_persist_XXXXXX";
+    if (mkdtemp(dir_template) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    snprintf(prefix, sizeof(prefix), "%s/store", dir_template);
+    snprintf(wal_path, sizeof(wal_path), "%s.wal", prefix);
+    snprintf(snap_path, sizeof(snap_path), "%s.snap", prefix);
+
+    /* The usual default; files must still come out owner-only */
+    umask(022);
+    run_log_replay();
+    run_torn_tail();
+    run_snapshot();
+
+    unlink(wal_path);
+    unlink(snap_path);
+    rmdir(dir_template);
+
+    return test_finish("persistence");
+}
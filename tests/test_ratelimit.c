@@ -0,0 +1,103 @@
+/*
+ * AGLE rate limiter tests
+ * Burst and refill, independent keys, stale and wrapped clocks, and the
+ * total admitted by concurrent callers against the bucket budget.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "agle.h"
+#include "test_util.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#define THREADS 4
+#define TAKES_PER_THREAD 100000
+
+static unsigned take_n(AGLE_RATE_LIMITER *rl, uint32_t key, unsigned n, uint64_t now) {
+    unsigned allowed = 0;
+    for (unsigned i = 0; i < n; i++) {
+        allowed += AGLE_RateLimitTake(rl, &key, sizeof(key), now);
+    }
+    return allowed;
+}
+
+static void run_basic(void) {
+    AGLE_RATE_LIMITER *rl = AGLE_RateLimiterNew(1024, 10, 20);
+    uint64_t t = 5000000;
+
+    expect(rl != NULL && AGLE_RateLimiterNew(64, 10, 0) == NULL, "new");
+    expect(take_n(rl, 1, 25, t) == 20, "burst then deny");
+    expect(take_n(rl, 2, 20, t) == 20, "other key unaffected");
+    expect(take_n(rl, 1, 5, t + 100) == 1, "refill 10/s over 100 ms");
+    expect(take_n(rl, 1, 50, t + 10000) == 20, "refill capped at burst");
+
+    take_n(rl, 3, 20, t);
+    expect(take_n(rl, 3, 1, t - 500) == 0, "stale clock does not refill");
+    expect(take_n(rl, 3, 1, t + 100) == 1, "stale clock does not rewind");
+
+    /* The 32-bit stamp wraps after ~49 days; an idle key starts full again */
+    take_n(rl, 4, 20, t);
+    expect(take_n(rl, 4, 20, t + ((uint64_t)1 << 32) - 1000000) == 20, "wrapped clock");
+
+    AGLE_RateLimiterFree(rl);
+}
+
+static void run_many_keys(void) {
+    /* Heavy keys drain an eighth of the buckets: light keys still get through */
+    AGLE_RATE_LIMITER *rl = AGLE_RateLimiterNew(256, 1, 5);
+    for (uint32_t k = 100; k < 100 + 16; k++) {
+        take_n(rl, k, 10, 1000);
+    }
+    unsigned light = 0;
+    for (uint32_t k = 1000; k < 1000 + 64; k++) {
+        light += take_n(rl, k, 1, 1000);
+    }
+    expect(light >= 56, "light keys admitted beside heavy ones");
+    AGLE_RateLimiterFree(rl);
+}
+
+typedef struct {
+    AGLE_RATE_LIMITER *rl;
+    unsigned allowed;
+} worker_arg;
+
+static void *worker(void *p) {
+    worker_arg *arg = p;
+    uint32_t key = 42;
+    for (unsigned i = 0; i < TAKES_PER_THREAD; i++) {
+        /* 1 ms of clock every 1000 takes: 100 ms in total */
+        arg->allowed += AGLE_RateLimitTake(arg->rl, &key, sizeof(key), 1000 + i / 1000);
+    }
+    return NULL;
+}
+
+static void run_concurrent(void) {
+    AGLE_RATE_LIMITER *rl = AGLE_RateLimiterNew(1024, 1000, 100);
+    pthread_t threads[THREADS];
+    worker_arg args[THREADS];
+    unsigned total = 0;
+
+    for (unsigned t = 0; t < THREADS; t++) {
+        args[t].rl = rl;
+        args[t].allowed = 0;
+        pthread_create(&threads[t], NULL, worker, &args[t]);
+    }
+    for (unsigned t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+        total += args[t].allowed;
+    }
+
+    /* Burst of 100 plus 1000/s over at most 100 ms */
+    expect(total >= 100 && total <= 100 + 100, "concurrent takes within budget");
+    AGLE_RateLimiterFree(rl);
+}
+
+int main(void) {
+    run_basic();
+    run_many_keys();
+    run_concurrent();
+
+    return test_finish("rate limiter");
+}
@@ -0,0 +1,143 @@
+/*
+ * AGLE replay cache tests
+ * Fresh/replay/stale answers, the window edges, many requests per window
+ * over many windows at fixed memory, and one winner per nonce when threads
+ * race on the same requests.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "agle.h"
+#include "test_util.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#define WINDOW_MS 60000
+#define NOW UINT64_C(1700000000000)
+#define PER_WINDOW 200000
+#define PROBES 1000000
+#define THREADS 4
+#define RACED 50000
+
+static AGLE_ReplayResult check(AGLE_REPLAY_CACHE *c, const char *client, uint64_t nonce,
+                               uint64_t ts, uint64_t now) {
+    return AGLE_ReplayCheck(c, client, strlen(client), &nonce, sizeof(nonce), ts, now);
+}
+
+static void run_basic(void) {
+    AGLE_REPLAY_CACHE *c = AGLE_ReplayCacheNew(WINDOW_MS, 1000);
+
+    expect(c != NULL, "new");
+    expect(check(c, "app", 1, NOW, NOW) == AGLE_REPLAY_FRESH, "fresh");
+    expect(check(c, "app", 1, NOW, NOW) == AGLE_REPLAY_SEEN, "replay");
+    expect(check(c, "app", 2, NOW, NOW) == AGLE_REPLAY_FRESH, "other nonce");
+    expect(check(c, "web", 1, NOW, NOW) == AGLE_REPLAY_FRESH, "other client");
+    expect(AGLE_ReplayCheck(c, "ab", 2, "c", 1, NOW, NOW) == AGLE_REPLAY_FRESH &&
+           AGLE_ReplayCheck(c, "a", 1, "bc", 2, NOW, NOW) == AGLE_REPLAY_FRESH, "split is part of the key");
+    expect(AGLE_ReplayCheck(c, "", 0, "n", 1, NOW, NOW) == AGLE_REPLAY_FRESH &&
+           AGLE_ReplayCheck(c, "app", 3, "n", 0, NOW, NOW) == AGLE_REPLAY_STALE, "empty client, empty nonce");
+
+    /* The window is inclusive both ways */
+    expect(check(c, "app", 10, NOW - WINDOW_MS, NOW) == AGLE_REPLAY_FRESH &&
+           check(c, "app", 11, NOW + WINDOW_MS, NOW) == AGLE_REPLAY_FRESH, "window edges");
+    expect(check(c, "app", 12, NOW - WINDOW_MS - 1, NOW) == AGLE_REPLAY_STALE &&
+           check(c, "app", 13, NOW + WINDOW_MS + 1, NOW) == AGLE_REPLAY_STALE, "outside window");
+
+    /* A replay is caught for as long as its timestamp is accepted */
+    expect(check(c, "app", 1, NOW, NOW + WINDOW_MS) == AGLE_REPLAY_SEEN &&
+           check(c, "app", 1, NOW, NOW + WINDOW_MS + 1) == AGLE_REPLAY_STALE, "remembered for the window");
+
+    expect(AGLE_ReplayCacheNew(3, 1000) == NULL, "window too short");
+    AGLE_ReplayCacheFree(c);
+}
+
+static void run_many(void) {
+    AGLE_REPLAY_CACHE *c = AGLE_ReplayCacheNew(WINDOW_MS, PER_WINDOW);
+    size_t bytes = AGLE_ReplayCacheBytes(c);
+    printf("     %.1f bytes per request in a window\n", (double)bytes / PER_WINDOW);
+    expect(bytes < (size_t)PER_WINDOW * 30, "memory");
+
+    /* PER_WINDOW requests per window, timestamps a little behind arrival */
+    bool all_fresh = true;
+    bool replays_seen = true;
+    uint64_t nonce = 0;
+    for (uint64_t w = 0; w < 30; w++) {
+        uint64_t first = nonce;
+        for (unsigned i = 0; i < PER_WINDOW; i++, nonce++) {
+            uint64_t now = NOW + w * WINDOW_MS + (uint64_t)i * WINDOW_MS / PER_WINDOW;
+            all_fresh &= check(c, "app", nonce, now - nonce % 3000, now) == AGLE_REPLAY_FRESH;
+        }
+        /* Replayed at the last moment each timestamp is still accepted */
+        for (uint64_t n = first; n < nonce; n += 97) {
+            uint64_t ts = NOW + w * WINDOW_MS + (n - first) * WINDOW_MS / PER_WINDOW - n % 3000;
+            replays_seen &= check(c, "app", n, ts, ts + WINDOW_MS) == AGLE_REPLAY_SEEN;
+        }
+    }
+    expect(all_fresh, "30 windows at the expected rate");
+    expect(replays_seen, "replays within the window");
+    expect(AGLE_ReplayCacheBytes(c) == bytes, "memory fixed");
+
+    uint64_t now = NOW + 30 * WINDOW_MS;
+    unsigned false_replays = 0;
+    for (uint64_t i = 0; i < PROBES; i++) {
+        false_replays += check(c, "probe", i, now - i % WINDOW_MS, now) == AGLE_REPLAY_SEEN;
+    }
+    printf("     %u false replays in %u fresh requests\n", false_replays, PROBES);
+    expect(false_replays <= 2, "fresh requests not mistaken for replays");
+    AGLE_ReplayCacheFree(c);
+}
+
+static void run_overload(void) {
+    AGLE_REPLAY_CACHE *c = AGLE_ReplayCacheNew(WINDOW_MS, 1000);
+    unsigned full = 0;
+    bool replays_seen = true;
+    for (uint64_t i = 0; i < 100000; i++) {
+        AGLE_ReplayResult r = check(c, "flood", i, NOW, NOW);
+        full += r == AGLE_REPLAY_FULL;
+        if (r == AGLE_REPLAY_FRESH) {
+            replays_seen &= check(c, "flood", i, NOW, NOW) == AGLE_REPLAY_SEEN;
+        }
+    }
+    expect(full > 0 && replays_seen, "overload fails closed");
+    AGLE_ReplayCacheFree(c);
+}
+
+typedef struct {
+    AGLE_REPLAY_CACHE *cache;
+    unsigned fresh;
+} racer_arg;
+
+static void *racer(void *p) {
+    racer_arg *arg = p;
+    for (uint64_t i = 0; i < RACED; i++) {
+        arg->fresh += check(arg->cache, "shared", i, NOW, NOW) == AGLE_REPLAY_FRESH;
+    }
+    return NULL;
+}
+
+static void run_concurrent(void) {
+    AGLE_REPLAY_CACHE *c = AGLE_ReplayCacheNew(WINDOW_MS, RACED * 4);
+    pthread_t threads[THREADS];
+    racer_arg args[THREADS];
+    for (unsigned t = 0; t < THREADS; t++) {
+        args[t] = (racer_arg){ c, 0 };
+        pthread_create(&threads[t], NULL, racer, &args[t]);
+    }
+    unsigned fresh = 0;
+    for (unsigned t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+        fresh += args[t].fresh;
+    }
+    expect(fresh == RACED, "one winner per nonce");
+    AGLE_ReplayCacheFree(c);
+}
+
+int main(void) {
+    run_basic();
+    run_many();
+    run_overload();
+    run_concurrent();
+
+    return test_finish("replay cache");
+}
@@ -0,0 +1,156 @@
+/*
+ * AGLE revocation set tests
+ * Membership without false answers, deletion, expiry purges that shrink the
+ * set, memory per id, and lookups racing inserts and purges.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "agle.h"
+#include "test_util.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#define IDS 100000
+#define PROBES 1000000
+#define READERS 3
+#define CONCURRENT_IDS 20000
+
+static bool add(AGLE_REVOCATION_SET *set, uint64_t id, int64_t expires_at) {
+    return AGLE_RevocationAdd(set, &id, sizeof(id), expires_at);
+}
+
+static bool contains(AGLE_REVOCATION_SET *set, uint64_t id) {
+    return AGLE_RevocationContains(set, &id, sizeof(id));
+}
+
+static void run_basic(void) {
+    AGLE_REVOCATION_SET *set = AGLE_RevocationSetNew();
+    uint8_t digest[32];
+    memset(digest, 0xab, sizeof(digest));
+
+    expect(set != NULL && AGLE_RevocationCount(set) == 0, "new");
+    expect(!contains(set, 1), "empty set");
+    expect(add(set, 1, 100) && contains(set, 1) && !contains(set, 2), "add");
+    expect(add(set, 1, 200) && AGLE_RevocationCount(set) == 1, "add twice");
+    expect(AGLE_RevocationPurge(set, 150) == 0 && contains(set, 1), "re-add extends expiry");
+
+    expect(AGLE_RevocationAdd(set, digest, sizeof(digest), 100) &&
+           AGLE_RevocationContains(set, digest, sizeof(digest)) &&
+           !AGLE_RevocationContains(set, digest, sizeof(digest) - 1), "variable length ids");
+    expect(!AGLE_RevocationAdd(set, digest, 0, 100), "empty id rejected");
+
+    expect(AGLE_RevocationRemove(set, digest, sizeof(digest)) &&
+           !AGLE_RevocationContains(set, digest, sizeof(digest)) &&
+           !AGLE_RevocationRemove(set, digest, sizeof(digest)), "remove");
+    AGLE_RevocationSetFree(set);
+}
+
+static void run_many(void) {
+    AGLE_REVOCATION_SET *set = AGLE_RevocationSetNew();
+    size_t empty_bytes = AGLE_RevocationSetBytes(set);
+
+    /* Even ids expire at 1000, odd ones at 2000 */
+    bool added = true;
+    for (uint64_t i = 0; i < IDS; i++) {
+        added &= add(set, i * 2654435761u, 1000 + (int64_t)(i % 2) * 1000);
+    }
+    expect(added && AGLE_RevocationCount(set) == IDS, "add many");
+
+    bool all_found = true;
+    for (uint64_t i = 0; i < IDS; i++) {
+        all_found &= contains(set, i * 2654435761u);
+    }
+    expect(all_found, "no false negatives");
+
+    unsigned false_positives = 0;
+    for (uint64_t i = 0; i < PROBES; i++) {
+        false_positives += contains(set, (i << 40) | 1);
+    }
+    expect(false_positives == 0, "fingerprint matches confirmed exactly");
+
+    size_t full_bytes = AGLE_RevocationSetBytes(set);
+    printf("     %.1f bytes per id\n", (double)(full_bytes - empty_bytes) / IDS);
+    expect(full_bytes - empty_bytes < (size_t)IDS * 80, "memory proportional to ids");
+
+    bool removed = true;
+    for (uint64_t i = 0; i < IDS; i += 4) {
+        removed &= AGLE_RevocationRemove(set, &(uint64_t){ i * 2654435761u }, sizeof(uint64_t));
+    }
+    all_found = true;
+    for (uint64_t i = 1; i < IDS; i++) {
+        if (i % 4 != 0) all_found &= contains(set, i * 2654435761u);
+    }
+    expect(removed && !contains(set, 0) && all_found, "remove keeps the others");
+
+    expect(AGLE_RevocationPurge(set, 999) == 0, "purge before expiry");
+    expect(AGLE_RevocationPurge(set, 1000) == IDS / 4 &&
+           AGLE_RevocationCount(set) == IDS / 2, "purge drops expired");
+    all_found = true;
+    for (uint64_t i = 1; i < IDS; i += 2) {
+        all_found &= contains(set, i * 2654435761u);
+    }
+    expect(all_found && !contains(set, 2 * 2654435761u), "survivors after purge");
+
+    size_t half_bytes = AGLE_RevocationSetBytes(set);
+    expect(half_bytes < full_bytes, "purge shrinks");
+    expect(AGLE_RevocationPurge(set, 2000) == IDS / 2 && AGLE_RevocationCount(set) == 0 &&
+           AGLE_RevocationSetBytes(set) < half_bytes / 16, "purge to empty");
+    AGLE_RevocationSetFree(set);
+}
+
+typedef struct {
+    AGLE_REVOCATION_SET *set;
+    volatile bool *done;
+    unsigned misses;
+} reader_arg;
+
+/* Ids below 1000 stay revoked while others are added and purged around them */
+static void *reader(void *p) {
+    reader_arg *arg = p;
+    while (!*arg->done) {
+        for (uint64_t i = 0; i < 1000; i++) {
+            arg->misses += !contains(arg->set, i);
+        }
+    }
+    return NULL;
+}
+
+static void run_concurrent(void) {
+    AGLE_REVOCATION_SET *set = AGLE_RevocationSetNew();
+    for (uint64_t i = 0; i < 1000; i++) {
+        add(set, i, 1000000);
+    }
+
+    volatile bool done = false;
+    pthread_t threads[READERS];
+    reader_arg args[READERS];
+    for (unsigned t = 0; t < READERS; t++) {
+        args[t] = (reader_arg){ set, &done, 0 };
+        pthread_create(&threads[t], NULL, reader, &args[t]);
+    }
+    for (int64_t round = 1; round <= 5; round++) {
+        for (uint64_t i = 0; i < CONCURRENT_IDS; i++) {
+            add(set, ((uint64_t)round << 32) | i, round);
+        }
+        AGLE_RevocationPurge(set, round);
+    }
+    done = true;
+
+    unsigned misses = 0;
+    for (unsigned t = 0; t < READERS; t++) {
+        pthread_join(threads[t], NULL);
+        misses += args[t].misses;
+    }
+    expect(misses == 0 && AGLE_RevocationCount(set) == 1000, "lookups during rebuilds");
+    AGLE_RevocationSetFree(set);
+}
+
+int main(void) {
+    run_basic();
+    run_many();
+    run_concurrent();
+
+    return test_finish("revocation set");
+}
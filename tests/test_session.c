@@ -0,0 +1,260 @@
+/*
+ * AGLE session store tests
+ * Insert/lookup/remove semantics, expiry, growth far past the initial size,
+ * timing-wheel expiry, concurrent use from several threads and checked
+ * token generation and validation.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "agle.h"
+#include "test_util.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#define GROWTH_SESSIONS 100000
+#define BATCH 1000
+#define THREADS 4
+#define PER_THREAD 20000
+#define WHEEL_SESSIONS 5000
+#define WHEEL_BASE 1700000000
+#define DAY 86400
+
+static void run_basic(void) {
+    AGLE_SESSION_STORE *store = AGLE_SessionStoreNew(0);
+    char token[65];
+    AGLE_SessionInfo info = make_info("alice", 1000, 2000);
+    AGLE_SessionInfo out;
+
+    make_token(token, 1, 1);
+    expect(AGLE_SessionInsert(store, token, 64, &info), "insert");
+    expect(!AGLE_SessionInsert(store, token, 64, &info), "duplicate rejected");
+    expect(AGLE_SessionLookup(store, token, 64, 1500, &out) &&
+           strcmp(out.username, "alice") == 0 && out.expires_at == 2000,
+           "lookup");
+    expect(!AGLE_SessionLookup(store, token, 63, 1500, NULL), "prefix not found");
+    expect(!AGLE_SessionLookup(store, token, 64, 2000, NULL), "expired hidden");
+
+    make_token(token, 1, 2);
+    expect(!AGLE_SessionLookup(store, token, 64, 1500, NULL), "unknown token");
+    expect(!AGLE_SessionRemove(store, token, 64, NULL), "remove unknown");
+
+    make_token(token, 1, 1);
+    expect(AGLE_SessionRemove(store, token, 64, &out) &&
+           strcmp(out.username, "alice") == 0, "remove");
+    expect(!AGLE_SessionLookup(store, token, 64, 1500, NULL), "removed hidden");
+    expect(AGLE_SessionStoreCount(store) == 0, "count after remove");
+
+    AGLE_SessionStoreFree(store);
+}
+
+static void run_growth_and_purge(void) {
+    AGLE_SESSION_STORE *store = AGLE_SessionStoreNew(0);
+    char token[65];
+    bool ok = true;
+
+    for (unsigned i = 0; i < GROWTH_SESSIONS; i++) {
+        AGLE_SessionInfo info = make_info("bulk", 1000, (i % 2) ? 5000 : 1500);
+        make_token(token, 2, i);
+        ok &= AGLE_SessionInsert(store, token, 64, &info);
+    }
+    expect(ok && AGLE_SessionStoreCount(store) == GROWTH_SESSIONS, "growth insert");
+    expect(AGLE_SessionStoreCapacity(store) * 3 >= GROWTH_SESSIONS * 4, "capacity above load limit");
+
+    for (unsigned i = 0; i < GROWTH_SESSIONS && ok; i++) {
+        make_token(token, 2, i);
+        ok = AGLE_SessionLookup(store, token, 64, 1000, NULL);
+    }
+    expect(ok, "growth lookup");
+
+    expect(AGLE_SessionStorePurge(store, 1500) == GROWTH_SESSIONS / 2 &&
+           AGLE_SessionStoreCount(store) == GROWTH_SESSIONS / 2, "purge expired");
+
+    for (unsigned i = 0; i < GROWTH_SESSIONS && ok; i++) {
+        make_token(token, 2, i);
+        ok = AGLE_SessionLookup(store, token, 64, 1000, NULL) == ((i % 2) != 0);
+    }
+    expect(ok, "lookup after purge");
+
+    /* Batch across several windows: live, expired, unknown and NULL tokens */
+    static char batch_tokens[BATCH][65];
+    static const char *ptrs[BATCH];
+    static size_t lens[BATCH];
+    static AGLE_SessionInfo infos[BATCH];
+    static bool found[BATCH];
+    size_t live = 0;
+    for (unsigned i = 0; i < BATCH; i++) {
+        make_token(batch_tokens[i], i % 5 == 0 ? 3 : 2, i * 7);
+        ptrs[i] = i == BATCH - 1 ? NULL : batch_tokens[i];
+        lens[i] = 64;
+        live += i % 5 != 0 && (i * 7) % 2 != 0 && i != BATCH - 1;
+    }
+    size_t hits = AGLE_SessionLookupBatch(store, ptrs, lens, BATCH, 1000, infos, found);
+    ok = hits == live;
+    for (unsigned i = 0; i < BATCH && ok; i++) {
+        bool single = ptrs[i] != NULL && AGLE_SessionLookup(store, ptrs[i], 64, 1000, NULL);
+        ok = found[i] == single &&
+             (found[i] ? strcmp(infos[i].username, "bulk") == 0 : infos[i].expires_at == 0);
+    }
+    expect(ok, "batch lookup matches single lookups");
+
+    AGLE_SessionStoreFree(store);
+}
+
+static int64_t wheel_expiry(unsigned i) {
+    /* Spread over every wheel level, plus a few beyond its ~194-day span */
+    if (i % 500 == 0) return WHEEL_BASE + 300 * DAY;
+    if (i % 7 == 0) return WHEEL_BASE + 1 + (i * 7919u) % (5 * DAY);
+    return WHEEL_BASE + 1 + (i * 37u) % 9000;
+}
+
+static void run_wheel(void) {
+    AGLE_SESSION_STORE *store = AGLE_SessionStoreNew(0);
+    char token[65];
+    bool ok = true;
+
+    for (unsigned i = 0; i < WHEEL_SESSIONS; i++) {
+        AGLE_SessionInfo info = make_info("wheel", WHEEL_BASE, wheel_expiry(i));
+        make_token(token, 3, i);
+        ok &= AGLE_SessionInsert(store, token, 64, &info);
+    }
+    /* Logged out early: their wheel entries must be skipped */
+    for (unsigned i = 1; i < WHEEL_SESSIONS; i += 11) {
+        make_token(token, 3, i);
+        ok &= AGLE_SessionRemove(store, token, 64, NULL);
+    }
+    expect(ok, "wheel insert");
+
+    AGLE_SessionStoreTick(store, WHEEL_BASE);
+    for (int64_t now = WHEEL_BASE; now <= WHEEL_BASE + 6 * DAY && ok; now += 13) {
+        AGLE_SessionStoreTick(store, now);
+        size_t live = 0;
+        for (unsigned i = 0; i < WHEEL_SESSIONS; i++) {
+            if (i % 11 != 1 && wheel_expiry(i) > now) live++;
+        }
+        if (AGLE_SessionStoreCount(store) != live) {
+            printf("  at +%lld s: %zu sessions, expected %zu\n",
+                   (long long)(now - WHEEL_BASE), AGLE_SessionStoreCount(store), live);
+            ok = false;
+        }
+        if (now > WHEEL_BASE + 9100) now += 3600;   /* Sparse checks for the long tail */
+    }
+    expect(ok, "wheel expires exactly what is due");
+
+    /* A jump past the wheel span takes the rebase path */
+    AGLE_SessionStoreTick(store, WHEEL_BASE + 301 * DAY);
+    expect(AGLE_SessionStoreCount(store) == 0, "wheel clock jump");
+
+    AGLE_SessionStoreFree(store);
+}
+
+typedef struct {
+    AGLE_SESSION_STORE *store;
+    unsigned id;
+    bool ok;
+} worker_arg;
+
+static void *worker(void *p) {
+    worker_arg *arg = p;
+    char token[65];
+    AGLE_SessionInfo info = make_info("worker", 1000, 5000);
+    AGLE_SessionInfo out;
+
+    arg->ok = true;
+    for (unsigned i = 0; i < PER_THREAD; i++) {
+        make_token(token, 100 + arg->id, i);
+        arg->ok &= AGLE_SessionInsert(arg->store, token, 64, &info);
+        arg->ok &= AGLE_SessionLookup(arg->store, token, 64, 1000, &out);
+        if (i % 3 == 0) {
+            arg->ok &= AGLE_SessionRemove(arg->store, token, 64, NULL);
+        }
+    }
+    return NULL;
+}
+
+static void run_concurrent(void) {
+    AGLE_SESSION_STORE *store = AGLE_SessionStoreNew(0);
+    pthread_t threads[THREADS];
+    worker_arg args[THREADS];
+    bool ok = true;
+
+    for (unsigned t = 0; t < THREADS; t++) {
+        args[t].store = store;
+        args[t].id = t;
+        pthread_create(&threads[t], NULL, worker, &args[t]);
+    }
+    for (unsigned t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+        ok &= args[t].ok;
+    }
+
+    size_t live = THREADS * (PER_THREAD - (PER_THREAD + 2) / 3);
+    expect(ok && AGLE_SessionStoreCount(store) == live, "concurrent insert/lookup/remove");
+
+    AGLE_SessionStoreFree(store);
+}
+
+/* Bitwise CRC32C, independent of the library's table and SSE4.2 paths */
+static uint32_t crc32c_ref(const char *p, size_t len) {
+    uint32_t crc = 0xffffffffu;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint8_t)p[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0x82f63b78u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+static void run_checked_tokens(void) {
+    AGLE_CTX ctx;
+    char token[AGLE_CHECKED_TOKEN_LEN(512) + 2];
+    size_t len = AGLE_CHECKED_TOKEN_LEN(32);
+
+    expect(AGLE_Init(&ctx) && AGLE_GenerateSessionTokenChecked(&ctx, token, 32) &&
+           strlen(token) == len && strncmp(token, "agle_", 5) == 0, "checked token format");
+    expect(AGLE_CheckSessionToken(token, len), "checked token accepted");
+
+    char expected[9];
+    snprintf(expected, sizeof(expected), "%08x", crc32c_ref(token, len - 8));
+    expect(strcmp(token + len - 8, expected) == 0, "checksum is CRC32C");
+    expect(crc32c_ref("123456789", 9) == 0xe3069283u, "reference CRC32C");
+
+    bool all_rejected = true;
+    char bad[sizeof(token)];
+    for (size_t i = 0; i < len; i++) {
+        memcpy(bad, token, len + 1);
+        bad[i] = bad[i] == '0' ? '1' : '0';
+        all_rejected &= !AGLE_CheckSessionToken(bad, len);
+    }
+    expect(all_rejected, "any changed character rejected");
+    expect(!AGLE_CheckSessionToken(token, len - 1) && !AGLE_CheckSessionToken(token, len - 2),
+           "truncated token rejected");
+
+    /* Random strings of the right length and prefix almost never pass */
+    unsigned passed = 0;
+    for (unsigned i = 0; i < 100000; i++) {
+        snprintf(bad, sizeof(bad), "agle_%064x%08x", i * 2654435761u, i);
+        passed += AGLE_CheckSessionToken(bad, len);
+    }
+    expect(passed == 0, "random strings rejected");
+
+    bool sizes_ok = true;
+    for (size_t bytes = 16; bytes <= 512; bytes += 62) {
+        sizes_ok &= AGLE_GenerateSessionTokenChecked(&ctx, token, bytes) &&
+                    AGLE_CheckSessionToken(token, strlen(token));
+    }
+    expect(sizes_ok && !AGLE_GenerateSessionTokenChecked(&ctx, token, 15), "token sizes");
+    AGLE_Cleanup(&ctx);
+}
+
+int main(void) {
+    run_basic();
+    run_growth_and_purge();
+    run_wheel();
+    run_concurrent();
+    run_checked_tokens();
+
+    return test_finish("session store");
+}
@@ -0,0 +1,119 @@
+/*
+ * AGLE splittable generator tests
+ * Children and grandchildren differ from each other and from the parent,
+ * the same seeded parent yields the same children, and separate kernel-
+ * seeded parents do not.
+ */
+
+#include "agle.h"
+#include "test_util.h"
+#include <stdio.h>
+#include <string.h>
+
+#define CHILDREN 64
+#define OUT_LEN 32
+
+static const uint8_t SEED[] = "split test seed";
+
+/* First OUT_LEN bytes of each of CHILDREN children, in split order */
+static bool draw_children(AGLE_CTX *parent, uint8_t out[CHILDREN][OUT_LEN]) {
+    bool ok = true;
+    for (size_t i = 0; i < CHILDREN; i++) {
+        AGLE_SPLIT_CTX child;
+        ok &= AGLE_Split(parent, &child) && AGLE_SplitGetRandomBytes(&child, out[i], OUT_LEN);
+        AGLE_SplitCleanup(&child);
+    }
+    return ok;
+}
+
+static bool all_distinct(uint8_t rows[][OUT_LEN], size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = i + 1; j < n; j++) {
+            if (memcmp(rows[i], rows[j], OUT_LEN) == 0) return false;
+        }
+    }
+    return true;
+}
+
+static void run_distinct(void) {
+    static uint8_t rows[CHILDREN + 1][OUT_LEN];
+    AGLE_CTX parent;
+
+    bool ok = AGLE_InitSeeded(&parent, SEED, sizeof(SEED) - 1) &&
+              draw_children(&parent, rows) &&
+              AGLE_GetRandomBytes(&parent, rows[CHILDREN], OUT_LEN);
+    expect(ok, "split 64 children");
+    expect(all_distinct(rows, CHILDREN), "children differ from each other");
+    expect(all_distinct(rows, CHILDREN + 1), "children differ from the parent");
+
+    /* A child's own stream moves on between draws */
+    AGLE_SPLIT_CTX child;
+    uint8_t a[OUT_LEN], b[OUT_LEN];
+    ok = AGLE_Split(&parent, &child) &&
+         AGLE_SplitGetRandomBytes(&child, a, sizeof(a)) &&
+         AGLE_SplitGetRandomBytes(&child, b, sizeof(b));
+    expect(ok && memcmp(a, b, sizeof(a)) != 0, "child stream advances");
+
+    /* Grandchildren: distinct from their siblings and from their parent */
+    static uint8_t grand[CHILDREN + 1][OUT_LEN];
+    ok = true;
+    for (size_t i = 0; i < CHILDREN; i++) {
+        AGLE_SPLIT_CTX g;
+        ok &= AGLE_SplitChild(&child, &g) && AGLE_SplitGetRandomBytes(&g, grand[i], OUT_LEN);
+        AGLE_SplitCleanup(&g);
+    }
+    ok &= AGLE_SplitGetRandomBytes(&child, grand[CHILDREN], OUT_LEN);
+    expect(ok && all_distinct(grand, CHILDREN + 1), "grandchildren differ");
+
+    expect(!AGLE_SplitChild(&child, &child) && !AGLE_Split(&parent, NULL) &&
+           !AGLE_Split(NULL, &child), "bad arguments rejected");
+    AGLE_SplitCleanup(&child);
+    AGLE_Cleanup(&parent);
+}
+
+static void run_reproducible(void) {
+    static uint8_t first[CHILDREN][OUT_LEN], second[CHILDREN][OUT_LEN];
+    AGLE_CTX a, b;
+
+    bool ok = AGLE_InitSeeded(&a, SEED, sizeof(SEED) - 1) && draw_children(&a, first) &&
+              AGLE_InitSeeded(&b, SEED, sizeof(SEED) - 1) && draw_children(&b, second);
+    expect(ok && memcmp(first, second, sizeof(first)) == 0, "same seed, same children");
+    AGLE_Cleanup(&a);
+    AGLE_Cleanup(&b);
+
+    /* Grandchildren follow the same rule */
+    AGLE_SPLIT_CTX ca, cb, ga, gb;
+    uint8_t out_a[OUT_LEN], out_b[OUT_LEN];
+    ok = AGLE_InitSeeded(&a, SEED, sizeof(SEED) - 1) &&
+         AGLE_InitSeeded(&b, SEED, sizeof(SEED) - 1) &&
+         AGLE_Split(&a, &ca) && AGLE_Split(&b, &cb) &&
+         AGLE_SplitChild(&ca, &ga) && AGLE_SplitChild(&cb, &gb) &&
+         AGLE_SplitGetRandomBytes(&ga, out_a, sizeof(out_a)) &&
+         AGLE_SplitGetRandomBytes(&gb, out_b, sizeof(out_b));
+    expect(ok && memcmp(out_a, out_b, sizeof(out_a)) == 0, "same seed, same grandchildren");
+    AGLE_SplitCleanup(&ca);
+    AGLE_SplitCleanup(&cb);
+    AGLE_SplitCleanup(&ga);
+    AGLE_SplitCleanup(&gb);
+    AGLE_Cleanup(&a);
+    AGLE_Cleanup(&b);
+
+    static const uint8_t OTHER[] = "split test seeD";
+    ok = AGLE_InitSeeded(&a, OTHER, sizeof(OTHER) - 1) && draw_children(&a, second);
+    expect(ok && memcmp(first, second, OUT_LEN) != 0, "other seed, other children");
+    AGLE_Cleanup(&a);
+
+    /* Kernel-seeded parents never share children */
+    ok = AGLE_Init(&a) && draw_children(&a, first) &&
+         AGLE_Init(&b) && draw_children(&b, second);
+    expect(ok && memcmp(first[0], second[0], OUT_LEN) != 0, "kernel-seeded parents differ");
+    AGLE_Cleanup(&a);
+    AGLE_Cleanup(&b);
+}
+
+int main(void) {
+    run_distinct();
+    run_reproducible();
+
+    return test_finish("split");
+}
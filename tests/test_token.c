@@ -0,0 +1,192 @@
+/*
+ * AGLE signed token tests
+ * Round trip, tag against a one-shot KMAC256, tampering and encoding
+ * checks, expiry, key rotation and revocation.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "agle.h"
+#include "test_util.h"
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/params.h>
+#include <stdio.h>
+#include <string.h>
+
+#define NOW 1700000000
+#define REVOKED 500
+
+static const uint8_t KEY_A[32] = "0123456789abcdef0123456789abcdef";
+static const uint8_t KEY_B[32] = "fedcba9876543210fedcba9876543210";
+
+static bool verify(AGLE_TOKEN_SIGNER *s, const char *token, int64_t now) {
+    return AGLE_TokenVerify(s, token, strlen(token), now, NULL);
+}
+
+/* Plain base64url decoding, independent of the library's */
+static size_t b64_decode(const char *in, uint8_t *out) {
+    static const char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+    uint32_t acc = 0;
+    int bits = 0;
+    size_t n = 0;
+    for (; *in; in++) {
+        acc = (acc << 6) | (uint32_t)(strchr(alphabet, *in) - alphabet);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out[n++] = (uint8_t)(acc >> bits);
+        }
+    }
+    return n;
+}
+
+static void run_round_trip(AGLE_CTX *ctx) {
+    AGLE_TOKEN_SIGNER *s = AGLE_TokenSignerNew(7, KEY_A, sizeof(KEY_A));
+    char token[AGLE_SIGNED_TOKEN_LEN + 1];
+    AGLE_TokenClaims issued, got;
+
+    expect(s != NULL, "new");
+    expect(AGLE_TokenIssue(s, ctx, 42, NOW + 3600, token, &issued), "issue");
+    expect(strlen(token) == AGLE_SIGNED_TOKEN_LEN &&
+           strncmp(token, AGLE_SIGNED_TOKEN_PREFIX, 4) == 0, "format");
+    expect(AGLE_TokenVerify(s, token, strlen(token), NOW, &got) &&
+           got.user_id == 42 && got.key_id == 7 && got.expires_at == NOW + 3600 &&
+           got.token_id == issued.token_id && got.token_id != 0, "verify claims");
+
+    /* The tag is KMAC256(key, payload, 16 bytes, custom string) */
+    uint8_t raw[40];
+    uint8_t tag[16];
+    size_t tag_len = sizeof(tag);
+    size_t out_len = 0;
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_CUSTOM, "AGLE signed token v1", 20),
+        OSSL_PARAM_construct_size_t(OSSL_MAC_PARAM_SIZE, &tag_len),
+        OSSL_PARAM_construct_end()
+    };
+    bool same = b64_decode(token + 4, raw) == sizeof(raw) &&
+                EVP_Q_mac(NULL, "KMAC256", NULL, NULL, params, KEY_A, sizeof(KEY_A),
+                          raw, 24, tag, sizeof(tag), &out_len) != NULL &&
+                out_len == sizeof(tag) && memcmp(tag, raw + 24, sizeof(tag)) == 0;
+    expect(same, "tag matches one-shot KMAC256");
+
+    expect(!verify(s, token, NOW + 3600), "expired");
+
+    AGLE_TOKEN_SIGNER *other = AGLE_TokenSignerNew(7, KEY_B, sizeof(KEY_B));
+    expect(!verify(other, token, NOW), "other key rejects");
+    AGLE_TokenSignerFree(other);
+
+    AGLE_TOKEN_SIGNER *random = AGLE_TokenSignerNew(7, NULL, 0);
+    expect(random != NULL && !verify(random, token, NOW), "random key rejects");
+    AGLE_TokenSignerFree(random);
+
+    AGLE_TokenSignerFree(s);
+}
+
+static void run_malformed(AGLE_CTX *ctx) {
+    AGLE_TOKEN_SIGNER *s = AGLE_TokenSignerNew(1, KEY_A, sizeof(KEY_A));
+    char token[AGLE_SIGNED_TOKEN_LEN + 1];
+    char bad[AGLE_SIGNED_TOKEN_LEN + 2];
+    AGLE_TokenIssue(s, ctx, 5, NOW + 60, token, NULL);
+
+    bool all_rejected = true;
+    for (size_t i = 0; i < AGLE_SIGNED_TOKEN_LEN; i++) {
+        memcpy(bad, token, sizeof(token));
+        bad[i] = bad[i] == 'A' ? 'B' : 'A';
+        all_rejected &= !verify(s, bad, NOW);
+    }
+    expect(all_rejected, "any changed character rejects");
+
+    /* 40 bytes leave 4 unused bits in the last character */
+    memcpy(bad, token, sizeof(token));
+    const char *alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+    int last = (int)(strchr(alphabet, bad[AGLE_SIGNED_TOKEN_LEN - 1]) - alphabet);
+    bad[AGLE_SIGNED_TOKEN_LEN - 1] = alphabet[last | 1];
+    expect(!verify(s, bad, NOW), "non-canonical encoding rejects");
+
+    expect(!AGLE_TokenVerify(s, token, AGLE_SIGNED_TOKEN_LEN - 1, NOW, NULL), "truncated");
+    memcpy(bad, token, sizeof(token));
+    bad[AGLE_SIGNED_TOKEN_LEN] = 'A';
+    bad[AGLE_SIGNED_TOKEN_LEN + 1] = '\0';
+    expect(!verify(s, bad, NOW), "extended");
+    expect(!verify(s, "st1.", NOW) && !verify(s, "", NOW), "short input");
+
+    expect(AGLE_TokenSignerNew(1, KEY_A, 8) == NULL, "short key rejected");
+    AGLE_TokenSignerFree(s);
+}
+
+static void run_rotation(AGLE_CTX *ctx) {
+    AGLE_TOKEN_SIGNER *s = AGLE_TokenSignerNew(1, KEY_A, sizeof(KEY_A));
+    char old_token[AGLE_SIGNED_TOKEN_LEN + 1];
+    char new_token[AGLE_SIGNED_TOKEN_LEN + 1];
+    AGLE_TokenClaims c;
+
+    AGLE_TokenIssue(s, ctx, 9, NOW + 60, old_token, NULL);
+    expect(!AGLE_TokenSignerAddKey(s, 1, KEY_B, sizeof(KEY_B)), "duplicate key id");
+    expect(AGLE_TokenSignerAddKey(s, 2, KEY_B, sizeof(KEY_B)), "add key");
+    AGLE_TokenIssue(s, ctx, 9, NOW + 60, new_token, &c);
+    expect(c.key_id == 2, "new key signs");
+    expect(verify(s, old_token, NOW) && verify(s, new_token, NOW), "both keys verify");
+
+    AGLE_TOKEN_SIGNER *only_a = AGLE_TokenSignerNew(1, KEY_A, sizeof(KEY_A));
+    expect(verify(only_a, old_token, NOW) && !verify(only_a, new_token, NOW), "unknown key id");
+    AGLE_TokenSignerFree(only_a);
+
+    AGLE_TokenSignerAddKey(s, 3, KEY_A, sizeof(KEY_A));
+    AGLE_TokenSignerAddKey(s, 4, KEY_B, sizeof(KEY_B));
+    expect(!AGLE_TokenSignerAddKey(s, 5, KEY_A, sizeof(KEY_A)), "key limit");
+    AGLE_TokenSignerFree(s);
+}
+
+static void run_revocation(AGLE_CTX *ctx) {
+    AGLE_TOKEN_SIGNER *s = AGLE_TokenSignerNew(1, KEY_A, sizeof(KEY_A));
+    static char tokens[REVOKED][AGLE_SIGNED_TOKEN_LEN + 1];
+    AGLE_TokenClaims c;
+
+    /* Half expire at NOW + 10, half at NOW + 1000 */
+    bool revoked_ok = true;
+    for (int i = 0; i < REVOKED; i++) {
+        AGLE_TokenIssue(s, ctx, (uint32_t)i, NOW + (i % 2 ? 1000 : 10), tokens[i], &c);
+        revoked_ok &= AGLE_TokenRevoke(s, &c);
+    }
+    expect(revoked_ok && AGLE_TokenRevokedCount(s) == REVOKED, "revoke");
+    expect(AGLE_TokenRevoke(s, &c) && AGLE_TokenRevokedCount(s) == REVOKED, "revoke twice");
+
+    bool all_rejected = true;
+    for (int i = 0; i < REVOKED; i++) {
+        all_rejected &= !verify(s, tokens[i], NOW);
+    }
+    expect(all_rejected, "revoked tokens rejected");
+
+    char live[AGLE_SIGNED_TOKEN_LEN + 1];
+    AGLE_TokenIssue(s, ctx, 1, NOW + 1000, live, NULL);
+    expect(verify(s, live, NOW), "unrevoked token accepted");
+
+    expect(AGLE_TokenPurgeRevoked(s, NOW) == 0, "purge keeps live entries");
+    expect(AGLE_TokenPurgeRevoked(s, NOW + 10) == REVOKED / 2 &&
+           AGLE_TokenRevokedCount(s) == REVOKED / 2, "purge drops expired");
+    all_rejected = true;
+    for (int i = 1; i < REVOKED; i += 2) {
+        all_rejected &= !verify(s, tokens[i], NOW + 10);
+    }
+    expect(all_rejected, "survivors still revoked");
+    AGLE_TokenSignerFree(s);
+}
+
+int main(void) {
+    AGLE_CTX ctx;
+    if (!AGLE_Init(&ctx)) {
+        printf("FAIL init\n");
+        return 1;
+    }
+
+    run_round_trip(&ctx);
+    run_malformed(&ctx);
+    run_rotation(&ctx);
+    run_revocation(&ctx);
+
+    AGLE_Cleanup(&ctx);
+
+    return test_finish("signed token");
+}
@@ -0,0 +1,135 @@
+/*
+ * AGLE user directory tests
+ * Add/find/get semantics, growth to a large account count and concurrent
+ * lockout counters against concurrent inserts.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "agle.h"
+#include "test_util.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#define BULK_USERS 200000
+#define THREADS 4
+#define FAILURES_PER_THREAD 10000
+
+static void run_basic(void) {
+    AGLE_USER_DIR *dir = AGLE_UserDirNew(0);
+    uint8_t salt[AGLE_USER_SALT_LEN], hash[AGLE_USER_HASH_LEN];
+    char long_name[AGLE_USERNAME_MAX + 1];
+    AGLE_UserRecord rec;
+    uint32_t id, found;
+
+    fill(salt, sizeof(salt), 1);
+    fill(hash, sizeof(hash), 2);
+    memset(long_name, 'x', sizeof(long_name) - 1);
+    long_name[sizeof(long_name) - 1] = '\0';
+
+    expect(AGLE_UserDirAdd(dir, "alice", salt, hash, 100000, &id) && id == 0, "add");
+    expect(!AGLE_UserDirAdd(dir, "alice", salt, hash, 0, NULL), "duplicate rejected");
+    expect(!AGLE_UserDirAdd(dir, "", salt, hash, 0, NULL), "empty name rejected");
+    expect(!AGLE_UserDirAdd(dir, long_name, salt, hash, 0, NULL), "long name rejected");
+    expect(AGLE_UserDirFind(dir, "alice", &found) && found == id, "find");
+    expect(!AGLE_UserDirFind(dir, "alic", NULL) && !AGLE_UserDirFind(dir, "alicea", NULL),
+           "near names not found");
+    expect(AGLE_UserDirGet(dir, id, &rec) && strcmp(rec.username, "alice") == 0 &&
+           memcmp(rec.salt, salt, sizeof(salt)) == 0 &&
+           memcmp(rec.hash, hash, sizeof(hash)) == 0 && rec.kdf_iterations == 100000, "get");
+    expect(!AGLE_UserDirGet(dir, 1, &rec), "get out of range");
+
+    expect(AGLE_UserDirNoteFailure(dir, id) == 1 && AGLE_UserDirNoteFailure(dir, id) == 2,
+           "failure count");
+    AGLE_UserDirLock(dir, id, 12345);
+    expect(AGLE_UserDirLockedUntil(dir, id) == 12345, "lock");
+    AGLE_UserDirNoteSuccess(dir, id);
+    expect(AGLE_UserDirGet(dir, id, &rec) && rec.failed_attempts == 0 && rec.locked_until == 0,
+           "success resets lockout");
+
+    AGLE_UserDirFree(dir);
+}
+
+static void run_bulk(void) {
+    AGLE_USER_DIR *dir = AGLE_UserDirNew(0);
+    uint8_t salt[AGLE_USER_SALT_LEN], hash[AGLE_USER_HASH_LEN];
+    char name[32];
+    bool ok = true;
+
+    for (unsigned i = 0; i < BULK_USERS && ok; i++) {
+        snprintf(name, sizeof(name), "user%u", i);
+        fill(salt, sizeof(salt), i);
+        fill(hash, sizeof(hash), ~i);
+        uint32_t id;
+        ok = AGLE_UserDirAdd(dir, name, salt, hash, 0, &id) && id == i;
+    }
+    expect(ok && AGLE_UserDirCount(dir) == BULK_USERS, "bulk add");
+
+    for (unsigned i = 0; i < BULK_USERS && ok; i++) {
+        AGLE_UserRecord rec;
+        uint32_t id;
+        snprintf(name, sizeof(name), "user%u", i);
+        fill(salt, sizeof(salt), i);
+        ok = AGLE_UserDirFind(dir, name, &id) && id == i &&
+             AGLE_UserDirGet(dir, id, &rec) && strcmp(rec.username, name) == 0 &&
+             memcmp(rec.salt, salt, sizeof(salt)) == 0;
+    }
+    expect(ok, "bulk find");
+
+    AGLE_UserDirFree(dir);
+}
+
+typedef struct {
+    AGLE_USER_DIR *dir;
+    unsigned id;
+} worker_arg;
+
+static void *worker(void *p) {
+    worker_arg *arg = p;
+    uint8_t salt[AGLE_USER_SALT_LEN] = {0}, hash[AGLE_USER_HASH_LEN] = {0};
+    char name[32];
+
+    for (unsigned i = 0; i < FAILURES_PER_THREAD; i++) {
+        AGLE_UserDirNoteFailure(arg->dir, 0);
+        if (i % 4 == 0) {
+            /* Inserts grow the columns while other threads update counters */
+            snprintf(name, sizeof(name), "t%u-%u", arg->id, i);
+            AGLE_UserDirAdd(arg->dir, name, salt, hash, 0, NULL);
+        }
+    }
+    return NULL;
+}
+
+static void run_concurrent(void) {
+    AGLE_USER_DIR *dir = AGLE_UserDirNew(0);
+    uint8_t salt[AGLE_USER_SALT_LEN] = {0}, hash[AGLE_USER_HASH_LEN] = {0};
+    pthread_t threads[THREADS];
+    worker_arg args[THREADS];
+    AGLE_UserRecord rec;
+
+    AGLE_UserDirAdd(dir, "target", salt, hash, 0, NULL);
+    for (unsigned t = 0; t < THREADS; t++) {
+        args[t].dir = dir;
+        args[t].id = t;
+        pthread_create(&threads[t], NULL, worker, &args[t]);
+    }
+    for (unsigned t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    expect(AGLE_UserDirGet(dir, 0, &rec) &&
+           rec.failed_attempts == THREADS * FAILURES_PER_THREAD &&
+           AGLE_UserDirCount(dir) == 1 + THREADS * FAILURES_PER_THREAD / 4,
+           "concurrent failures and inserts");
+
+    AGLE_UserDirFree(dir);
+}
+
+int main(void) {
+    run_basic();
+    run_bulk();
+    run_concurrent();
+
+    return test_finish("user directory");
+}
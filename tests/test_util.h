@@ -0,0 +1,58 @@
+/*
+ * Helpers shared by the AGLE test programs
+ * A pass/fail counter with one line per check, the summary for main(), and
+ * fixtures for session and user records. Everything is static inline so
+ * each test includes only what it uses without unused-function warnings.
+ */
+
+#ifndef AGLE_TEST_UTIL_H
+#define AGLE_TEST_UTIL_H
+
+#include "agle.h"
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+static inline void expect(bool cond, const char *name) {
+    if (!cond) {
+        printf("FAIL %s\n", name);
+        failures++;
+    } else {
+        printf("ok   %s\n", name);
+    }
+}
+
+/* Summary line and exit status, e.g. return test_finish("session store") */
+static inline int test_finish(const char *what) {
+    if (failures > 0) {
+        printf("%d %s test(s) failed\n", failures, what);
+        return 1;
+    }
+    printf("All %s tests passed\n", what);
+    return 0;
+}
+
+/* 64 hex digits, unique per (tag, i); out holds at least 65 bytes */
+static inline void make_token(char *out, unsigned tag, unsigned i) {
+    snprintf(out, 65, "%08x%056x", tag, i);
+}
+
+static inline AGLE_SessionInfo make_info(const char *user, int64_t created_at,
+                                         int64_t expires_at) {
+    AGLE_SessionInfo info;
+    memset(&info, 0, sizeof(info));
+    snprintf(info.username, sizeof(info.username), "%s", user);
+    info.created_at = created_at;
+    info.expires_at = expires_at;
+    return info;
+}
+
+/* Deterministic stand-in for salts and hashes */
+static inline void fill(uint8_t *buf, size_t len, unsigned seed) {
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)(seed * 31 + i);
+    }
+}
+
+#endif